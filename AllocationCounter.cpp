@@ -0,0 +1,51 @@
+
+#include "BUILD_OPTIONS.h"
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if BUILD_ENABLE_ALLOCATION_COUNTER
+
+static std::atomic<uint64_t> heap_allocation_count { 0 };
+
+void * operator new( size_t size )
+{
+	++heap_allocation_count;
+	void * p = std::malloc( size ? size : 1 );
+	if( nullptr == p ) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void * operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void * p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete[]( void * p ) noexcept
+{
+	std::free( p );
+}
+
+uint64_t GetHeapAllocationCount()
+{
+	return heap_allocation_count.load();
+}
+
+#else
+
+uint64_t GetHeapAllocationCount()
+{
+	return 0;
+}
+
+#endif
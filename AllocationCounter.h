@@ -0,0 +1,10 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+
+#include <stdint.h>
+
+// Total number of heap allocations made through the global operator new since program start.
+// Only counts when BUILD_ENABLE_ALLOCATION_COUNTER is 1, always returns 0 otherwise.
+// Compare the value between frames to verify that steady state frames don't allocate.
+uint64_t GetHeapAllocationCount();
@@ -0,0 +1,187 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Compressed stream is a sequence of tokens:
+//		0lllllll						literal run of l + 1 bytes follows
+//		1lllllll oooooooo oooooooo		copy l + LZ_MIN_MATCH bytes from o bytes back, o is little endian
+constexpr uint32_t LZ_MIN_MATCH				= 4;
+constexpr uint32_t LZ_MAX_MATCH				= 0x7f + LZ_MIN_MATCH;
+constexpr uint32_t LZ_MAX_LITERALS			= 0x80;
+constexpr uint32_t LZ_MAX_OFFSET			= 0xffff;
+constexpr uint32_t LZ_HASH_BITS				= 14;
+
+static uint32_t LZHash( const uint8_t * p )
+{
+	uint32_t v;
+	std::memcpy( &v, p, sizeof( v ) );
+	return ( v * 2654435761u ) >> ( 32 - LZ_HASH_BITS );
+}
+
+std::vector<uint8_t> AssetCompress( const void * data, size_t size )
+{
+	auto src = reinterpret_cast<const uint8_t*>( data );
+	std::vector<uint8_t> out;
+	out.reserve( size + size / LZ_MAX_LITERALS + 1 );
+	std::vector<int64_t> table( size_t( 1 ) << LZ_HASH_BITS, -1 );
+
+	size_t literal_start	= 0;
+	auto flush_literals = [ & ]( size_t end ) {
+		while( literal_start < end ) {
+			auto count = std::min<size_t>( end - literal_start, LZ_MAX_LITERALS );
+			out.push_back( uint8_t( count - 1 ) );
+			out.insert( out.end(), src + literal_start, src + literal_start + count );
+			literal_start += count;
+		}
+	};
+
+	size_t i = 0;
+	while( i + LZ_MIN_MATCH <= size ) {
+		auto h			= LZHash( src + i );
+		auto candidate	= table[ h ];
+		table[ h ]		= int64_t( i );
+		if( candidate >= 0 && i - size_t( candidate ) <= LZ_MAX_OFFSET && std::memcmp( src + candidate, src + i, LZ_MIN_MATCH ) == 0 ) {
+			size_t length = LZ_MIN_MATCH;
+			while( i + length < size && length < LZ_MAX_MATCH && src[ candidate + length ] == src[ i + length ] ) {
+				++length;
+			}
+			flush_literals( i );
+			auto offset = uint32_t( i - size_t( candidate ) );
+			out.push_back( uint8_t( 0x80 | ( length - LZ_MIN_MATCH ) ) );
+			out.push_back( uint8_t( offset ) );
+			out.push_back( uint8_t( offset >> 8 ) );
+			i				+= length;
+			literal_start	= i;
+		} else {
+			++i;
+		}
+	}
+	flush_literals( size );
+	return out;
+}
+
+bool AssetDecompress( const void * data, size_t stored_size, void * destination, size_t size )
+{
+	auto src	= reinterpret_cast<const uint8_t*>( data );
+	auto dst	= reinterpret_cast<uint8_t*>( destination );
+	size_t s	= 0;
+	size_t d	= 0;
+	while( s < stored_size ) {
+		uint8_t token = src[ s++ ];
+		if( token & 0x80 ) {
+			if( s + 2 > stored_size ) return false;
+			size_t length	= ( token & 0x7f ) + LZ_MIN_MATCH;
+			size_t offset	= size_t( src[ s ] ) | ( size_t( src[ s + 1 ] ) << 8 );
+			s += 2;
+			if( offset == 0 || offset > d || d + length > size ) return false;
+			// byte by byte, matches may overlap themselves
+			for( size_t k=0; k < length; ++k, ++d ) {
+				dst[ d ] = dst[ d - offset ];
+			}
+		} else {
+			size_t count = size_t( token ) + 1;
+			if( s + count > stored_size || d + count > size ) return false;
+			std::memcpy( dst + d, src + s, count );
+			s += count;
+			d += count;
+		}
+	}
+	return d == size;
+}
+
+AssetArchive::AssetArchive( const std::string & path )
+{
+	_file = new MappedFile( path );
+	if( !_file->IsOpen() ) {
+		return;
+	}
+	auto base = reinterpret_cast<const uint8_t*>( _file->GetData() );
+	auto size = _file->GetSize();
+
+	AssetArchiveHeader header {};
+	if( size < sizeof( header ) ) {
+		assert( 0 && "Asset archive too small." );
+		return;
+	}
+	std::memcpy( &header, base, sizeof( header ) );
+	if( header.magic != ASSET_ARCHIVE_MAGIC || header.version != ASSET_ARCHIVE_VERSION ) {
+		std::cout << "Asset archive " << path << " has an unsupported format, ignoring it." << std::endl;
+		return;
+	}
+	if( sizeof( header ) + uint64_t( header.entry_count ) * sizeof( AssetArchiveEntry ) > size ) {
+		assert( 0 && "Asset archive table of contents is truncated." );
+		return;
+	}
+	auto entries = reinterpret_cast<const AssetArchiveEntry*>( base + sizeof( header ) );
+	for( uint32_t i=0; i < header.entry_count; ++i ) {
+		auto &e = entries[ i ];
+		if( e.offset % ASSET_ARCHIVE_BLOB_ALIGNMENT != 0 || e.offset > size || e.stored_size > size - e.offset || e.name[ ASSET_ARCHIVE_NAME_LENGTH - 1 ] != 0
+			|| ( e.compression == ASSET_COMPRESSION_NONE && e.size != e.stored_size ) ) {
+			assert( 0 && "Asset archive entry out of bounds." );
+			return;
+		}
+	}
+	_entries		= entries;
+	_entry_count	= header.entry_count;
+}
+
+AssetArchive::~AssetArchive()
+{
+	delete _file;
+	_file			= nullptr;
+}
+
+bool AssetArchive::IsOpen() const
+{
+	return _entries != nullptr;
+}
+
+const AssetArchiveEntry * AssetArchive::FindEntry( const std::string & name ) const
+{
+	if( !_entries ) {
+		return nullptr;
+	}
+	auto end	= _entries + _entry_count;
+	auto it		= std::lower_bound( _entries, end, name, []( const AssetArchiveEntry & e, const std::string & n ) {
+		return std::strcmp( e.name, n.c_str() ) < 0;
+	} );
+	if( it != end && name == it->name ) {
+		return it;
+	}
+	return nullptr;
+}
+
+const void * AssetArchive::GetUncompressedData( const AssetArchiveEntry * entry ) const
+{
+	if( entry->compression != ASSET_COMPRESSION_NONE ) {
+		return nullptr;
+	}
+	return reinterpret_cast<const uint8_t*>( _file->GetData() ) + entry->offset;
+}
+
+bool AssetArchive::Read( const std::string & name, std::vector<uint8_t> & data ) const
+{
+	auto entry = FindEntry( name );
+	if( !entry ) {
+		return false;
+	}
+	auto stored = reinterpret_cast<const uint8_t*>( _file->GetData() ) + entry->offset;
+	data.resize( size_t( entry->size ) );
+	switch( entry->compression ) {
+	case ASSET_COMPRESSION_NONE:
+		std::memcpy( data.data(), stored, data.size() );
+		return true;
+	case ASSET_COMPRESSION_LZ:
+		return AssetDecompress( stored, size_t( entry->stored_size ), data.data(), data.size() );
+	default:
+		assert( 0 && "Unknown asset compression." );
+		return false;
+	}
+}
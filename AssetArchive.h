@@ -0,0 +1,76 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Archive layout, everything little endian:
+//		AssetArchiveHeader
+//		AssetArchiveEntry[ entry_count ]		sorted by name
+//		blobs, each starting at a multiple of ASSET_ARCHIVE_BLOB_ALIGNMENT
+// Names are paths relative to the install directory using "/", eg. "pipelines/default/vert.spv".
+constexpr uint32_t ASSET_ARCHIVE_MAGIC					= 0x4b415042;		// "BPAK"
+constexpr uint32_t ASSET_ARCHIVE_VERSION				= 1;
+constexpr uint32_t ASSET_ARCHIVE_NAME_LENGTH			= 96;
+constexpr uint64_t ASSET_ARCHIVE_BLOB_ALIGNMENT			= 64;
+
+enum ASSET_COMPRESSION : uint32_t
+{
+	ASSET_COMPRESSION_NONE				= 0,		// blob can be used in place
+	ASSET_COMPRESSION_LZ				= 1,		// see AssetCompress()
+};
+
+struct AssetArchiveHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			entry_count;
+	uint32_t			reserved;
+};
+
+struct AssetArchiveEntry
+{
+	char				name[ ASSET_ARCHIVE_NAME_LENGTH ];		// zero terminated
+	uint64_t			offset;									// from the start of the archive
+	uint64_t			size;									// uncompressed size
+	uint64_t			stored_size;							// size in the archive
+	uint32_t			compression;							// ASSET_COMPRESSION
+	uint32_t			reserved;
+};
+static_assert( sizeof( AssetArchiveEntry ) == 128, "AssetArchiveEntry layout changed, bump ASSET_ARCHIVE_VERSION." );
+
+// Small LZ77 style codec used for per entry compression, no external dependencies.
+std::vector<uint8_t> AssetCompress( const void * data, size_t size );
+// Returns false if the stream is corrupt or doesn't decompress to exactly size bytes.
+bool AssetDecompress( const void * data, size_t stored_size, void * destination, size_t size );
+
+// Read only asset archive, the whole file is memory mapped once so looking up and reading
+// assets costs no file opens. Build archives with tools/AssetPacker.cpp.
+class AssetArchive
+{
+public:
+	AssetArchive( const std::string & path );
+	~AssetArchive();
+
+	// False if the archive is missing or invalid, lookups then find nothing.
+	bool								IsOpen() const;
+
+	// Returns nullptr if the archive doesn't contain the asset.
+	const AssetArchiveEntry			*	FindEntry( const std::string & name ) const;
+
+	// Points into the mapped archive, valid as long as the archive. Returns nullptr for compressed entries.
+	const void						*	GetUncompressedData( const AssetArchiveEntry * entry ) const;
+
+	// Copies or decompresses the asset, returns false if not found or corrupt.
+	bool								Read( const std::string & name, std::vector<uint8_t> & data ) const;
+
+private:
+	MappedFile						*	_file							= nullptr;
+	const AssetArchiveEntry			*	_entries						= nullptr;
+	uint32_t							_entry_count					= 0;
+};
@@ -6,6 +6,24 @@
 #define		BUILD_ENABLE_CPP_DEBUG								1				// 1 automatic, 0 always disabled
 #define		BUILD_ENABLE_VULKAN_ERROR_REPORTING					1				// 1 always enabled, 0 always disabled
 #define		BUILD_ENABLE_REALTIME_ERROR_CHECKING				1				// 1 always enabled, 0 always disabled
+#define		BUILD_ENABLE_VULKAN_HOST_ALLOCATOR					1				// 1 route Vulkan host allocations through HostAllocator, 0 driver default
+#define		BUILD_ENABLE_VULKAN_HOST_ALLOCATOR_POOLS			1				// 1 serve small Vulkan host allocations from size class pools, 0 always use the heap
+#define		BUILD_ENABLE_ALLOCATION_COUNTER						1				// 1 count heap allocations, see AllocationCounter.h and main.cpp --check-allocations, 0 disabled
+#define		BUILD_ENABLE_GPU_TIMESTAMPS							1				// 1 measure window frames with timestamp queries, see Window::GetGpuTimings(), 0 disabled
+
+// device:
+#define		BUILD_ENABLE_DEDICATED_QUEUES						1				// 1 use separate compute and transfer queue families when the device has them, 0 everything on the graphics queue
+#define		BUILD_JOB_SYSTEM_WORKER_COUNT						0				// worker threads of Renderer::GetJobSystem(), 0 one per hardware thread minus the main thread
+#define		BUILD_DEVICE_ENVIRONMENT_VARIABLE					"BUILDUP_DEVICE"	// overrides device selection, physical device index or part of the device name, eg. "llvmpipe"
+
+// pipelines:
+#define		BUILD_ENABLE_TWO_TIER_PIPELINES						1				// 1 draw with an unoptimized pipeline until the optimized one compiles in the background, 0 only optimized
+#define		BUILD_ENABLE_SHADER_HOT_RELOAD						1				// 1 rebuild pipelines when their SPIR-V in BUILD_PIPELINE_DIRECTORY changes, 0 disabled
+
+// rendering:
+#define		BUILD_ENABLE_RENDER_GRAPH_ALIASING					1				// 1 transient render graph resources with disjoint lifetimes share memory, 0 each gets its own range
 
 // paths: ( path name must end with "/" )
 #define		BUILD_PIPELINE_DIRECTORY							"pipelines/"
+#define		BUILD_MESH_DIRECTORY								"meshes/"
+#define		BUILD_ASSET_ARCHIVE_PATH							"assets.bpak"	// used instead of loose files when it exists, see tools/AssetPacker.cpp
@@ -0,0 +1,88 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "Shared.hpp"
+#include "ComputePipeline.h"
+#include "Renderer.h"
+#include "ShaderModuleCache.h"
+#include "PipelineLayoutCache.h"
+
+#include <vector>
+
+
+ComputePipeline::ComputePipeline( Renderer * renderer, const std::string & name, const PipelineSpecialization & specialization )
+{
+	_renderer		= renderer;
+	_device			= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_PIPELINE );
+	_name			= name;
+	_specialization	= specialization;
+
+	_SubConstructor();
+}
+
+
+ComputePipeline::~ComputePipeline()
+{
+	_SubDestructor();
+}
+
+VkPipeline ComputePipeline::GetVulkanPipeline()
+{
+	return _pipeline;
+}
+
+VkPipelineLayout ComputePipeline::GetVulkanPipelineLayout()
+{
+	return _pipeline_layout;
+}
+
+VkDescriptorSetLayout ComputePipeline::GetVulkanDescriptorSetLayout()
+{
+	return _descriptor_set_layout;
+}
+
+const std::string & ComputePipeline::GetName()
+{
+	return _name;
+}
+
+const PipelineSpecialization & ComputePipeline::GetSpecialization() const
+{
+	return _specialization;
+}
+
+void ComputePipeline::_SubConstructor()
+{
+	_shader_module_compute		= _renderer->GetShaderModuleCache()->GetShaderModule( BUILD_PIPELINE_DIRECTORY + _name + "/comp.spv" );
+	if( _shader_module_compute == VK_NULL_HANDLE ) {
+		abort();
+	}
+
+	const ShaderReflection * reflection	= &_renderer->GetShaderModuleCache()->GetReflection( _shader_module_compute );
+	auto layout							= _renderer->GetPipelineLayoutCache()->GetPipelineLayout( &reflection, 1 );
+	assert( layout.set_layouts.size() <= 1 && "Compute pipelines only support descriptor set 0." );
+	_pipeline_layout					= layout.pipeline_layout;
+	_descriptor_set_layout				= layout.set_layouts.size() ? layout.set_layouts[ 0 ] : VK_NULL_HANDLE;
+
+	std::vector<VkSpecializationMapEntry> specialization_entries;
+	VkSpecializationInfo specialization_info {};
+	_specialization.GetVulkanSpecializationInfo( specialization_entries, specialization_info );
+
+	VkComputePipelineCreateInfo pipeline_create_info {};
+	pipeline_create_info.sType							= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stage.sType					= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_create_info.stage.stage					= VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_create_info.stage.module					= _shader_module_compute;
+	pipeline_create_info.stage.pName					= "main";
+	pipeline_create_info.stage.pSpecializationInfo		= _specialization.IsEmpty() ? nullptr : &specialization_info;
+	pipeline_create_info.layout							= _pipeline_layout;
+	pipeline_create_info.basePipelineIndex				= -1;
+	ErrCheck( vkCreateComputePipelines( _device, _renderer->GetVulkanPipelineCache(), 1, &pipeline_create_info, _allocation_callbacks, &_pipeline ) );
+}
+
+void ComputePipeline::_SubDestructor()
+{
+	vkDestroyPipeline( _device, _pipeline, _allocation_callbacks );
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "PipelineStateKey.h"
+
+#include <string>
+#include <vector>
+
+class Renderer;
+
+// ComputePipeline is the compute counterpart of Pipeline. Compute pipelines are
+// not tied to any window or render pass so they are owned by whoever dispatches them.
+// Shader is loaded from "BUILD_PIPELINE_DIRECTORY/<name>/comp.spv", descriptor set 0 and the
+// push constant range are reflected from it. Specialization constants select a variant of the
+// shader, eg. its workgroup size through local_size_x_id.
+class ComputePipeline
+{
+public:
+	ComputePipeline( Renderer * renderer, const std::string & name, const PipelineSpecialization & specialization = PipelineSpecialization() );
+	~ComputePipeline();
+
+	VkPipeline						GetVulkanPipeline();
+	VkPipelineLayout				GetVulkanPipelineLayout();
+	VkDescriptorSetLayout			GetVulkanDescriptorSetLayout();
+
+	const std::string			&	GetName();
+	const PipelineSpecialization	&	GetSpecialization() const;
+
+private:
+	void _SubConstructor();
+	void _SubDestructor();
+
+	std::string						_name;
+	PipelineSpecialization			_specialization;
+
+	Renderer					*	_renderer					= nullptr;
+	VkDevice						_device						= VK_NULL_HANDLE;
+	const VkAllocationCallbacks	*	_allocation_callbacks		= nullptr;
+	VkPipeline						_pipeline					= VK_NULL_HANDLE;
+	VkPipelineLayout				_pipeline_layout			= VK_NULL_HANDLE;		// owned by the layout cache
+	VkDescriptorSetLayout			_descriptor_set_layout		= VK_NULL_HANDLE;		// owned by the layout cache
+	VkShaderModule					_shader_module_compute		= VK_NULL_HANDLE;
+};
@@ -0,0 +1,161 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "FileWatcher.h"
+
+#if VK_USE_PLATFORM_XCB_KHR
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if VK_USE_PLATFORM_WIN32_KHR
+
+FileWatcher::FileWatcher( const std::string & directory )
+{
+	_directory			= directory;
+	_win32_buffer.resize( 16 * 1024 );
+	_win32_directory	= CreateFileA( directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr );
+	if( _win32_directory == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+	_win32_overlapped.hEvent = CreateEventA( nullptr, TRUE, FALSE, nullptr );
+	_BeginRead();
+}
+
+FileWatcher::~FileWatcher()
+{
+	if( _win32_directory != INVALID_HANDLE_VALUE ) {
+		CancelIo( _win32_directory );
+		DWORD bytes = 0;
+		GetOverlappedResult( _win32_directory, &_win32_overlapped, &bytes, TRUE );
+		CloseHandle( _win32_directory );
+	}
+	if( _win32_overlapped.hEvent ) {
+		CloseHandle( _win32_overlapped.hEvent );
+	}
+}
+
+bool FileWatcher::IsWatching() const
+{
+	return _win32_directory != INVALID_HANDLE_VALUE;
+}
+
+void FileWatcher::Poll( std::vector<std::string> & changed_files )
+{
+	if( !IsWatching() ) return;
+
+	DWORD bytes = 0;
+	if( !GetOverlappedResult( _win32_directory, &_win32_overlapped, &bytes, FALSE ) ) {
+		// ERROR_IO_INCOMPLETE, nothing happened yet
+		return;
+	}
+	auto base	= reinterpret_cast<const uint8_t*>( _win32_buffer.data() );
+	size_t at	= 0;
+	while( bytes ) {
+		auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>( base + at );
+		if( info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME ) {
+			std::string name;
+			for( DWORD i=0; i < info->FileNameLength / sizeof( WCHAR ); ++i ) {
+				// pipeline paths are ASCII
+				name.push_back( info->FileName[ i ] == L'\\' ? '/' : char( info->FileName[ i ] ) );
+			}
+			changed_files.push_back( name );
+		}
+		if( !info->NextEntryOffset ) break;
+		at += info->NextEntryOffset;
+	}
+	_BeginRead();
+}
+
+void FileWatcher::_BeginRead()
+{
+	ResetEvent( _win32_overlapped.hEvent );
+	ReadDirectoryChangesW( _win32_directory, _win32_buffer.data(), DWORD( _win32_buffer.size() * sizeof( DWORD ) ), TRUE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_CREATION, nullptr, &_win32_overlapped, nullptr );
+}
+
+#elif VK_USE_PLATFORM_XCB_KHR
+
+FileWatcher::FileWatcher( const std::string & directory )
+{
+	_directory			= directory;
+	_inotify			= inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( _inotify < 0 ) {
+		return;
+	}
+	_AddWatch( "" );
+}
+
+FileWatcher::~FileWatcher()
+{
+	if( _inotify >= 0 ) {
+		close( _inotify );
+	}
+}
+
+bool FileWatcher::IsWatching() const
+{
+	return _inotify >= 0 && !_watch_paths.empty();
+}
+
+void FileWatcher::Poll( std::vector<std::string> & changed_files )
+{
+	if( _inotify < 0 ) return;
+
+	alignas( inotify_event ) char buffer[ 4096 ];
+	while( true ) {
+		auto length = read( _inotify, buffer, sizeof( buffer ) );
+		if( length <= 0 ) {
+			// EAGAIN, queue is drained
+			break;
+		}
+		for( char * p = buffer; p < buffer + length; ) {
+			auto event	= reinterpret_cast<const inotify_event*>( p );
+			p			+= sizeof( inotify_event ) + event->len;
+			auto it		= _watch_paths.find( event->wd );
+			if( it == _watch_paths.end() || event->len == 0 ) continue;
+
+			std::string name = it->second + event->name;
+			if( event->mask & IN_ISDIR ) {
+				// inotify isn't recursive, new pipeline directories need their own watch
+				if( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) {
+					_AddWatch( name + "/" );
+				}
+				continue;
+			}
+			if( event->mask & IN_CREATE ) {
+				// still being written, IN_CLOSE_WRITE follows
+				continue;
+			}
+			changed_files.push_back( name );
+		}
+	}
+}
+
+void FileWatcher::_AddWatch( const std::string & relative )
+{
+	auto path	= _directory + relative;
+	// IN_CLOSE_WRITE instead of IN_MODIFY, compilers write in several chunks
+	int wd		= inotify_add_watch( _inotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE );
+	if( wd < 0 ) {
+		return;
+	}
+	_watch_paths[ wd ] = relative;
+
+	DIR * dir = opendir( path.c_str() );
+	if( !dir ) {
+		return;
+	}
+	while( auto entry = readdir( dir ) ) {
+		std::string name = entry->d_name;
+		if( entry->d_type == DT_DIR && name != "." && name != ".." ) {
+			_AddWatch( relative + name + "/" );
+		}
+	}
+	closedir( dir );
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Watches a directory tree for files that were written, created or moved in. Uses inotify on Linux
+// and ReadDirectoryChangesW on Windows, Poll() never blocks so it can be called every frame.
+class FileWatcher
+{
+public:
+	FileWatcher( const std::string & directory );
+	~FileWatcher();
+
+	FileWatcher( const FileWatcher & other ) = delete;
+	FileWatcher & operator=( const FileWatcher & other ) = delete;
+
+	bool									IsWatching() const;
+
+	// Appends paths relative to the watched directory using "/", a file may be reported more than once.
+	void									Poll( std::vector<std::string> & changed_files );
+
+private:
+	std::string								_directory;
+
+#if VK_USE_PLATFORM_WIN32_KHR
+	void									_BeginRead();
+
+	HANDLE									_win32_directory				= INVALID_HANDLE_VALUE;
+	OVERLAPPED								_win32_overlapped				= {};
+	std::vector<DWORD>						_win32_buffer;
+#elif VK_USE_PLATFORM_XCB_KHR
+	void									_AddWatch( const std::string & relative );
+
+	int										_inotify						= -1;
+	std::unordered_map<int, std::string>	_watch_paths;					// watch descriptor to relative directory
+#endif
+};
@@ -0,0 +1,267 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+#include "VulkanTools.h"
+
+#include "Shared.hpp"
+#include "FrameArena.h"
+#include "Renderer.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdlib>
+
+// rounds value up to a multiple of alignment, alignment doesn't need to be a power of two
+template<typename T>
+static T AlignUp( T value, T alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+FrameArena::FrameArena( Renderer * renderer, uint32_t frame_count, size_t cpu_bytes_per_frame, VkDeviceSize gpu_bytes_per_frame )
+{
+	assert( frame_count > 0 );
+	_renderer		= renderer;
+	_device			= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_FRAME_ARENA );
+	_frame_count	= frame_count;
+
+	_cpu_block.resize( cpu_bytes_per_frame );
+	_cpu_overflow_blocks.reserve( 16 );
+	_uploads.reserve( 64 );
+	_copy_regions.reserve( 64 );
+
+	_CreateGPUResources( gpu_bytes_per_frame );
+}
+
+FrameArena::~FrameArena()
+{
+	for( auto b : _cpu_overflow_blocks ) {
+		std::free( b );
+	}
+	_DestroyGPUResources();
+}
+
+void * FrameArena::AllocateCPU( size_t size, size_t alignment )
+{
+	// the block itself is aligned by the heap to at least max_align_t
+	size_t offset = AlignUp( _cpu_offset, alignment );
+	if( offset + size <= _cpu_block.size() ) {
+		_cpu_offset = offset + size;
+		return _cpu_block.data() + offset;
+	}
+
+	// out of space, can't grow the block while earlier allocations are still in use
+	void * block = std::malloc( size + alignment );
+	assert( nullptr != block && "Out of memory." );
+	_cpu_overflow_blocks.push_back( block );
+	_cpu_overflow_bytes += size + alignment;
+	auto address = AlignUp( reinterpret_cast<uintptr_t>( block ), uintptr_t( alignment ) );
+	return reinterpret_cast<void*>( address );
+}
+
+bool FrameArena::_AllocateGPURange( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset )
+{
+	VkDeviceSize start	= AlignUp( _gpu_offset, std::max( alignment, _gpu_min_alignment ) );
+	if( start + size > _gpu_region_size ) {
+		assert( 0 && "FrameArena GPU region is full, increase gpu_bytes_per_frame." );
+		return false;
+	}
+	_gpu_offset			= start + size;
+	offset				= _gpu_region_size * _current_frame + start;
+	return true;
+}
+
+FrameArenaAllocation FrameArena::AllocateGPU( VkDeviceSize size, VkDeviceSize alignment )
+{
+	FrameArenaAllocation allocation {};
+
+	std::lock_guard<std::mutex> lock( _gpu_mutex );
+	VkDeviceSize offset = 0;
+	if( !_AllocateGPURange( size, alignment, offset ) ) return allocation;
+
+	allocation.buffer		= _gpu_buffers[ 0 ].buffer;
+	allocation.offset		= offset;
+	allocation.mapped		= _gpu_mapped + offset;
+	return allocation;
+}
+
+void * FrameArena::AllocateUpload( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size )
+{
+	std::lock_guard<std::mutex> lock( _gpu_mutex );
+	VkDeviceSize src_offset = 0;
+	if( !_AllocateGPURange( size, 1, src_offset ) ) return nullptr;
+
+	Upload upload;
+	upload.buffer				= buffer;
+	upload.region.srcOffset		= src_offset;
+	upload.region.dstOffset		= offset;
+	upload.region.size			= size;
+	_uploads.push_back( upload );
+	return _gpu_mapped + src_offset;
+}
+
+void FrameArena::CmdCopyUploads( VkCommandBuffer command_buffer )
+{
+	std::lock_guard<std::mutex> lock( _gpu_mutex );
+	if( _uploads.empty() ) return;
+
+	// everything that may read or write the destinations, last frame may still be using them
+	constexpr VkPipelineStageFlags read_stages	=
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	constexpr VkAccessFlags read_access			=
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+		VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	// host writes are made visible by the submit, only reads and shader writes need waiting for
+	VkMemoryBarrier before {};
+	before.sType				= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	before.srcAccessMask		= VK_ACCESS_SHADER_WRITE_BIT;
+	before.dstAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier( command_buffer, read_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		1, &before, 0, nullptr, 0, nullptr );
+
+	// one copy per run of uploads into the same buffer
+	size_t first = 0;
+	while( first < _uploads.size() ) {
+		VkBuffer dst	= _uploads[ first ].buffer;
+		_copy_regions.clear();
+		size_t i = first;
+		for( ; i < _uploads.size() && _uploads[ i ].buffer == dst; ++i ) {
+			_copy_regions.push_back( _uploads[ i ].region );
+		}
+		vkCmdCopyBuffer( command_buffer, _gpu_buffers[ 0 ].buffer, dst, uint32_t( _copy_regions.size() ), _copy_regions.data() );
+		first = i;
+	}
+
+	VkMemoryBarrier after {};
+	after.sType					= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	after.srcAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT;
+	after.dstAccessMask			= read_access;
+	vkCmdPipelineBarrier( command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, read_stages, 0,
+		1, &after, 0, nullptr, 0, nullptr );
+}
+
+VkFence FrameArena::GetFrameFence()
+{
+	_fences_pending[ _current_frame ]	= true;
+	return _fences[ _current_frame ];
+}
+
+void FrameArena::WaitFrames()
+{
+	// left pending, NextFrame resets them when their region comes around
+	for( uint32_t i=0; i < _frame_count; ++i ) {
+		if( _fences_pending[ i ] ) {
+			ErrCheck( vkWaitForFences( _device, 1, &_fences[ i ], VK_TRUE, UINT64_MAX ) );
+		}
+	}
+}
+
+void FrameArena::NextFrame()
+{
+	_current_frame		= ( _current_frame + 1 ) % _frame_count;
+	++_frame_number;
+
+	// GPU may still be reading this region from the last time we used it
+	if( _fences_pending[ _current_frame ] ) {
+		ErrCheck( vkWaitForFences( _device, 1, &_fences[ _current_frame ], VK_TRUE, UINT64_MAX ) );
+		ErrCheck( vkResetFences( _device, 1, &_fences[ _current_frame ] ) );
+		_fences_pending[ _current_frame ]	= false;
+	}
+	_gpu_offset			= 0;
+	_uploads.clear();
+
+	// grow the CPU block so next frame fits in without overflowing
+	if( _cpu_overflow_bytes ) {
+		for( auto b : _cpu_overflow_blocks ) {
+			std::free( b );
+		}
+		_cpu_overflow_blocks.clear();
+		_cpu_block.resize( _cpu_block.size() + _cpu_overflow_bytes );
+		_cpu_overflow_bytes	= 0;
+	}
+	_cpu_offset			= 0;
+}
+
+uint32_t FrameArena::GetFrameCount() const
+{
+	return _frame_count;
+}
+
+uint32_t FrameArena::GetFrameIndex() const
+{
+	return _current_frame;
+}
+
+uint64_t FrameArena::GetFrameNumber() const
+{
+	return _frame_number;
+}
+
+bool FrameArena::IsFrameFinished( uint64_t frame_number ) const
+{
+	if( frame_number >= _frame_number ) return false;
+	// region was reused since, NextFrame waited for it
+	if( frame_number + _frame_count <= _frame_number ) return true;
+
+	uint32_t region		= uint32_t( frame_number % _frame_count );
+	// nothing was submitted with the fence
+	if( !_fences_pending[ region ] ) return true;
+	return VK_SUCCESS == vkGetFenceStatus( _device, _fences[ region ] );
+}
+
+void FrameArena::_CreateGPUResources( VkDeviceSize gpu_bytes_per_frame )
+{
+	auto &limits			= _renderer->GetVulkanPhysicalDeviceProperties().limits;
+	_gpu_min_alignment		= std::max( limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment );
+	_gpu_min_alignment		= std::max( _gpu_min_alignment, VkDeviceSize( 16 ) );
+	_gpu_region_size		= AlignUp( gpu_bytes_per_frame, _gpu_min_alignment );
+
+	_gpu_buffers.resize( 1 );
+	_gpu_buffers[ 0 ].memory_size			= _gpu_region_size * _frame_count;
+	// written by the CPU without flushing
+	_gpu_buffers[ 0 ].memory_properties		= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VkBufferCreateInfo buffer_create_info {};
+	buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size					= _gpu_buffers[ 0 ].memory_size;
+	buffer_create_info.usage				= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+	ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &_gpu_buffers[ 0 ].buffer ) );
+
+	AllocateBuffersMemory( _renderer, _gpu_buffers );
+	ErrCheck( vkBindBufferMemory( _device, _gpu_buffers[ 0 ].buffer, _gpu_buffers[ 0 ].memory, 0 ) );
+
+	void * data = nullptr;
+	ErrCheck( vkMapMemory( _device, _gpu_buffers[ 0 ].memory, 0, _gpu_buffers[ 0 ].memory_size, 0, &data ) );
+	_gpu_mapped		= reinterpret_cast<uint8_t*>( data );
+
+	_fences.resize( _frame_count );
+	_fences_pending.resize( _frame_count, false );
+	for( auto &f : _fences ) {
+		VkFenceCreateInfo fence_create_info {};
+		fence_create_info.sType		= VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		ErrCheck( vkCreateFence( _device, &fence_create_info, _allocation_callbacks, &f ) );
+	}
+}
+
+void FrameArena::_DestroyGPUResources()
+{
+	// make sure nothing is reading the ring anymore
+	for( uint32_t i=0; i < _frame_count; ++i ) {
+		if( _fences_pending[ i ] ) {
+			vkWaitForFences( _device, 1, &_fences[ i ], VK_TRUE, UINT64_MAX );
+		}
+		vkDestroyFence( _device, _fences[ i ], _allocation_callbacks );
+	}
+	_fences.clear();
+	_fences_pending.clear();
+
+	vkUnmapMemory( _device, _gpu_buffers[ 0 ].memory );
+	_gpu_mapped		= nullptr;
+	vkDestroyBuffer( _device, _gpu_buffers[ 0 ].buffer, _allocation_callbacks );
+	FreeBuffersMemory( _renderer, _gpu_buffers );
+	_gpu_buffers.clear();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "VulkanCollections.h"
+
+#include <vector>
+#include <cstddef>
+#include <mutex>
+
+class Renderer;
+
+// Transient GPU memory from FrameArena::AllocateGPU, valid until the GPU has finished the frame it was allocated in.
+struct FrameArenaAllocation
+{
+	VkBuffer						buffer			= VK_NULL_HANDLE;
+	VkDeviceSize					offset			= 0;
+	void						*	mapped			= nullptr;
+};
+
+// FrameArena hands out memory that only lives for a single frame. CPU memory comes from a bump
+// allocator that is reset at every frame boundary. GPU memory comes from a host coherent ring
+// buffer which is split into one region per frame in flight, each region is guarded by a fence.
+// The ring also stages uploads into device local buffers, see AllocateUpload.
+// Once the arena has grown to fit the frame no more heap allocations happen.
+class FrameArena
+{
+public:
+	FrameArena( Renderer * renderer, uint32_t frame_count, size_t cpu_bytes_per_frame, VkDeviceSize gpu_bytes_per_frame );
+	~FrameArena();
+
+	// CPU memory, released all at once by NextFrame().
+	void						*	AllocateCPU( size_t size, size_t alignment = alignof( std::max_align_t ) );
+	// Uniform, storage, vertex or index data. Offset is aligned to the device minimum. Thread safe.
+	FrameArenaAllocation			AllocateGPU( VkDeviceSize size, VkDeviceSize alignment = 1 );
+	// Returns ring memory to write size bytes into, CmdCopyUploads copies them to buffer at offset
+	// this frame. Buffer needs transfer dst usage. Thread safe.
+	void						*	AllocateUpload( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size );
+	// Records the copies of this frame's uploads with the barriers around them. Must come before
+	// anything that reads the destination buffers in the frame, outside of a render pass.
+	void							CmdCopyUploads( VkCommandBuffer command_buffer );
+
+	// Fence that must be signaled by the last queue submit of the current frame.
+	VkFence							GetFrameFence();
+
+	// Moves on to the next frame region, waits for the GPU to finish with it and resets both allocators.
+	void							NextFrame();
+	// Waits for every submitted frame without idling the queue, for changes all frames in flight use.
+	void							WaitFrames();
+
+	uint32_t						GetFrameCount() const;
+	// Region of the current frame, NextFrame already waited for the last frame that used it. Objects
+	// with one copy of something per frame in flight pick theirs with this.
+	uint32_t						GetFrameIndex() const;
+	// Counts NextFrame calls, identifies the frame that is currently being built.
+	uint64_t						GetFrameNumber() const;
+	// True once the GPU has finished the frame, polls the fence and never blocks.
+	bool							IsFrameFinished( uint64_t frame_number ) const;
+
+private:
+	struct Upload
+	{
+		VkBuffer					buffer						= VK_NULL_HANDLE;
+		VkBufferCopy				region						= {};
+	};
+
+	void							_CreateGPUResources( VkDeviceSize gpu_bytes_per_frame );
+	void							_DestroyGPUResources();
+	// caller holds _gpu_mutex
+	bool							_AllocateGPURange( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset );
+
+	Renderer					*	_renderer					= nullptr;
+	VkDevice						_device						= VK_NULL_HANDLE;
+	const VkAllocationCallbacks	*	_allocation_callbacks		= nullptr;
+
+	uint32_t						_frame_count				= 0;
+	uint32_t						_current_frame				= 0;
+	uint64_t						_frame_number				= 0;
+
+	std::vector<uint8_t>			_cpu_block;
+	size_t							_cpu_offset					= 0;
+	std::vector<void*>				_cpu_overflow_blocks;		// used when the block is full, merged into the block on the next frame
+	size_t							_cpu_overflow_bytes			= 0;
+
+	std::vector<Buffer>				_gpu_buffers;
+	uint8_t						*	_gpu_mapped					= nullptr;
+	VkDeviceSize					_gpu_region_size			= 0;
+	VkDeviceSize					_gpu_offset					= 0;
+	VkDeviceSize					_gpu_min_alignment			= 1;
+	std::mutex						_gpu_mutex;					// scene objects update on the job system
+
+	std::vector<Upload>				_uploads;					// this frame's, cleared by NextFrame
+	std::vector<VkBufferCopy>		_copy_regions;
+
+	std::vector<VkFence>			_fences;
+	std::vector<bool>				_fences_pending;
+};
+
+// STL allocator on top of FrameArena, for containers that are rebuilt every frame.
+template<typename T>
+class FrameArenaAllocator
+{
+public:
+	using value_type = T;
+
+	FrameArenaAllocator( FrameArena * arena ) : _arena( arena ) {}
+	template<typename U>
+	FrameArenaAllocator( const FrameArenaAllocator<U> & other ) : _arena( other._arena ) {}
+
+	T * allocate( size_t count )
+	{
+		return static_cast<T*>( _arena->AllocateCPU( count * sizeof( T ), alignof( T ) ) );
+	}
+	void deallocate( T *, size_t )
+	{
+		// released together with the rest of the frame
+	}
+
+	FrameArena					*	_arena						= nullptr;
+};
+
+template<typename T, typename U>
+bool operator==( const FrameArenaAllocator<T> & a, const FrameArenaAllocator<U> & b )
+{
+	return a._arena == b._arena;
+}
+
+template<typename T, typename U>
+bool operator!=( const FrameArenaAllocator<T> & a, const FrameArenaAllocator<U> & b )
+{
+	return a._arena != b._arena;
+}
+
+template<typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
@@ -0,0 +1,337 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+#include "VulkanTools.h"
+
+#include "Shared.hpp"
+#include "FrameCapture.h"
+#include "FrameArena.h"
+#include "Renderer.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdlib>
+
+// rounds value up to a multiple of alignment, alignment doesn't need to be a power of two
+template<typename T>
+static T AlignUp( T value, T alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+FrameCapture::FrameCapture( Renderer * renderer, FrameArena * frame_arena, const FrameCaptureSettings & settings, FrameCaptureCallback callback )
+{
+	_renderer				= renderer;
+	_frame_arena			= frame_arena;
+	_device					= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_WINDOW );
+	_settings				= settings;
+	_settings.frame_interval	= std::max( _settings.frame_interval, 1u );
+	_callback				= callback;
+
+	if( _settings.threaded ) {
+		_thread				= std::thread( &FrameCapture::_ThreadLoop, this );
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	Flush();
+	if( _thread.joinable() ) {
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_quit			= true;
+		}
+		_condition.notify_all();
+		_thread.join();
+	}
+	_DestroyBuffer();
+}
+
+void FrameCapture::Resize( VkExtent2D extent, VkFormat format )
+{
+	Flush();
+	_DestroyBuffer();
+
+	_extent					= extent;
+	_format					= format;
+	_row_pitch				= extent.width * GetTexelSize( format );
+	_slot_size				= 0;
+	if( 0 == _row_pitch ) {
+		assert( 0 && "FrameCapture: swapchain format can't be captured." );
+		return;
+	}
+	_CreateBuffer();
+}
+
+void FrameCapture::Update()
+{
+	// ring order is frame order, stop at the first frame the GPU is still working on
+	uint32_t slot_count		= uint32_t( _slots.size() );
+	for( uint32_t i=0; i < slot_count; ++i ) {
+		uint32_t s			= ( _next_slot + i ) % slot_count;
+		SLOT_STATE state;
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			state			= _slots[ s ].state;
+		}
+		if( SLOT_STATE_RECORDED != state ) continue;
+		if( !_frame_arena->IsFrameFinished( _slots[ s ].frame_number ) ) break;
+		_Deliver( s );
+	}
+}
+
+bool FrameCapture::BeginFrame()
+{
+	_current_slot			= UINT32_MAX;
+	if( 0 == _slot_size ) return false;
+
+	uint64_t frame			= _frame_counter++;
+	if( _settings.frame_limit && _started >= _settings.frame_limit ) return false;
+	if( frame % _settings.frame_interval ) return false;
+
+	// never wait for a buffer, the consumer has to keep up or lose frames
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( SLOT_STATE_FREE != _slots[ _next_slot ].state ) {
+		++_statistics.dropped;
+		return false;
+	}
+	_current_slot			= _next_slot;
+	return true;
+}
+
+void FrameCapture::CmdCopyImage( VkCommandBuffer command_buffer, VkImage image )
+{
+	if( UINT32_MAX == _current_slot ) return;
+	auto &slot				= _slots[ _current_slot ];
+
+	VkBufferImageCopy region {};
+	region.bufferOffset						= slot.offset;
+	region.bufferRowLength					= 0;		// tightly packed
+	region.bufferImageHeight				= 0;
+	region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount		= 1;
+	region.imageExtent.width				= _extent.width;
+	region.imageExtent.height				= _extent.height;
+	region.imageExtent.depth				= 1;
+	vkCmdCopyImageToBuffer( command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _buffer, 1, &region );
+
+	// the fence alone doesn't make the copy visible to the host
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask			= VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask			= VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer					= _buffer;
+	barrier.offset					= slot.offset;
+	barrier.size					= _slot_size;
+	vkCmdPipelineBarrier( command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr );
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		slot.state				= SLOT_STATE_RECORDED;
+		slot.frame_number		= _frame_arena->GetFrameNumber();
+	}
+	_next_slot				= ( _next_slot + 1 ) % uint32_t( _slots.size() );
+	_current_slot			= UINT32_MAX;
+	++_started;
+}
+
+void FrameCapture::Flush()
+{
+	uint32_t slot_count		= uint32_t( _slots.size() );
+	for( uint32_t i=0; i < slot_count; ++i ) {
+		uint32_t s			= ( _next_slot + i ) % slot_count;
+		bool recorded;
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			recorded		= SLOT_STATE_RECORDED == _slots[ s ].state;
+		}
+		if( recorded ) _Deliver( s );
+	}
+
+	std::unique_lock<std::mutex> lock( _mutex );
+	_condition.wait( lock, [ this ] {
+		for( auto &s : _slots ) {
+			if( SLOT_STATE_FREE != s.state ) return false;
+		}
+		return true;
+	} );
+}
+
+bool FrameCapture::IsDone() const
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _settings.frame_limit && _statistics.captured >= _settings.frame_limit;
+}
+
+FrameCaptureStatistics FrameCapture::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _statistics;
+}
+
+void FrameCapture::PrintStatistics( std::ostream & stream ) const
+{
+	auto statistics = GetStatistics();
+	stream << "Frame capture: " << statistics.captured << " frames captured, " << statistics.dropped << " dropped"
+		<< ", " << _slots.size() << " staging buffers of " << _slot_size / 1024 << " KiB"
+		<< ( _memory_coherent ? "" : ", non coherent" ) << "\n";
+}
+
+uint32_t FrameCapture::GetTexelSize( VkFormat format )
+{
+	switch( format ) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+	case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		return 4;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+void FrameCapture::_CreateBuffer()
+{
+	auto &limits			= _renderer->GetVulkanPhysicalDeviceProperties().limits;
+	VkDeviceSize alignment	= std::max( limits.optimalBufferCopyOffsetAlignment, limits.nonCoherentAtomSize );
+	alignment				= std::max( alignment, VkDeviceSize( 16 ) );
+	_slot_size				= AlignUp( VkDeviceSize( _row_pitch ) * _extent.height, alignment );
+
+	uint32_t slot_count		= _settings.ring_size ? _settings.ring_size : _frame_arena->GetFrameCount() + 2;
+	_slots.assign( slot_count, Slot() );
+	for( uint32_t i=0; i < slot_count; ++i ) {
+		_slots[ i ].offset	= _slot_size * i;
+	}
+	_next_slot				= 0;
+
+	VkBufferCreateInfo buffer_create_info {};
+	buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size					= _slot_size * slot_count;
+	buffer_create_info.usage				= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+	ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &_buffer ) );
+
+	VkMemoryRequirements memory_requirements {};
+	vkGetBufferMemoryRequirements( _device, _buffer, &memory_requirements );
+
+	// the CPU reads every byte, uncached memory would make that crawl
+	auto &mem_props			= _renderer->GetVulkanPhysicalDeviceMemoryProperties();
+	VkMemoryPropertyFlags preferences[] {
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+	};
+	uint32_t memory_type_index	= UINT32_MAX;
+	for( auto wanted : preferences ) {
+		for( uint32_t i=0; i < mem_props.memoryTypeCount && UINT32_MAX == memory_type_index; ++i ) {
+			if( ( memory_requirements.memoryTypeBits & ( 1u << i ) ) && ( mem_props.memoryTypes[ i ].propertyFlags & wanted ) == wanted ) {
+				memory_type_index	= i;
+			}
+		}
+	}
+	if( UINT32_MAX == memory_type_index ) {
+		assert( 0 && "FrameCapture: no host visible memory type for the staging buffers." );
+		std::exit( -1 );
+	}
+	_memory_coherent		= 0 != ( mem_props.memoryTypes[ memory_type_index ].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+	VkMemoryAllocateInfo allocate_info {};
+	allocate_info.sType						= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize			= memory_requirements.size;
+	allocate_info.memoryTypeIndex			= memory_type_index;
+	ErrCheck( vkAllocateMemory( _device, &allocate_info, _renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY ), &_memory ) );
+	ErrCheck( vkBindBufferMemory( _device, _buffer, _memory, 0 ) );
+
+	void * data = nullptr;
+	ErrCheck( vkMapMemory( _device, _memory, 0, VK_WHOLE_SIZE, 0, &data ) );
+	_mapped					= reinterpret_cast<uint8_t*>( data );
+}
+
+void FrameCapture::_DestroyBuffer()
+{
+	if( VK_NULL_HANDLE == _buffer ) return;
+
+	vkUnmapMemory( _device, _memory );
+	_mapped					= nullptr;
+	vkDestroyBuffer( _device, _buffer, _allocation_callbacks );
+	vkFreeMemory( _device, _memory, _renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY ) );
+	_buffer					= VK_NULL_HANDLE;
+	_memory					= VK_NULL_HANDLE;
+	_slots.clear();
+}
+
+void FrameCapture::_Deliver( uint32_t slot )
+{
+	if( !_memory_coherent ) {
+		// slots are aligned to the atom size
+		VkMappedMemoryRange range {};
+		range.sType				= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory			= _memory;
+		range.offset			= _slots[ slot ].offset;
+		range.size				= _slot_size;
+		ErrCheck( vkInvalidateMappedMemoryRanges( _device, 1, &range ) );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_slots[ slot ].state	= SLOT_STATE_CONSUMING;
+		++_statistics.captured;
+		if( _settings.threaded ) {
+			_queue.push_back( slot );
+		}
+	}
+	if( _settings.threaded ) {
+		_condition.notify_all();
+	} else {
+		_Consume( slot );
+	}
+}
+
+void FrameCapture::_Consume( uint32_t slot )
+{
+	FrameCaptureImage image;
+	image.pixels			= _mapped + _slots[ slot ].offset;
+	image.extent			= _extent;
+	image.format			= _format;
+	image.row_pitch			= _row_pitch;
+	image.frame_number		= _slots[ slot ].frame_number;
+	if( _callback ) {
+		_callback( image );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_slots[ slot ].state	= SLOT_STATE_FREE;
+	}
+	// Flush may be waiting for the ring to drain
+	_condition.notify_all();
+}
+
+void FrameCapture::_ThreadLoop()
+{
+	std::unique_lock<std::mutex> lock( _mutex );
+	while( true ) {
+		_condition.wait( lock, [ this ] { return _quit || !_queue.empty(); } );
+		// quit only once everything queued is consumed
+		if( _queue.empty() ) return;
+
+		uint32_t slot		= _queue.front();
+		_queue.pop_front();
+		lock.unlock();
+		_Consume( slot );
+		lock.lock();
+	}
+}
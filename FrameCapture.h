@@ -0,0 +1,127 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+
+class Renderer;
+class FrameArena;
+
+// Pixels of a captured frame, only valid during the callback.
+struct FrameCaptureImage
+{
+	const uint8_t				*	pixels					= nullptr;		// rows are tightly packed, top row first
+	VkExtent2D						extent					= { 0, 0 };
+	VkFormat						format					= VK_FORMAT_UNDEFINED;	// swapchain format, usually B8G8R8A8
+	uint32_t						row_pitch				= 0;			// in bytes
+	uint64_t						frame_number			= 0;			// FrameArena::GetFrameNumber of the captured frame
+};
+
+typedef std::function<void( const FrameCaptureImage & image )> FrameCaptureCallback;
+
+struct FrameCaptureSettings
+{
+	uint32_t						ring_size				= 0;		// staging buffers, 0 is frames in flight plus two for the consumer
+	uint32_t						frame_interval			= 1;		// captures every nth frame
+	uint32_t						frame_limit				= 0;		// stops capturing after this many frames, 0 is unlimited, 1 takes a screenshot
+	// Calls the callback on a capture thread of its own, for encoders that take longer than a frame.
+	// Otherwise it's called from Window::Render on the render thread.
+	bool							threaded				= true;
+};
+
+struct FrameCaptureStatistics
+{
+	uint64_t						captured				= 0;
+	uint64_t						dropped					= 0;		// every staging buffer was still waiting for the GPU or the consumer
+};
+
+// Copies rendered frames into a ring of host visible staging buffers. A buffer is handed to the
+// consumer once FrameArena reports its frame finished, the queue is never waited on: frames are
+// dropped when the consumer falls behind and the ring is full.
+class FrameCapture
+{
+public:
+	FrameCapture( Renderer * renderer, FrameArena * frame_arena, const FrameCaptureSettings & settings, FrameCaptureCallback callback );
+	~FrameCapture();
+
+	// Delivers what is left and recreates the staging buffers. Frames that copied must have finished.
+	void							Resize( VkExtent2D extent, VkFormat format );
+
+	// Hands finished frames to the consumer, call once per frame before BeginFrame.
+	void							Update();
+	// Picks a staging buffer for the frame being built, false if this frame isn't captured.
+	bool							BeginFrame();
+	// Copies the image in transfer source layout into the buffer picked by BeginFrame.
+	void							CmdCopyImage( VkCommandBuffer command_buffer, VkImage image );
+
+	// Delivers every captured frame and waits for the consumer to finish them. Frames that copied
+	// must have finished, FrameArena::WaitFrames.
+	void							Flush();
+	// True once frame_limit frames have been delivered.
+	bool							IsDone() const;
+
+	FrameCaptureStatistics			GetStatistics() const;
+	void							PrintStatistics( std::ostream & stream ) const;
+
+	// Bytes per pixel of the formats we can hand out, 0 if unsupported.
+	static uint32_t					GetTexelSize( VkFormat format );
+
+private:
+	enum SLOT_STATE : uint32_t
+	{
+		SLOT_STATE_FREE				= 0,
+		SLOT_STATE_RECORDED,								// copy is in a submitted frame
+		SLOT_STATE_CONSUMING,								// with the consumer
+	};
+
+	struct Slot
+	{
+		SLOT_STATE						state					= SLOT_STATE_FREE;
+		uint64_t						frame_number			= 0;
+		VkDeviceSize					offset					= 0;
+	};
+
+	void							_CreateBuffer();
+	void							_DestroyBuffer();
+	// Invalidates non coherent memory and queues or calls the consumer.
+	void							_Deliver( uint32_t slot );
+	void							_Consume( uint32_t slot );
+	void							_ThreadLoop();
+
+	Renderer					*	_renderer				= nullptr;
+	FrameArena					*	_frame_arena			= nullptr;
+	VkDevice						_device					= VK_NULL_HANDLE;
+	const VkAllocationCallbacks	*	_allocation_callbacks	= nullptr;
+	FrameCaptureSettings			_settings;
+	FrameCaptureCallback			_callback;
+
+	VkExtent2D						_extent					= { 0, 0 };
+	VkFormat						_format					= VK_FORMAT_UNDEFINED;
+	uint32_t						_row_pitch				= 0;
+	VkDeviceSize					_slot_size				= 0;
+
+	VkBuffer						_buffer					= VK_NULL_HANDLE;
+	VkDeviceMemory					_memory					= VK_NULL_HANDLE;
+	bool							_memory_coherent		= false;
+	uint8_t						*	_mapped					= nullptr;
+
+	std::vector<Slot>				_slots;					// guarded by _mutex once the thread runs
+	uint32_t						_next_slot				= 0;
+	uint32_t						_current_slot			= UINT32_MAX;	// picked by BeginFrame
+	uint64_t						_frame_counter			= 0;			// frames seen by BeginFrame, for the interval
+	uint64_t						_started				= 0;			// copies recorded, for the limit
+	FrameCaptureStatistics			_statistics;
+
+	std::thread						_thread;
+	mutable std::mutex				_mutex;
+	std::condition_variable			_condition;
+	std::deque<uint32_t>			_queue;					// slots waiting for the capture thread
+	bool							_quit					= false;
+};
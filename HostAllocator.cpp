@@ -0,0 +1,293 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "Shared.hpp"
+#include "HostAllocator.h"
+
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// Every allocation is preceded by this header, user memory starts right after it.
+struct alignas( 16 ) HostAllocationHeader
+{
+	void						*	raw;				// pointer returned by malloc, nullptr for pooled blocks
+	uint64_t						size;				// requested size
+	uint8_t							category;
+	uint8_t							scope;
+	uint8_t							size_class;
+};
+
+constexpr uint8_t	HOST_ALLOCATION_NOT_POOLED					= 0xFF;
+constexpr size_t	HOST_ALLOCATION_POOL_CLASS_SIZES[]			= { 32, 64, 128, 256, 512, 1024 };
+constexpr uint32_t	HOST_ALLOCATION_POOL_CLASS_COUNT			= sizeof( HOST_ALLOCATION_POOL_CLASS_SIZES ) / sizeof( HOST_ALLOCATION_POOL_CLASS_SIZES[ 0 ] );
+constexpr size_t	HOST_ALLOCATION_POOL_CHUNK_SIZE				= 64 * 1024;
+
+static const char * const HOST_ALLOCATION_CATEGORY_NAMES[ HOST_ALLOCATION_CATEGORY_COUNT ] {
+	"Renderer",
+	"Window",
+	"Pipeline",
+	"Scene",
+	"FrameArena",
+	"DeviceMemory",
+};
+
+static const char * const HOST_ALLOCATION_SCOPE_NAMES[ HOST_ALLOCATION_SCOPE_COUNT ] {
+	"Command",
+	"Object",
+	"Cache",
+	"Device",
+	"Instance",
+};
+
+static HostAllocationHeader * GetHeader( void * memory )
+{
+	return reinterpret_cast<HostAllocationHeader*>( reinterpret_cast<uint8_t*>( memory ) - sizeof( HostAllocationHeader ) );
+}
+
+static uintptr_t AlignUp( uintptr_t value, uintptr_t alignment )
+{
+	return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+HostAllocator::HostAllocator()
+{
+	for( uint32_t i=0; i < HOST_ALLOCATION_CATEGORY_COUNT; ++i ) {
+		_contexts[ i ].allocator					= this;
+		_contexts[ i ].category						= HOST_ALLOCATION_CATEGORY( i );
+
+		_callbacks[ i ].pUserData					= &_contexts[ i ];
+		_callbacks[ i ].pfnAllocation				= _Allocation;
+		_callbacks[ i ].pfnReallocation				= _Reallocation;
+		_callbacks[ i ].pfnFree						= _Free;
+		_callbacks[ i ].pfnInternalAllocation		= _InternalAllocation;
+		_callbacks[ i ].pfnInternalFree				= _InternalFree;
+	}
+	_pool_free_lists.resize( HOST_ALLOCATION_POOL_CLASS_COUNT, nullptr );
+}
+
+HostAllocator::~HostAllocator()
+{
+	for( auto c : _pool_chunks ) {
+		std::free( c );
+	}
+}
+
+const VkAllocationCallbacks * HostAllocator::GetCallbacks( HOST_ALLOCATION_CATEGORY category ) const
+{
+#if BUILD_ENABLE_VULKAN_HOST_ALLOCATOR
+	assert( category < HOST_ALLOCATION_CATEGORY_COUNT );
+	return &_callbacks[ category ];
+#else
+	return nullptr;
+#endif
+}
+
+HostAllocationStatistics HostAllocator::GetCategoryStatistics( HOST_ALLOCATION_CATEGORY category )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _category_statistics[ category ];
+}
+
+HostAllocationStatistics HostAllocator::GetScopeStatistics( VkSystemAllocationScope scope )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _scope_statistics[ scope ];
+}
+
+HostAllocationStatistics HostAllocator::GetTotalStatistics()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	HostAllocationStatistics total {};
+	for( auto &s : _category_statistics ) {
+		total.allocation_count			+= s.allocation_count;
+		total.reallocation_count		+= s.reallocation_count;
+		total.free_count				+= s.free_count;
+		total.pooled_allocation_count	+= s.pooled_allocation_count;
+		total.bytes_in_use				+= s.bytes_in_use;
+		total.peak_bytes_in_use			+= s.peak_bytes_in_use;		// sum of peaks, upper bound
+		total.internal_bytes_in_use		+= s.internal_bytes_in_use;
+	}
+	return total;
+}
+
+void HostAllocator::PrintStatistics( std::ostream & stream )
+{
+	auto print = [ &stream ]( const char * name, const HostAllocationStatistics & s ) {
+		stream << "  " << name
+			<< ": allocations " << s.allocation_count
+			<< " (pooled " << s.pooled_allocation_count << ")"
+			<< ", reallocations " << s.reallocation_count
+			<< ", frees " << s.free_count
+			<< ", in use " << s.bytes_in_use
+			<< " B, peak " << s.peak_bytes_in_use
+			<< " B, internal " << s.internal_bytes_in_use << " B\n";
+	};
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	stream << "Vulkan host allocations by category:\n";
+	for( uint32_t i=0; i < HOST_ALLOCATION_CATEGORY_COUNT; ++i ) {
+		print( HOST_ALLOCATION_CATEGORY_NAMES[ i ], _category_statistics[ i ] );
+	}
+	stream << "Vulkan host allocations by scope:\n";
+	for( uint32_t i=0; i < HOST_ALLOCATION_SCOPE_COUNT; ++i ) {
+		print( HOST_ALLOCATION_SCOPE_NAMES[ i ], _scope_statistics[ i ] );
+	}
+}
+
+VKAPI_ATTR void * VKAPI_CALL HostAllocator::_Allocation( void * user_data, size_t size, size_t alignment, VkSystemAllocationScope scope )
+{
+	auto context = reinterpret_cast<CallbackContext*>( user_data );
+	return context->allocator->_Allocate( context->category, size, alignment, scope );
+}
+
+VKAPI_ATTR void * VKAPI_CALL HostAllocator::_Reallocation( void * user_data, void * original, size_t size, size_t alignment, VkSystemAllocationScope scope )
+{
+	auto context = reinterpret_cast<CallbackContext*>( user_data );
+	if( nullptr == original ) {
+		return context->allocator->_Allocate( context->category, size, alignment, scope );
+	}
+	if( 0 == size ) {
+		context->allocator->_Deallocate( original );
+		return nullptr;
+	}
+
+	void * memory = context->allocator->_Allocate( context->category, size, alignment, scope );
+	if( nullptr == memory ) {
+		// original must stay intact on failure
+		return nullptr;
+	}
+	std::memcpy( memory, original, std::min( size_t( GetHeader( original )->size ), size ) );
+	context->allocator->_Deallocate( original );
+	{
+		std::lock_guard<std::mutex> lock( context->allocator->_mutex );
+		++context->allocator->_category_statistics[ context->category ].reallocation_count;
+		++context->allocator->_scope_statistics[ scope ].reallocation_count;
+	}
+	return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::_Free( void * user_data, void * memory )
+{
+	if( nullptr == memory ) return;
+	auto context = reinterpret_cast<CallbackContext*>( user_data );
+	context->allocator->_Deallocate( memory );
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::_InternalAllocation( void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope )
+{
+	auto context = reinterpret_cast<CallbackContext*>( user_data );
+	std::lock_guard<std::mutex> lock( context->allocator->_mutex );
+	context->allocator->_category_statistics[ context->category ].internal_bytes_in_use	+= size;
+	context->allocator->_scope_statistics[ scope ].internal_bytes_in_use					+= size;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::_InternalFree( void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope )
+{
+	auto context = reinterpret_cast<CallbackContext*>( user_data );
+	std::lock_guard<std::mutex> lock( context->allocator->_mutex );
+	context->allocator->_category_statistics[ context->category ].internal_bytes_in_use	-= size;
+	context->allocator->_scope_statistics[ scope ].internal_bytes_in_use					-= size;
+}
+
+void * HostAllocator::_Allocate( HOST_ALLOCATION_CATEGORY category, size_t size, size_t alignment, VkSystemAllocationScope scope )
+{
+	if( 0 == size ) return nullptr;
+	alignment = std::max( alignment, alignof( HostAllocationHeader ) );
+
+	std::lock_guard<std::mutex> lock( _mutex );
+
+	HostAllocationHeader * header	= nullptr;
+	uint8_t * memory				= nullptr;
+
+#if BUILD_ENABLE_VULKAN_HOST_ALLOCATOR_POOLS
+	// pooled blocks are aligned to the header alignment only
+	if( alignment == alignof( HostAllocationHeader ) ) {
+		for( uint32_t c=0; c < HOST_ALLOCATION_POOL_CLASS_COUNT; ++c ) {
+			if( size <= HOST_ALLOCATION_POOL_CLASS_SIZES[ c ] ) {
+				auto block = reinterpret_cast<uint8_t*>( _PoolAllocate( c ) );
+				if( nullptr == block ) return nullptr;
+				header				= reinterpret_cast<HostAllocationHeader*>( block );
+				header->raw			= nullptr;
+				header->size_class	= uint8_t( c );
+				memory				= block + sizeof( HostAllocationHeader );
+				break;
+			}
+		}
+	}
+#endif
+
+	if( nullptr == header ) {
+		void * raw = std::malloc( sizeof( HostAllocationHeader ) + size + alignment );
+		if( nullptr == raw ) return nullptr;
+		memory				= reinterpret_cast<uint8_t*>( AlignUp( reinterpret_cast<uintptr_t>( raw ) + sizeof( HostAllocationHeader ), alignment ) );
+		header				= GetHeader( memory );
+		header->raw			= raw;
+		header->size_class	= HOST_ALLOCATION_NOT_POOLED;
+	}
+	header->size		= size;
+	header->category	= uint8_t( category );
+	header->scope		= uint8_t( scope );
+
+	_TrackAllocation( category, scope, size, HOST_ALLOCATION_NOT_POOLED != header->size_class );
+	return memory;
+}
+
+void HostAllocator::_Deallocate( void * memory )
+{
+	auto header = GetHeader( memory );
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	_TrackFree( HOST_ALLOCATION_CATEGORY( header->category ), VkSystemAllocationScope( header->scope ), size_t( header->size ) );
+	if( HOST_ALLOCATION_NOT_POOLED == header->size_class ) {
+		std::free( header->raw );
+	} else {
+		_PoolFree( header->size_class, header );
+	}
+}
+
+void * HostAllocator::_PoolAllocate( uint32_t size_class )
+{
+	if( nullptr == _pool_free_lists[ size_class ] ) {
+		// carve a new chunk into blocks of this size class
+		size_t block_size	= sizeof( HostAllocationHeader ) + HOST_ALLOCATION_POOL_CLASS_SIZES[ size_class ];
+		void * chunk		= std::malloc( HOST_ALLOCATION_POOL_CHUNK_SIZE + alignof( HostAllocationHeader ) );
+		if( nullptr == chunk ) return nullptr;
+		_pool_chunks.push_back( chunk );
+
+		auto begin			= AlignUp( reinterpret_cast<uintptr_t>( chunk ), alignof( HostAllocationHeader ) );
+		size_t block_count	= HOST_ALLOCATION_POOL_CHUNK_SIZE / block_size;
+		for( size_t i=0; i < block_count; ++i ) {
+			_PoolFree( size_class, reinterpret_cast<void*>( begin + i * block_size ) );
+		}
+	}
+	void * block					= _pool_free_lists[ size_class ];
+	_pool_free_lists[ size_class ]	= *reinterpret_cast<void**>( block );
+	return block;
+}
+
+void HostAllocator::_PoolFree( uint32_t size_class, void * block )
+{
+	*reinterpret_cast<void**>( block )	= _pool_free_lists[ size_class ];
+	_pool_free_lists[ size_class ]		= block;
+}
+
+void HostAllocator::_TrackAllocation( HOST_ALLOCATION_CATEGORY category, VkSystemAllocationScope scope, size_t size, bool pooled )
+{
+	for( auto s : { &_category_statistics[ category ], &_scope_statistics[ scope ] } ) {
+		++s->allocation_count;
+		if( pooled ) ++s->pooled_allocation_count;
+		s->bytes_in_use			+= size;
+		s->peak_bytes_in_use	= std::max( s->peak_bytes_in_use, s->bytes_in_use );
+	}
+}
+
+void HostAllocator::_TrackFree( HOST_ALLOCATION_CATEGORY category, VkSystemAllocationScope scope, size_t size )
+{
+	for( auto s : { &_category_statistics[ category ], &_scope_statistics[ scope ] } ) {
+		++s->free_count;
+		s->bytes_in_use			-= size;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <mutex>
+#include <vector>
+#include <ostream>
+
+constexpr uint32_t HOST_ALLOCATION_SCOPE_COUNT		= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+// Which part of the engine asked Vulkan for the host memory.
+enum HOST_ALLOCATION_CATEGORY : uint32_t
+{
+	HOST_ALLOCATION_CATEGORY_RENDERER		= 0,		// instance, device, debug callbacks
+	HOST_ALLOCATION_CATEGORY_WINDOW,					// surfaces, swapchains, render passes, framebuffers, sync objects
+	HOST_ALLOCATION_CATEGORY_PIPELINE,					// shader modules, pipelines and layouts
+	HOST_ALLOCATION_CATEGORY_SCENE,						// scene objects and indirect draw lists
+	HOST_ALLOCATION_CATEGORY_FRAME_ARENA,
+	HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY,				// vkAllocateMemory bookkeeping
+	HOST_ALLOCATION_CATEGORY_COUNT
+};
+
+struct HostAllocationStatistics
+{
+	uint64_t						allocation_count			= 0;
+	uint64_t						reallocation_count			= 0;
+	uint64_t						free_count					= 0;
+	uint64_t						pooled_allocation_count		= 0;		// served from the size class pools
+	uint64_t						bytes_in_use				= 0;
+	uint64_t						peak_bytes_in_use			= 0;
+	uint64_t						internal_bytes_in_use		= 0;		// driver internal allocations, reported only
+};
+
+// HostAllocator implements VkAllocationCallbacks so that host memory used by the driver becomes
+// visible. Statistics are tracked per engine subsystem ( category ) and per VkSystemAllocationScope.
+// Small allocations are served from size class pools to keep driver churn off the system heap.
+// Callbacks can be called from any thread, everything is guarded by a single mutex.
+class HostAllocator
+{
+public:
+	HostAllocator();
+	~HostAllocator();
+
+	// Returns nullptr if BUILD_ENABLE_VULKAN_HOST_ALLOCATOR is 0, Vulkan then uses the driver default.
+	const VkAllocationCallbacks					*	GetCallbacks( HOST_ALLOCATION_CATEGORY category ) const;
+
+	HostAllocationStatistics						GetCategoryStatistics( HOST_ALLOCATION_CATEGORY category );
+	HostAllocationStatistics						GetScopeStatistics( VkSystemAllocationScope scope );
+	HostAllocationStatistics						GetTotalStatistics();
+
+	void											PrintStatistics( std::ostream & stream );
+
+private:
+	struct CallbackContext
+	{
+		HostAllocator							*	allocator;
+		HOST_ALLOCATION_CATEGORY					category;
+	};
+
+	static VKAPI_ATTR void * VKAPI_CALL				_Allocation( void * user_data, size_t size, size_t alignment, VkSystemAllocationScope scope );
+	static VKAPI_ATTR void * VKAPI_CALL				_Reallocation( void * user_data, void * original, size_t size, size_t alignment, VkSystemAllocationScope scope );
+	static VKAPI_ATTR void VKAPI_CALL				_Free( void * user_data, void * memory );
+	static VKAPI_ATTR void VKAPI_CALL				_InternalAllocation( void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope );
+	static VKAPI_ATTR void VKAPI_CALL				_InternalFree( void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope );
+
+	void										*	_Allocate( HOST_ALLOCATION_CATEGORY category, size_t size, size_t alignment, VkSystemAllocationScope scope );
+	void											_Deallocate( void * memory );
+
+	void										*	_PoolAllocate( uint32_t size_class );
+	void											_PoolFree( uint32_t size_class, void * block );
+
+	void											_TrackAllocation( HOST_ALLOCATION_CATEGORY category, VkSystemAllocationScope scope, size_t size, bool pooled );
+	void											_TrackFree( HOST_ALLOCATION_CATEGORY category, VkSystemAllocationScope scope, size_t size );
+
+	std::mutex										_mutex;
+
+	CallbackContext									_contexts[ HOST_ALLOCATION_CATEGORY_COUNT ];
+	VkAllocationCallbacks							_callbacks[ HOST_ALLOCATION_CATEGORY_COUNT ];
+
+	HostAllocationStatistics						_category_statistics[ HOST_ALLOCATION_CATEGORY_COUNT ];
+	HostAllocationStatistics						_scope_statistics[ HOST_ALLOCATION_SCOPE_COUNT ];
+
+	std::vector<void*>								_pool_free_lists;		// one singly linked free list per size class
+	std::vector<void*>								_pool_chunks;
+};
@@ -0,0 +1,513 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+#include "VulkanTools.h"
+
+#include "Shared.hpp"
+#include "IndirectDrawList.h"
+#include "ComputePipeline.h"
+#include "Renderer.h"
+#include "Pipeline.h"
+#include "Window.h"
+#include "SO_DynamicMesh.h"
+#include "UniformBuffers.h"
+#include "FrameArena.h"
+
+#include <assert.h>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+
+// local workgroup size of pipelines/indirect_cull/comp.comp
+constexpr uint32_t INDIRECT_CULL_WORKGROUP_SIZE = 64;
+
+IndirectDrawList::IndirectDrawList( Renderer * renderer, Window * window, Pipeline * pipeline )
+{
+	assert( nullptr != window );
+	assert( nullptr != pipeline );
+	_renderer		= renderer;
+	_window			= window;
+	_pipeline		= pipeline;
+	_device			= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_SCENE );
+	_queue			= renderer->GetVulkanQueue();
+
+	_UpdateFrustumPlanes();
+
+	_cull_pipeline		= new ComputePipeline( _renderer, "indirect_cull" );
+
+	VkCommandPoolCreateInfo create_info {};
+	create_info.sType				= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	create_info.queueFamilyIndex	= _renderer->GetVulkanGraphicsQueueFamilyIndex();
+	create_info.flags				= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	ErrCheck( vkCreateCommandPool( _device, &create_info, _allocation_callbacks, &_command_pool ) );
+
+	// one cull and draw command buffer per frame in flight, re-recorded when their frame comes around
+	uint32_t frame_count				= _window->GetFrameArena()->GetFrameCount();
+	_cull_command_buffers.resize( frame_count );
+	_draw_command_buffers.resize( frame_count );
+	_command_buffers_stale.assign( frame_count, true );
+
+	VkCommandBufferAllocateInfo	allocate_info {};
+	allocate_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool			= _command_pool;
+	allocate_info.commandBufferCount	= frame_count;
+	allocate_info.level					= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _cull_command_buffers.data() ) );
+	ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _draw_command_buffers.data() ) );
+
+	_CreateDescriptorSet();
+	_CreateBuffers( 1024, 1024, 64 );
+}
+
+IndirectDrawList::~IndirectDrawList()
+{
+	vkDestroyCommandPool( _device, _command_pool, _allocation_callbacks );
+	_DestroyDescriptorSet();
+	_DestroyBuffers();
+	delete _cull_pipeline;
+}
+
+void IndirectDrawList::Update( const std::list<SceneObject*> & scene_objects )
+{
+	// find out how much space we need and whether objects were added, removed or resized
+	uint64_t vertex_count	= 0;
+	uint64_t index_count	= 0;
+	uint32_t record_count	= 0;
+	bool layout_changed		= false;
+	for( auto obj : scene_objects ) {
+		auto mesh = dynamic_cast<SO_DynamicMesh*>( obj );
+		if( nullptr == mesh ) continue;
+		uint32_t mesh_vertex_count	= uint32_t( mesh->GetRenderVertices().size() );
+		uint32_t mesh_index_count	= uint32_t( mesh->GetIndeces().size() * 3 );
+		if( record_count >= _packed_objects.size() ||
+			_packed_objects[ record_count ].mesh != mesh ||
+			_packed_objects[ record_count ].vertex_count != mesh_vertex_count ||
+			_packed_objects[ record_count ].index_count != mesh_index_count ) {
+			layout_changed	= true;
+		}
+		vertex_count	+= mesh_vertex_count;
+		index_count		+= mesh_index_count;
+		++record_count;
+	}
+	if( record_count != _packed_objects.size() ) {
+		layout_changed		= true;
+	}
+
+	if( vertex_count > _vertex_capacity || index_count > _index_capacity || record_count > _record_capacity ) {
+		// frames in flight still use the old buffers and descriptor set
+		_RetireBuffers();
+		_CreateDescriptorSet();
+		_CreateBuffers(
+			std::max( vertex_count, _vertex_capacity * 2 ),
+			std::max( index_count, _index_capacity * 2 ),
+			std::max( uint64_t( record_count ), _record_capacity * 2 ) );
+		// new buffers are empty
+		layout_changed		= true;
+	}
+	if( record_count != _record_count ) {
+		_record_count						= record_count;
+		_cull_parameters.record_count		= record_count;
+		_command_buffer_out_of_date			= true;
+	}
+
+	_UpdateFrustumPlanes();
+
+	// draw pipeline may have been swapped to it's optimized variant
+	if( _pipeline->GetGeneration() != _recorded_pipeline_generation ) {
+		_command_buffer_out_of_date		= true;
+	}
+
+	if( !layout_changed ) {
+		// steady state, only objects whose vertices or transform changed are written
+		for( uint32_t r=0; r < _record_count; ++r ) {
+			if( _packed_objects[ r ].render_revision != _packed_objects[ r ].mesh->GetRenderRevision() ) {
+				_WriteObject( r, false );
+			}
+		}
+		return;
+	}
+
+	// pack all geometry into the shared buffers again, indices are kept object local and offset with vertex_offset.
+	_packed_objects.resize( record_count );
+	uint32_t vertex_offset	= 0;
+	uint32_t index_offset	= 0;
+	uint32_t record_id		= 0;
+	for( auto obj : scene_objects ) {
+		auto mesh = dynamic_cast<SO_DynamicMesh*>( obj );
+		if( nullptr == mesh ) continue;
+
+		auto &packed				= _packed_objects[ record_id ];
+		packed.mesh					= mesh;
+		packed.vertex_offset		= vertex_offset;
+		packed.vertex_count			= uint32_t( mesh->GetRenderVertices().size() );
+		packed.first_index			= index_offset;
+		packed.index_count			= uint32_t( mesh->GetIndeces().size() * 3 );
+		_WriteObject( record_id, true );
+
+		vertex_offset				+= packed.vertex_count;
+		index_offset				+= packed.index_count;
+		++record_id;
+	}
+}
+
+void IndirectDrawList::_WriteObject( uint32_t record_id, bool write_indices )
+{
+	auto &packed				= _packed_objects[ record_id ];
+	auto &local_vertices		= packed.mesh->GetRenderVertices();
+	auto &transform				= packed.mesh->GetRenderTransform();
+	packed.render_revision		= packed.mesh->GetRenderRevision();
+
+	// Objects can't have their own push constants inside a single indirect draw so vertices are
+	// written in world space and the draw uses an identity model matrix.
+	// Everything goes through frame arena uploads, frames in flight keep reading the old data until the copy.
+	auto arena					= _window->GetFrameArena();
+	auto vertices				= reinterpret_cast<Mesh_Vertex*>( arena->AllocateUpload( _buffers[ BUFFER_VERTEX ].buffer,
+		VkDeviceSize( packed.vertex_offset ) * sizeof( Mesh_Vertex ), local_vertices.size() * sizeof( Mesh_Vertex ) ) );
+	auto record					= reinterpret_cast<IndirectDrawRecord*>( arena->AllocateUpload( _buffers[ BUFFER_DRAW_RECORD ].buffer,
+		VkDeviceSize( record_id ) * sizeof( IndirectDrawRecord ), sizeof( IndirectDrawRecord ) ) );
+	if( nullptr == vertices || nullptr == record ) {
+		return;
+	}
+	float bounds_min[ 3 ]		{ FLT_MAX, FLT_MAX, FLT_MAX };
+	float bounds_max[ 3 ]		{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for( size_t v=0; v < local_vertices.size(); ++v ) {
+		// bounds from a local copy, mapped memory may be uncached
+		Mesh_Vertex world;
+		TransformPoint( transform, local_vertices[ v ].loc, world.loc );
+		vertices[ v ]			= world;
+		for( uint32_t a=0; a < 3; ++a ) {
+			bounds_min[ a ]		= std::min( bounds_min[ a ], world.loc[ a ] );
+			bounds_max[ a ]		= std::max( bounds_max[ a ], world.loc[ a ] );
+		}
+	}
+	// upload memory is write only, the whole record is written every time
+	IndirectDrawRecord written {};
+	written.index_count			= packed.index_count;
+	written.first_index			= packed.first_index;
+	written.vertex_offset		= int32_t( packed.vertex_offset );
+	written.padding				= 0;
+	for( uint32_t a=0; a < 3; ++a ) {
+		written.bounds_min[ a ]	= bounds_min[ a ];
+		written.bounds_max[ a ]	= bounds_max[ a ];
+	}
+	*record						= written;
+
+	if( write_indices ) {
+		auto &local_indices		= packed.mesh->GetIndeces();
+		auto indices			= arena->AllocateUpload( _buffers[ BUFFER_INDEX ].buffer,
+			VkDeviceSize( packed.first_index ) * sizeof( uint32_t ), local_indices.size() * sizeof( Mesh_Polygon ) );
+		if( nullptr != indices ) {
+			std::memcpy( indices, local_indices.data(), local_indices.size() * sizeof( Mesh_Polygon ) );
+		}
+	}
+}
+
+bool IndirectDrawList::IsHandled( const SceneObject * scene_object ) const
+{
+	return nullptr != dynamic_cast<const SO_DynamicMesh*>( scene_object );
+}
+
+void IndirectDrawList::_UpdateFrustumPlanes()
+{
+	// bounds are in world space so the planes come from the full view projection
+	auto &camera = _window->GetCamera();
+	float planes[ 6 ][ 4 ];
+	ExtractFrustumPlanes( camera.projection * camera.view, planes );
+	if( std::memcmp( planes, _cull_parameters.frustum_planes, sizeof( planes ) ) ) {
+		std::memcpy( _cull_parameters.frustum_planes, planes, sizeof( _cull_parameters.frustum_planes ) );
+		// planes are recorded as push constants
+		_command_buffer_out_of_date		= true;
+	}
+}
+
+VkCommandBuffer IndirectDrawList::GetCullCommandBuffer( bool rebuild_buffers )
+{
+	return _cull_command_buffers[ _PrepareCommandBuffers( rebuild_buffers ) ];
+}
+
+VkCommandBuffer IndirectDrawList::GetDrawCommandBuffer( bool rebuild_buffers )
+{
+	return _draw_command_buffers[ _PrepareCommandBuffers( rebuild_buffers ) ];
+}
+
+uint32_t IndirectDrawList::_PrepareCommandBuffers( bool rebuild_buffers )
+{
+	if( _command_buffer_out_of_date || rebuild_buffers ) {
+		_recorded_pipeline_generation	= _pipeline->GetGeneration();
+		_command_buffers_stale.assign( _command_buffers_stale.size(), true );
+		_command_buffer_out_of_date		= false;
+	}
+	// other frames may still be executing theirs, this one was waited for by the frame arena
+	uint32_t frame = _window->GetFrameArena()->GetFrameIndex();
+	if( _command_buffers_stale[ frame ] ) {
+		_RecordCommandBuffers( _cull_command_buffers[ frame ], _draw_command_buffers[ frame ] );
+		_command_buffers_stale[ frame ]	= false;
+	}
+	return frame;
+}
+
+void IndirectDrawList::PrintStatistics( std::ostream & stream ) const
+{
+	// count buffer is written by the cull pass, coherent memory and an idle queue make it visible
+	stream << "Indirect draw: " << *_mapped_draw_count << " of " << _record_count << " objects visible in the last frame\n";
+}
+
+
+void IndirectDrawList::_CreateBuffers( uint64_t vertex_count, uint64_t index_count, uint64_t record_count )
+{
+	_vertex_capacity		= vertex_count;
+	_index_capacity			= index_count;
+	_record_capacity		= record_count;
+
+	_buffers.resize( BUFFER_COUNT );
+	_buffers[ BUFFER_VERTEX ].memory_size			= vertex_count * sizeof( Mesh_Vertex );
+	_buffers[ BUFFER_INDEX ].memory_size			= index_count * sizeof( uint32_t );
+	_buffers[ BUFFER_DRAW_RECORD ].memory_size		= record_count * sizeof( IndirectDrawRecord );
+	_buffers[ BUFFER_DRAW_COMMAND ].memory_size		= record_count * sizeof( VkDrawIndexedIndirectCommand );
+	_buffers[ BUFFER_DRAW_COUNT ].memory_size		= sizeof( uint32_t );
+
+	// geometry and records are filled by frame arena uploads, only the count is read back
+	VkBufferUsageFlags usages[ BUFFER_COUNT ] {
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	};
+
+	for( uint32_t i=0; i < BUFFER_COUNT; ++i ) {
+		_buffers[ i ].memory_properties			= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		if( BUFFER_DRAW_COUNT == i ) {
+			_buffers[ i ].memory_properties		= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+
+		VkBufferCreateInfo buffer_create_info {};
+		buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size					= _buffers[ i ].memory_size;
+		buffer_create_info.usage				= usages[ i ];
+		buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+		ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &_buffers[ i ].buffer ) );
+	}
+
+	AllocateBuffersMemory( _renderer, _buffers );
+
+	for( auto &b : _buffers ) {
+		ErrCheck( vkBindBufferMemory( _device, b.buffer, b.memory, 0 ) );
+	}
+
+	// count is read back for statistics, keep it mapped
+	void * draw_count = nullptr;
+	ErrCheck( vkMapMemory( _device, _buffers[ BUFFER_DRAW_COUNT ].memory, 0, VK_WHOLE_SIZE, 0, &draw_count ) );
+	_mapped_draw_count	= reinterpret_cast<uint32_t*>( draw_count );
+
+	_UpdateDescriptorSet();
+	_command_buffer_out_of_date		= true;
+}
+
+void IndirectDrawList::_DestroyBuffers()
+{
+	if( _buffers.size() == 0 ) {
+		return;
+	}
+	vkUnmapMemory( _device, _buffers[ BUFFER_DRAW_COUNT ].memory );
+	_mapped_draw_count	= nullptr;
+
+	for( auto &b : _buffers ) {
+		vkDestroyBuffer( _device, b.buffer, _allocation_callbacks );
+	}
+	FreeBuffersMemory( _renderer, _buffers );
+	_buffers.clear();
+}
+
+void IndirectDrawList::_RetireBuffers()
+{
+	auto renderer				= _renderer;
+	auto device					= _device;
+	auto allocation_callbacks	= _allocation_callbacks;
+	auto retired_buffers		= _buffers;
+	auto retired_pool			= _descriptor_pool;
+	_renderer->DeferDestroy( [ renderer, device, allocation_callbacks, retired_buffers, retired_pool ]() mutable {
+		vkUnmapMemory( device, retired_buffers[ BUFFER_DRAW_COUNT ].memory );
+		for( auto &b : retired_buffers ) {
+			vkDestroyBuffer( device, b.buffer, allocation_callbacks );
+		}
+		FreeBuffersMemory( renderer, retired_buffers );
+		vkDestroyDescriptorPool( device, retired_pool, allocation_callbacks );
+	} );
+	_mapped_draw_count	= nullptr;
+	_buffers.clear();
+	_descriptor_pool	= VK_NULL_HANDLE;
+	_descriptor_set		= VK_NULL_HANDLE;
+}
+
+void IndirectDrawList::_CreateDescriptorSet()
+{
+	VkDescriptorPoolSize pool_size {};
+	pool_size.type					= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount		= 3;
+
+	VkDescriptorPoolCreateInfo pool_create_info {};
+	pool_create_info.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets		= 1;
+	pool_create_info.poolSizeCount	= 1;
+	pool_create_info.pPoolSizes		= &pool_size;
+	ErrCheck( vkCreateDescriptorPool( _device, &pool_create_info, _allocation_callbacks, &_descriptor_pool ) );
+
+	VkDescriptorSetLayout set_layout	= _cull_pipeline->GetVulkanDescriptorSetLayout();
+	VkDescriptorSetAllocateInfo allocate_info {};
+	allocate_info.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorPool		= _descriptor_pool;
+	allocate_info.descriptorSetCount	= 1;
+	allocate_info.pSetLayouts			= &set_layout;
+	ErrCheck( vkAllocateDescriptorSets( _device, &allocate_info, &_descriptor_set ) );
+}
+
+void IndirectDrawList::_UpdateDescriptorSet()
+{
+	VkDescriptorBufferInfo buffer_infos[ 3 ] {};
+	buffer_infos[ 0 ].buffer		= _buffers[ BUFFER_DRAW_RECORD ].buffer;
+	buffer_infos[ 1 ].buffer		= _buffers[ BUFFER_DRAW_COMMAND ].buffer;
+	buffer_infos[ 2 ].buffer		= _buffers[ BUFFER_DRAW_COUNT ].buffer;
+
+	VkWriteDescriptorSet writes[ 3 ] {};
+	for( uint32_t i=0; i < 3; ++i ) {
+		buffer_infos[ i ].offset		= 0;
+		buffer_infos[ i ].range			= VK_WHOLE_SIZE;
+
+		writes[ i ].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[ i ].dstSet				= _descriptor_set;
+		writes[ i ].dstBinding			= i;
+		writes[ i ].descriptorCount		= 1;
+		writes[ i ].descriptorType		= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[ i ].pBufferInfo			= &buffer_infos[ i ];
+	}
+	vkUpdateDescriptorSets( _device, 3, writes, 0, nullptr );
+}
+
+void IndirectDrawList::_DestroyDescriptorSet()
+{
+	vkDestroyDescriptorPool( _device, _descriptor_pool, _allocation_callbacks );
+	_descriptor_pool	= VK_NULL_HANDLE;
+	_descriptor_set		= VK_NULL_HANDLE;
+}
+
+void IndirectDrawList::_RecordCommandBuffers( VkCommandBuffer cull_command_buffer, VkCommandBuffer draw_command_buffer )
+{
+	VkBuffer command_buffer		= _buffers[ BUFFER_DRAW_COMMAND ].buffer;
+	VkBuffer count_buffer		= _buffers[ BUFFER_DRAW_COUNT ].buffer;
+
+	// cull command buffer, this is executed outside of the render pass
+	{
+		VkCommandBufferInheritanceInfo inheritance_info {};
+		inheritance_info.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+		VkCommandBufferBeginInfo begin_info {};
+		begin_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.pInheritanceInfo			= &inheritance_info;
+		ErrCheck( vkBeginCommandBuffer( cull_command_buffer, &begin_info ) );
+
+		// previous frame indirect reads must be done before we clear the buffers
+		VkBufferMemoryBarrier clear_barriers[ 2 ] {};
+		for( auto &b : clear_barriers ) {
+			b.sType							= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			b.srcAccessMask					= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			b.dstAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+			b.srcQueueFamilyIndex			= VK_QUEUE_FAMILY_IGNORED;
+			b.dstQueueFamilyIndex			= VK_QUEUE_FAMILY_IGNORED;
+			b.offset						= 0;
+			b.size							= VK_WHOLE_SIZE;
+		}
+		clear_barriers[ 0 ].buffer			= command_buffer;
+		clear_barriers[ 1 ].buffer			= count_buffer;
+		vkCmdPipelineBarrier( cull_command_buffer,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			2, clear_barriers,
+			0, nullptr );
+
+		// zeroed commands have instanceCount of 0, this is what makes the non-count fallback work
+		vkCmdFillBuffer( cull_command_buffer, command_buffer, 0, VK_WHOLE_SIZE, 0 );
+		vkCmdFillBuffer( cull_command_buffer, count_buffer, 0, VK_WHOLE_SIZE, 0 );
+
+		for( auto &b : clear_barriers ) {
+			b.srcAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+			b.dstAccessMask					= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		vkCmdPipelineBarrier( cull_command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			2, clear_barriers,
+			0, nullptr );
+
+		vkCmdBindPipeline( cull_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline->GetVulkanPipeline() );
+		vkCmdBindDescriptorSets( cull_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline->GetVulkanPipelineLayout(), 0, 1, &_descriptor_set, 0, nullptr );
+		vkCmdPushConstants( cull_command_buffer, _cull_pipeline->GetVulkanPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( IndirectCullParameters ), &_cull_parameters );
+		vkCmdDispatch( cull_command_buffer, ( _record_count + INDIRECT_CULL_WORKGROUP_SIZE - 1 ) / INDIRECT_CULL_WORKGROUP_SIZE, 1, 1 );
+
+		// compacted draw list must be written before the indirect draw reads it
+		for( auto &b : clear_barriers ) {
+			b.srcAccessMask					= VK_ACCESS_SHADER_WRITE_BIT;
+			b.dstAccessMask					= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		}
+		vkCmdPipelineBarrier( cull_command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0,
+			0, nullptr,
+			2, clear_barriers,
+			0, nullptr );
+
+		ErrCheck( vkEndCommandBuffer( cull_command_buffer ) );
+	}
+
+	// draw command buffer, no framebuffer so it works for every swapchain image
+	{
+		auto draw_indexed_indirect_count	= _renderer->GetVulkanCmdDrawIndexedIndirectCount();
+		bool multi_draw_indirect			= _renderer->GetVulkanEnabledFeatures().multiDrawIndirect == VK_TRUE;
+		uint32_t stride						= sizeof( VkDrawIndexedIndirectCommand );
+
+		VkCommandBufferInheritanceInfo inheritance_info {};
+		inheritance_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance_info.renderPass				= _window->GetRenderPass();
+		inheritance_info.subpass				= 0;
+		inheritance_info.framebuffer			= VK_NULL_HANDLE;
+
+		VkCommandBufferBeginInfo begin_info {};
+		begin_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags						= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		begin_info.pInheritanceInfo				= &inheritance_info;
+		ErrCheck( vkBeginCommandBuffer( draw_command_buffer, &begin_info ) );
+
+		vkCmdBindPipeline( draw_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->GetVulkanPipeline() );
+		_window->CmdSetViewport( draw_command_buffer );
+
+		VkDescriptorSet camera_descriptor_set	= _window->GetVulkanDescriptorSet();
+		vkCmdBindDescriptorSets( draw_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->GetVulkanPipelineLayout(), 0, 1, &camera_descriptor_set, 0, nullptr );
+		PC_Object object_constants {};
+		object_constants.model					= Matrix4Identity();
+		vkCmdPushConstants( draw_command_buffer, _pipeline->GetVulkanPipelineLayout(), _pipeline->GetPushConstantStageFlags(), 0, sizeof( PC_Object ), &object_constants );
+
+		VkDeviceSize vertex_buffer_offsets[] { 0 };
+		vkCmdBindVertexBuffers( draw_command_buffer, 0, 1, &_buffers[ BUFFER_VERTEX ].buffer, vertex_buffer_offsets );
+		vkCmdBindIndexBuffer( draw_command_buffer, _buffers[ BUFFER_INDEX ].buffer, 0, VK_INDEX_TYPE_UINT32 );
+
+		if( nullptr != draw_indexed_indirect_count ) {
+			// GPU decides the draw count
+			draw_indexed_indirect_count( draw_command_buffer, command_buffer, 0, count_buffer, 0, _record_count, stride );
+		} else if( multi_draw_indirect ) {
+			// culled tail of the list has instanceCount of 0
+			vkCmdDrawIndexedIndirect( draw_command_buffer, command_buffer, 0, _record_count, stride );
+		} else {
+			for( uint32_t d=0; d < _record_count; ++d ) {
+				vkCmdDrawIndexedIndirect( draw_command_buffer, command_buffer, d * stride, 1, stride );
+			}
+		}
+
+		ErrCheck( vkEndCommandBuffer( draw_command_buffer ) );
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "VulkanCollections.h"
+
+#include <vector>
+#include <list>
+#include <ostream>
+
+class Renderer;
+class Window;
+class Pipeline;
+class ComputePipeline;
+class SceneObject;
+class SO_DynamicMesh;
+
+// Per object draw record, layout must match "DrawRecord" in pipelines/indirect_cull/comp.comp
+struct IndirectDrawRecord
+{
+	uint32_t			index_count;
+	uint32_t			first_index;
+	int32_t				vertex_offset;
+	uint32_t			padding;
+	float				bounds_min[ 4 ];		// xyz used, w is padding
+	float				bounds_max[ 4 ];		// xyz used, w is padding
+};
+
+// Push constants of the culling compute shader, planes are in "ax + by + cz + d >= 0 is inside" form
+struct IndirectCullParameters
+{
+	float				frustum_planes[ 6 ][ 4 ];
+	uint32_t			record_count;
+};
+
+// IndirectDrawList is used by a Scene in indirect draw mode. Geometry of all the scene objects
+// is packed into shared vertex and index buffers together with a per object draw record buffer.
+// A compute pass culls the records against the view frustum and compacts the visible ones into
+// an indirect command buffer which is then drawn with a single indirect draw call.
+// Command buffers are only re-recorded when the object count or buffers change and geometry is
+// only rewritten for objects that changed, so the CPU cost of drawing doesn't grow with the
+// amount of static objects.
+class IndirectDrawList
+{
+public:
+	IndirectDrawList( Renderer * renderer, Window * window, Pipeline * pipeline );
+	~IndirectDrawList();
+
+	// Writes geometry and draw records of supported objects that changed since the last call into
+	// the shared buffers, everything when objects were added or removed. Frustum planes follow the window camera.
+	// Writes are frame arena uploads of the window, growing the buffers defers destroying the old ones.
+	void								Update( const std::list<SceneObject*> & scene_objects );
+
+	// Returns true if the object is drawn by this list instead of its own command buffers.
+	bool								IsHandled( const SceneObject * scene_object ) const;
+
+	// compute command buffer, must be executed outside of a render pass before the draw command buffer.
+	VkCommandBuffer						GetCullCommandBuffer( bool rebuild_buffers = false );
+	// secondary command buffer for the window render pass.
+	VkCommandBuffer						GetDrawCommandBuffer( bool rebuild_buffers = false );
+
+	// Prints how many records the last cull pass kept. The queue must be idle.
+	void								PrintStatistics( std::ostream & stream ) const;
+
+private:
+	enum BUFFER_ID : uint32_t
+	{
+		BUFFER_VERTEX			= 0,
+		BUFFER_INDEX,
+		BUFFER_DRAW_RECORD,
+		BUFFER_DRAW_COMMAND,
+		BUFFER_DRAW_COUNT,
+		BUFFER_COUNT
+	};
+
+	// Where an object's geometry lives in the shared buffers.
+	struct PackedObject
+	{
+		const SO_DynamicMesh		*	mesh				= nullptr;
+		uint64_t						render_revision		= 0;		// of the geometry in the buffers
+		uint32_t						vertex_offset		= 0;
+		uint32_t						vertex_count		= 0;
+		uint32_t						first_index			= 0;
+		uint32_t						index_count			= 0;
+	};
+
+	// Writes world space vertices and the draw record, indices only when the object moved in the buffers.
+	void								_WriteObject( uint32_t record_id, bool write_indices );
+
+	void								_CreateBuffers( uint64_t vertex_count, uint64_t index_count, uint64_t record_count );
+	void								_DestroyBuffers();
+	// Hands the buffers and the descriptor pool to Renderer::DeferDestroy, frames in flight may still use them.
+	void								_RetireBuffers();
+
+	void								_CreateDescriptorSet();
+	void								_UpdateDescriptorSet();
+	void								_DestroyDescriptorSet();
+
+	void								_UpdateFrustumPlanes();
+
+	// Marks the command buffers of every frame stale when something changed and records the
+	// current frame's if needed, returns the frame index.
+	uint32_t							_PrepareCommandBuffers( bool rebuild_buffers );
+	void								_RecordCommandBuffers( VkCommandBuffer cull_command_buffer, VkCommandBuffer draw_command_buffer );
+
+	Renderer						*	_renderer						= nullptr;
+	Window							*	_window							= nullptr;
+	Pipeline						*	_pipeline						= nullptr;
+	ComputePipeline					*	_cull_pipeline					= nullptr;
+	VkDevice							_device							= VK_NULL_HANDLE;
+	const VkAllocationCallbacks		*	_allocation_callbacks			= nullptr;
+	VkQueue								_queue							= VK_NULL_HANDLE;
+
+	std::vector<Buffer>					_buffers;
+	uint32_t						*	_mapped_draw_count				= nullptr;
+
+	uint64_t							_vertex_capacity				= 0;
+	uint64_t							_index_capacity					= 0;
+	uint64_t							_record_capacity				= 0;
+	uint32_t							_record_count					= 0;
+	std::vector<PackedObject>			_packed_objects;		// in record order
+
+	IndirectCullParameters				_cull_parameters				= {};
+
+	VkDescriptorPool					_descriptor_pool				= VK_NULL_HANDLE;
+	VkDescriptorSet						_descriptor_set					= VK_NULL_HANDLE;
+
+	VkCommandPool						_command_pool					= VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer>		_cull_command_buffers;			// per frame in flight
+	std::vector<VkCommandBuffer>		_draw_command_buffers;			// per frame in flight
+	std::vector<bool>					_command_buffers_stale;
+
+	bool								_command_buffer_out_of_date		= true;
+	uint32_t							_recorded_pipeline_generation	= 0;
+};
@@ -0,0 +1,175 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace {
+// queue of the current thread, only valid for the JobSystem it was set by
+thread_local const JobSystem	*	tls_job_system			= nullptr;
+thread_local uint32_t				tls_queue_index			= 0;
+}
+
+JobSystem::JobSystem( uint32_t worker_count )
+{
+	if( 0 == worker_count ) {
+		uint32_t hardware_threads	= std::thread::hardware_concurrency();
+		worker_count				= hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+	_foreign_push_counter	= 0;
+	_queued_jobs			= 0;
+	tls_job_system			= this;
+	tls_queue_index			= 0;
+
+	_queues.resize( worker_count + 1 );
+	for( auto &q : _queues ) {
+		q = new WorkQueue;
+	}
+	_workers.reserve( worker_count );
+	for( uint32_t i=0; i < worker_count; ++i ) {
+		_workers.push_back( std::thread( &JobSystem::_WorkerLoop, this, i + 1 ) );
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	assert( 0 == _queued_jobs && "JobSystem destroyed with jobs still queued." );
+	{
+		std::lock_guard<std::mutex> lock( _sleep_mutex );
+		_quit = true;
+	}
+	_sleep_condition.notify_all();
+	for( auto &w : _workers ) {
+		w.join();
+	}
+	for( auto q : _queues ) {
+		delete q;
+	}
+	if( tls_job_system == this ) {
+		tls_job_system		= nullptr;
+	}
+}
+
+void JobSystem::Run( JobCounter & counter, std::function<void()> job )
+{
+	counter.fetch_add( 1 );
+	Job j;
+	j.function			= std::move( job );
+	j.counter			= &counter;
+	_Push( std::move( j ) );
+	_Wake( 1 );
+}
+
+void JobSystem::ParallelFor( JobCounter & counter, uint32_t count, uint32_t batch_size, const std::function<void( uint32_t begin, uint32_t end )> & body )
+{
+	if( 0 == count ) return;
+	if( 0 == batch_size ) batch_size = 1;
+
+	uint32_t batch_count	= ( count + batch_size - 1 ) / batch_size;
+	counter.fetch_add( batch_count );
+	for( uint32_t begin=0; begin < count; begin += batch_size ) {
+		Job j;
+		j.range_function	= &body;
+		j.begin				= begin;
+		j.end				= std::min( begin + batch_size, count );
+		j.counter			= &counter;
+		_Push( std::move( j ) );
+	}
+	_Wake( batch_count );
+}
+
+void JobSystem::Wait( JobCounter & counter )
+{
+	while( counter.load() > 0 ) {
+		if( !_TryExecute() ) {
+			// remaining jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+uint32_t JobSystem::GetThreadCount() const
+{
+	return uint32_t( _queues.size() );
+}
+
+void JobSystem::_WorkerLoop( uint32_t queue_index )
+{
+	tls_job_system		= this;
+	tls_queue_index		= queue_index;
+	while( true ) {
+		if( _TryExecute() ) continue;
+
+		std::unique_lock<std::mutex> lock( _sleep_mutex );
+		_sleep_condition.wait( lock, [ this ]() { return _quit || _queued_jobs.load() > 0; } );
+		if( _quit ) return;
+	}
+}
+
+void JobSystem::_Push( Job && job )
+{
+	auto queue = _queues[ _GetQueueIndex() ];
+	{
+		std::lock_guard<std::mutex> lock( queue->mutex );
+		queue->jobs.push_back( std::move( job ) );
+	}
+	_queued_jobs.fetch_add( 1 );
+}
+
+void JobSystem::_Wake( uint32_t count )
+{
+	// taking the lock orders the wake up after a worker's predicate check
+	{
+		std::lock_guard<std::mutex> lock( _sleep_mutex );
+	}
+	if( count > 1 ) {
+		_sleep_condition.notify_all();
+	} else {
+		_sleep_condition.notify_one();
+	}
+}
+
+bool JobSystem::_TryExecute()
+{
+	uint32_t own		= _GetQueueIndex();
+	uint32_t count		= uint32_t( _queues.size() );
+	Job job;
+	bool found			= false;
+	for( uint32_t i=0; i < count && !found; ++i ) {
+		auto queue = _queues[ ( own + i ) % count ];
+		std::lock_guard<std::mutex> lock( queue->mutex );
+		if( queue->jobs.empty() ) continue;
+		if( 0 == i ) {
+			// own queue, newest first keeps the data it touches in cache
+			job		= std::move( queue->jobs.back() );
+			queue->jobs.pop_back();
+		} else {
+			// steal the oldest, it's likely the biggest piece of work left
+			job		= std::move( queue->jobs.front() );
+			queue->jobs.pop_front();
+		}
+		found		= true;
+	}
+	if( !found ) return false;
+	_queued_jobs.fetch_sub( 1 );
+
+	if( job.range_function ) {
+		( *job.range_function )( job.begin, job.end );
+	} else {
+		job.function();
+	}
+	job.counter->fetch_sub( 1 );
+	return true;
+}
+
+uint32_t JobSystem::_GetQueueIndex()
+{
+	if( tls_job_system == this ) {
+		return tls_queue_index;
+	}
+	// threads outside the system share the deques round robin
+	return _foreign_push_counter.fetch_add( 1 ) % uint32_t( _queues.size() );
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Counts unfinished jobs, every Run and ParallelFor batch adds one and removes it when done.
+typedef std::atomic<uint32_t> JobCounter;
+
+// Work stealing job scheduler. Every worker thread and the thread that created the
+// JobSystem own a deque, owners take their newest job first and idle threads steal the
+// oldest job of another deque. Waiting threads execute jobs instead of blocking so jobs
+// may spawn and wait on other jobs.
+class JobSystem
+{
+public:
+	// 0 workers = one per hardware thread minus the creating thread.
+	JobSystem( uint32_t worker_count = 0 );
+	~JobSystem();
+
+	// Queues a job, can be called from any thread.
+	void								Run( JobCounter & counter, std::function<void()> job );
+
+	// Splits [0, count) into batches of batch_size and queues one job per batch. Returns right away,
+	// body must stay alive until the counter has been waited on.
+	void								ParallelFor( JobCounter & counter, uint32_t count, uint32_t batch_size, const std::function<void( uint32_t begin, uint32_t end )> & body );
+
+	// Executes queued jobs until the counter reaches zero.
+	void								Wait( JobCounter & counter );
+
+	// Worker threads plus the creating thread.
+	uint32_t							GetThreadCount() const;
+
+private:
+	struct Job
+	{
+		std::function<void()>										function;
+		const std::function<void( uint32_t, uint32_t )>			*	range_function	= nullptr;	// parallel for batch, avoids a std::function per batch
+		uint32_t													begin			= 0;
+		uint32_t													end				= 0;
+		JobCounter												*	counter			= nullptr;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex							mutex;
+		std::deque<Job>						jobs;
+	};
+
+	void								_WorkerLoop( uint32_t queue_index );
+	void								_Push( Job && job );
+	void								_Wake( uint32_t count );
+	bool								_TryExecute();
+	uint32_t							_GetQueueIndex();
+
+	std::vector<std::thread>			_workers;
+	std::vector<WorkQueue*>				_queues;				// 0 belongs to the creating thread
+	std::atomic<uint32_t>				_foreign_push_counter;	// spreads pushes from threads without a queue
+
+	std::atomic<uint32_t>				_queued_jobs;
+	std::mutex							_sleep_mutex;
+	std::condition_variable				_sleep_condition;
+	bool								_quit					= false;
+};
@@ -0,0 +1,81 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "MappedFile.h"
+
+#if VK_USE_PLATFORM_XCB_KHR
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if VK_USE_PLATFORM_WIN32_KHR
+
+MappedFile::MappedFile( const std::string & path )
+{
+	_win32_file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if( _win32_file == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+	LARGE_INTEGER size {};
+	if( !GetFileSizeEx( _win32_file, &size ) || size.QuadPart == 0 ) {
+		return;
+	}
+	_win32_mapping = CreateFileMappingA( _win32_file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !_win32_mapping ) {
+		return;
+	}
+	_data	= MapViewOfFile( _win32_mapping, FILE_MAP_READ, 0, 0, 0 );
+	_size	= _data ? size_t( size.QuadPart ) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if( _data )									UnmapViewOfFile( _data );
+	if( _win32_mapping )						CloseHandle( _win32_mapping );
+	if( _win32_file != INVALID_HANDLE_VALUE )	CloseHandle( _win32_file );
+}
+
+#elif VK_USE_PLATFORM_XCB_KHR
+
+MappedFile::MappedFile( const std::string & path )
+{
+	_posix_file = open( path.c_str(), O_RDONLY );
+	if( _posix_file < 0 ) {
+		return;
+	}
+	struct stat file_stat {};
+	if( fstat( _posix_file, &file_stat ) != 0 || file_stat.st_size == 0 ) {
+		return;
+	}
+	void * data = mmap( nullptr, size_t( file_stat.st_size ), PROT_READ, MAP_PRIVATE, _posix_file, 0 );
+	if( data == MAP_FAILED ) {
+		return;
+	}
+	_data	= data;
+	_size	= size_t( file_stat.st_size );
+}
+
+MappedFile::~MappedFile()
+{
+	if( _data )						munmap( const_cast<void*>( _data ), _size );
+	if( _posix_file >= 0 )			close( _posix_file );
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return _data != nullptr;
+}
+
+const void * MappedFile::GetData() const
+{
+	return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return _size;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <string>
+
+// Read only view of a whole file mapped into memory. Data is page aligned and stays valid until
+// the object is destroyed. Nothing is copied, pages are loaded by the OS on first access.
+class MappedFile
+{
+public:
+	MappedFile( const std::string & path );
+	~MappedFile();
+
+	MappedFile( const MappedFile & other ) = delete;
+	MappedFile & operator=( const MappedFile & other ) = delete;
+
+	bool									IsOpen() const;
+	const void							*	GetData() const;
+	size_t									GetSize() const;
+
+private:
+	const void							*	_data							= nullptr;
+	size_t									_size							= 0;
+
+#if VK_USE_PLATFORM_WIN32_KHR
+	HANDLE									_win32_file						= INVALID_HANDLE_VALUE;
+	HANDLE									_win32_mapping					= nullptr;
+#elif VK_USE_PLATFORM_XCB_KHR
+	int										_posix_file						= -1;
+#endif
+};
@@ -0,0 +1,125 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "Shared.hpp"
+#include "Matrix.h"
+
+#include <cmath>
+#include <cstring>
+
+// column major element access
+#define M( matrix, row, column )		( matrix ).data[ ( column ) * 4 + ( row ) ]
+
+Matrix4 Matrix4Identity()
+{
+	Matrix4 m {};
+	M( m, 0, 0 )		= 1.0f;
+	M( m, 1, 1 )		= 1.0f;
+	M( m, 2, 2 )		= 1.0f;
+	M( m, 3, 3 )		= 1.0f;
+	return m;
+}
+
+Matrix4 Matrix4Translation( float x, float y, float z )
+{
+	Matrix4 m			= Matrix4Identity();
+	M( m, 0, 3 )		= x;
+	M( m, 1, 3 )		= y;
+	M( m, 2, 3 )		= z;
+	return m;
+}
+
+Matrix4 Matrix4Scale( float x, float y, float z )
+{
+	Matrix4 m			= Matrix4Identity();
+	M( m, 0, 0 )		= x;
+	M( m, 1, 1 )		= y;
+	M( m, 2, 2 )		= z;
+	return m;
+}
+
+Matrix4 Matrix4RotationZ( float radians )
+{
+	Matrix4 m			= Matrix4Identity();
+	float c				= std::cos( radians );
+	float s				= std::sin( radians );
+	M( m, 0, 0 )		= c;
+	M( m, 0, 1 )		= -s;
+	M( m, 1, 0 )		= s;
+	M( m, 1, 1 )		= c;
+	return m;
+}
+
+Matrix4 Matrix4Perspective( float vertical_fov_radians, float aspect_ratio, float near_plane, float far_plane )
+{
+	assert( aspect_ratio > 0.0f );
+	assert( far_plane > near_plane );
+	float f				= 1.0f / std::tan( vertical_fov_radians / 2.0f );
+	Matrix4 m {};
+	M( m, 0, 0 )		= f / aspect_ratio;
+	M( m, 1, 1 )		= -f;
+	M( m, 2, 2 )		= far_plane / ( near_plane - far_plane );
+	M( m, 2, 3 )		= ( near_plane * far_plane ) / ( near_plane - far_plane );
+	M( m, 3, 2 )		= -1.0f;
+	return m;
+}
+
+Matrix4 Matrix4Orthographic( float left, float right, float top, float bottom, float near_plane, float far_plane )
+{
+	Matrix4 m			= Matrix4Identity();
+	M( m, 0, 0 )		= 2.0f / ( right - left );
+	M( m, 1, 1 )		= 2.0f / ( bottom - top );
+	M( m, 2, 2 )		= 1.0f / ( far_plane - near_plane );
+	M( m, 0, 3 )		= -( right + left ) / ( right - left );
+	M( m, 1, 3 )		= -( bottom + top ) / ( bottom - top );
+	M( m, 2, 3 )		= -near_plane / ( far_plane - near_plane );
+	return m;
+}
+
+Matrix4 operator*( const Matrix4 & a, const Matrix4 & b )
+{
+	Matrix4 m {};
+	for( uint32_t column=0; column < 4; ++column ) {
+		for( uint32_t row=0; row < 4; ++row ) {
+			float sum = 0.0f;
+			for( uint32_t i=0; i < 4; ++i ) {
+				sum += M( a, row, i ) * M( b, i, column );
+			}
+			M( m, row, column ) = sum;
+		}
+	}
+	return m;
+}
+
+void TransformPoint( const Matrix4 & matrix, const float in_point[ 3 ], float out_point[ 3 ] )
+{
+	float result[ 3 ];
+	for( uint32_t row=0; row < 3; ++row ) {
+		result[ row ] =
+			M( matrix, row, 0 ) * in_point[ 0 ] +
+			M( matrix, row, 1 ) * in_point[ 1 ] +
+			M( matrix, row, 2 ) * in_point[ 2 ] +
+			M( matrix, row, 3 );
+	}
+	std::memcpy( out_point, result, sizeof( result ) );
+}
+
+void ExtractFrustumPlanes( const Matrix4 & view_projection, float out_planes[ 6 ][ 4 ] )
+{
+	// Gribb & Hartmann, adjusted for the [ 0, 1 ] depth range
+	for( uint32_t i=0; i < 4; ++i ) {
+		float r0	= M( view_projection, 0, i );
+		float r1	= M( view_projection, 1, i );
+		float r2	= M( view_projection, 2, i );
+		float r3	= M( view_projection, 3, i );
+		out_planes[ 0 ][ i ]	= r3 + r0;		// left
+		out_planes[ 1 ][ i ]	= r3 - r0;		// right
+		out_planes[ 2 ][ i ]	= r3 + r1;		// top
+		out_planes[ 3 ][ i ]	= r3 - r1;		// bottom
+		out_planes[ 4 ][ i ]	= r2;			// near
+		out_planes[ 5 ][ i ]	= r3 - r2;		// far
+	}
+}
+
+#undef M
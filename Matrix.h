@@ -0,0 +1,28 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Shared.hpp"
+
+// 4x4 float matrix, column major to match GLSL mat4 memory layout
+struct Matrix4
+{
+	float			data[ 16 ];
+};
+
+Matrix4 Matrix4Identity();
+Matrix4 Matrix4Translation( float x, float y, float z );
+Matrix4 Matrix4Scale( float x, float y, float z );
+Matrix4 Matrix4RotationZ( float radians );
+
+// Vulkan clip space conventions, depth range is [ 0, 1 ] and y points down
+Matrix4 Matrix4Perspective( float vertical_fov_radians, float aspect_ratio, float near_plane, float far_plane );
+Matrix4 Matrix4Orthographic( float left, float right, float top, float bottom, float near_plane, float far_plane );
+
+Matrix4 operator*( const Matrix4 & a, const Matrix4 & b );
+
+// Transforms a point, w is assumed to be 1.0
+void TransformPoint( const Matrix4 & matrix, const float in_point[ 3 ], float out_point[ 3 ] );
+
+// Extracts the 6 clip planes of a view projection matrix in "ax + by + cz + d >= 0 is inside" form.
+// Order is left, right, top, bottom, near, far.
+void ExtractFrustumPlanes( const Matrix4 & view_projection, float out_planes[ 6 ][ 4 ] );
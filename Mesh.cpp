@@ -4,6 +4,11 @@
 
 #include "Shared.hpp"
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "AssetArchive.h"
+
+#include <cstring>
+#include <fstream>
 
 
 Mesh::Mesh()
@@ -15,6 +20,57 @@ Mesh::~Mesh()
 {
 }
 
+bool Mesh::Load( const std::string & filepath, const AssetArchive * archive )
+{
+	// archive data is decompressed into a temporary, loose files are mapped and read in place
+	std::vector<uint8_t> archive_data;
+	MappedFile * file		= nullptr;
+	const uint8_t * data	= nullptr;
+	size_t size				= 0;
+	if( archive && archive->Read( filepath, archive_data ) ) {
+		data	= archive_data.data();
+		size	= archive_data.size();
+	} else {
+		file	= new MappedFile( filepath );
+		data	= reinterpret_cast<const uint8_t*>( file->GetData() );
+		size	= file->GetSize();
+	}
+
+	bool success = false;
+	MeshFileHeader header {};
+	if( data && size >= sizeof( header ) ) {
+		std::memcpy( &header, data, sizeof( header ) );
+		uint64_t vertex_bytes	= uint64_t( header.vertex_count ) * sizeof( Mesh_Vertex );
+		uint64_t polygon_bytes	= uint64_t( header.polygon_count ) * sizeof( Mesh_Polygon );
+		if( header.magic == MESH_FILE_MAGIC && header.version == MESH_FILE_VERSION && sizeof( header ) + vertex_bytes + polygon_bytes <= size ) {
+			_vertices.resize( header.vertex_count );
+			_indices.resize( header.polygon_count );
+			std::memcpy( _vertices.data(), data + sizeof( header ), size_t( vertex_bytes ) );
+			std::memcpy( _indices.data(), data + sizeof( header ) + vertex_bytes, size_t( polygon_bytes ) );
+			success = true;
+		}
+	}
+	delete file;
+	return success;
+}
+
+bool Mesh::Save( const std::string & filepath ) const
+{
+	std::ofstream file( filepath, std::ofstream::binary );
+	if( !file.is_open() ) {
+		return false;
+	}
+	MeshFileHeader header {};
+	header.magic			= MESH_FILE_MAGIC;
+	header.version			= MESH_FILE_VERSION;
+	header.vertex_count		= uint32_t( _vertices.size() );
+	header.polygon_count	= uint32_t( _indices.size() );
+	file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	file.write( reinterpret_cast<const char*>( _vertices.data() ), _vertices.size() * sizeof( Mesh_Vertex ) );
+	file.write( reinterpret_cast<const char*>( _indices.data() ), _indices.size() * sizeof( Mesh_Polygon ) );
+	return file.good();
+}
+
 void Mesh::CreateShape_Triangle()
 {
 	_vertices.resize( 3 );
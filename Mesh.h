@@ -7,6 +7,8 @@
 #include <cstdint>
 #include <string>
 
+class AssetArchive;
+
 // vertices, everything a single vertex contains
 struct Mesh_Vertex
 {
@@ -21,6 +23,21 @@ struct Mesh_Polygon
 	uint32_t vertex_ids[ 3 ];
 };
 
+// Mesh file layout, little endian:
+//		MeshFileHeader
+//		Mesh_Vertex[ vertex_count ]
+//		Mesh_Polygon[ polygon_count ]
+constexpr uint32_t MESH_FILE_MAGIC				= 0x48534d42;		// "BMSH"
+constexpr uint32_t MESH_FILE_VERSION			= 1;
+
+struct MeshFileHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			vertex_count;
+	uint32_t			polygon_count;
+};
+
 // A mesh object is a static collection of vertices and indices
 // used by other objects to create a 3D model
 // for static models this data can be accessed directly
@@ -30,7 +47,10 @@ public:
 	Mesh();
 	~Mesh();
 
-	void		Load( std::string filepath );
+	// Loads from the archive if it contains filepath, otherwise from disk. Returns false on failure,
+	// the mesh is left untouched then.
+	bool		Load( const std::string & filepath, const AssetArchive * archive = nullptr );
+	bool		Save( const std::string & filepath ) const;
 
 	void		CreateShape_Triangle();
 
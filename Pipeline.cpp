@@ -5,34 +5,98 @@
 #include "Shared.hpp"
 #include "Pipeline.h"
 #include "Renderer.h"
-#include "Window.h"
 #include "Mesh.h"
+#include "UniformBuffers.h"
+#include "ShaderModuleCache.h"
+#include "PipelineLayoutCache.h"
 
-#include <fstream>
 #include <vector>
+#include <algorithm>
+#include <iostream>
 
 
-Pipeline::Pipeline( Renderer * renderer, Window * window, const std::string & name )
+Pipeline::Pipeline( Renderer * renderer, const PipelineStateKey & key )
+	: _name( key.shader_name ), _key( key )
 {
-	_window			= window;
+	_key.shader_name	= _name.c_str();
+	if( key.specialization ) {
+		_specialization			= *key.specialization;
+		_key.specialization		= &_specialization;
+	}
 	_renderer		= renderer;
 	_gpu			= renderer->GetVulkanPhysicalDevice();
 	_device			= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_PIPELINE );
 	_queue			= renderer->GetVulkanQueue();
-    _name			= name;
-
-	_SubConstructor();
 }
 
 
 Pipeline::~Pipeline()
 {
+	_WaitForWorkers();
 	_SubDestructor();
 }
 
+void Pipeline::BuildAsync()
+{
+	std::lock_guard<std::mutex> lock( _build_mutex );
+	if( _build_started ) return;
+	_build_started		= true;
+	_build_result		= std::async( std::launch::async, [ this ]() {
+		_SubConstructor();
+		_ready			= true;
+#if BUILD_ENABLE_TWO_TIER_PIPELINES
+		std::lock_guard<std::mutex> lock( _build_mutex );
+		_optimize_result	= std::async( std::launch::async, [ this ]() {
+			_pipeline_optimized		= _CreateVulkanPipeline( _program, 0 );
+			// handles are read by the main thread, generation tells users to re-record
+			_pipeline				= _pipeline_optimized;
+			++_generation;
+		} ).share();
+#endif
+	} ).share();
+}
+
+uint32_t Pipeline::GetGeneration() const
+{
+	return _generation;
+}
+
+bool Pipeline::IsReady() const
+{
+	return _ready;
+}
+
+void Pipeline::WaitUntilReady()
+{
+	if( _ready ) return;
+
+	// lazy pipelines start here on first use
+	BuildAsync();
+	std::shared_future<void> result;
+	{
+		std::lock_guard<std::mutex> lock( _build_mutex );
+		result			= _build_result;
+	}
+	result.wait();
+}
+
 VkPipeline Pipeline::GetVulkanPipeline()
 {
-	return _pipeline;
+	WaitUntilReady();
+	return _pipeline.load();
+}
+
+VkPipelineLayout Pipeline::GetVulkanPipelineLayout()
+{
+	WaitUntilReady();
+	return _program.layout;
+}
+
+VkShaderStageFlags Pipeline::GetPushConstantStageFlags()
+{
+	WaitUntilReady();
+	return _program.push_constant_stages;
 }
 
 const std::string & Pipeline::GetName()
@@ -40,109 +104,215 @@ const std::string & Pipeline::GetName()
 	return _name;
 }
 
+const PipelineStateKey & Pipeline::GetStateKey() const
+{
+	return _key;
+}
+
+void Pipeline::Reload()
+{
+	std::lock_guard<std::mutex> lock( _build_mutex );
+	if( !_build_started ) {
+		// first build reads the files anyway
+		return;
+	}
+	// runs after the build, the optimize pass and any earlier reload have finished
+	auto previous_build			= _build_result;
+	auto previous_reload		= _reload_result;
+	_reload_result				= std::async( std::launch::async, [ this, previous_build, previous_reload ]() {
+		// build thread starts the optimize pass before it finishes
+		previous_build.wait();
+		std::shared_future<void> optimize_result;
+		{
+			std::lock_guard<std::mutex> lock( _build_mutex );
+			optimize_result		= _optimize_result;
+		}
+		if( optimize_result.valid() )	optimize_result.wait();
+		if( previous_reload.valid() )	previous_reload.wait();
+
+		Program program;
+		if( !_LoadProgram( program, true ) ) {
+			std::cout << "Reloading pipeline \"" << _name << "\" failed, keeping the current one." << std::endl;
+			return;
+		}
+		// reloads are for iteration, skip the unoptimized tier
+		VkPipeline pipeline = _CreateVulkanPipeline( program, 0 );
+
+		std::lock_guard<std::mutex> lock( _build_mutex );
+		if( _reloaded_pipeline != VK_NULL_HANDLE ) {
+			// superseded before it was ever used
+			vkDestroyPipeline( _device, _reloaded_pipeline, _allocation_callbacks );
+		}
+		_reloaded_program			= std::move( program );
+		_reloaded_pipeline			= pipeline;
+		std::cout << "Reloaded pipeline \"" << _name << "\"" << std::endl;
+	} ).share();
+}
+
+void Pipeline::_ApplyReload()
+{
+	std::lock_guard<std::mutex> lock( _build_mutex );
+	if( _reloaded_pipeline == VK_NULL_HANDLE ) {
+		return;
+	}
+	// command buffers of frames in flight may still use the old variants
+	auto device					= _device;
+	auto allocation_callbacks	= _allocation_callbacks;
+	auto retired_unoptimized	= _pipeline_unoptimized;
+	auto retired_optimized		= _pipeline_optimized;
+	_renderer->DeferDestroy( [ device, allocation_callbacks, retired_unoptimized, retired_optimized ]() {
+		vkDestroyPipeline( device, retired_unoptimized, allocation_callbacks );
+		vkDestroyPipeline( device, retired_optimized, allocation_callbacks );
+	} );
+
+	_program					= std::move( _reloaded_program );
+	_pipeline_unoptimized		= VK_NULL_HANDLE;
+	_pipeline_optimized			= _reloaded_pipeline;
+	_reloaded_pipeline			= VK_NULL_HANDLE;
+	_pipeline					= _pipeline_optimized;
+	++_generation;
+}
+
+void Pipeline::_WaitForWorkers()
+{
+	// build thread starts the optimize thread, so look each one up only after the previous finished
+	auto wait = [ this ]( std::shared_future<void> & future ) {
+		std::shared_future<void> result;
+		{
+			std::lock_guard<std::mutex> lock( _build_mutex );
+			result				= future;
+		}
+		if( result.valid() ) {
+			result.wait();
+		}
+	};
+	wait( _build_result );
+	wait( _optimize_result );
+	wait( _reload_result );
+}
+
 void Pipeline::_SubConstructor()
 {
-    auto filepath = BUILD_PIPELINE_DIRECTORY + _name ;
-	{
-		std::ifstream file( filepath + "/vert.spv", std::ifstream::binary | std::ifstream::ate );
-        if(!file.is_open())
-            abort();
-
-        size_t file_size = file.tellg();
-        std::vector<char> code( file_size );
-
-		file.seekg( 0 );
-		file.read( code.data(), file_size );
-		file.close();
-
-		VkShaderModuleCreateInfo shader_create_info_vertex {};
-		shader_create_info_vertex.sType					= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shader_create_info_vertex.codeSize				= code.size();
-		shader_create_info_vertex.pCode					= reinterpret_cast<uint32_t*>( code.data() );
-		vkCreateShaderModule( _device, &shader_create_info_vertex, nullptr, &_shader_module_vertex );
+	if( !_LoadProgram( _program, false ) ) {
+		abort();
 	}
-	{
-		std::ifstream file( filepath + "/frag.spv", std::ifstream::binary | std::ifstream::ate );
-        if(!file.is_open())
-            abort();
-
-		auto file_size = file.tellg();        
-		std::vector<char> code( file_size );
-
-		file.seekg( 0 );
-		file.read( code.data(), file_size );
-		file.close();
-
-		VkShaderModuleCreateInfo shader_create_info_vertex {};
-		shader_create_info_vertex.sType					= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shader_create_info_vertex.codeSize				= code.size();
-		shader_create_info_vertex.pCode					= reinterpret_cast<uint32_t*>( code.data() );
-		vkCreateShaderModule( _device, &shader_create_info_vertex, nullptr, &_shader_module_fragment );
+
+	_CreateCompatibleRenderPass();
+
+#if BUILD_ENABLE_TWO_TIER_PIPELINES
+	// fast variant first so drawing can start right away, optimized one replaces it when ready
+	_pipeline_unoptimized		= _CreateVulkanPipeline( _program, VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT );
+	_pipeline					= _pipeline_unoptimized;
+#else
+	_pipeline_optimized			= _CreateVulkanPipeline( _program, 0 );
+	_pipeline					= _pipeline_optimized;
+#endif
+}
+
+bool Pipeline::_LoadProgram( Program & program, bool skip_archive )
+{
+	// modules are owned by the cache and shared with other pipelines using the same code
+	auto filepath		= BUILD_PIPELINE_DIRECTORY + _name;
+	auto module_cache	= _renderer->GetShaderModuleCache();
+	program.vertex		= module_cache->GetShaderModule( filepath + "/vert.spv", skip_archive );
+	program.fragment	= module_cache->GetShaderModule( filepath + "/frag.spv", skip_archive );
+	if( program.vertex == VK_NULL_HANDLE || program.fragment == VK_NULL_HANDLE ) {
+		return false;
+	}
+
+	// layouts and vertex input come from the shaders, shared layout objects are owned by the layout cache
+	const ShaderReflection * reflections[] {
+		&module_cache->GetReflection( program.vertex ),
+		&module_cache->GetReflection( program.fragment )
+	};
+	auto layout					= _renderer->GetPipelineLayoutCache()->GetPipelineLayout( reflections, 2 );
+	program.layout				= layout.pipeline_layout;
+	program.push_constant_stages	= layout.push_constant_stages;
+	// every draw binds the camera set and pushes PC_Object, shaders have to declare both
+	if( layout.set_layouts.size() != 1 || layout.set_layouts[ 0 ] != _renderer->GetCameraDescriptorSetLayout() ) {
+		std::cout << "Pipeline \"" << _name << "\" has to declare the camera uniform block as its only descriptor set." << std::endl;
+		return false;
+	}
+	if( layout.push_constant_size != sizeof( PC_Object ) ) {
+		std::cout << "Pipeline \"" << _name << "\" has to declare PC_Object as its push constant block." << std::endl;
+		return false;
+	}
+
+	// attributes are tightly packed in location order into Mesh_Vertex
+	uint32_t offset = 0;
+	program.vertex_attributes.clear();
+	for( auto &input : reflections[ 0 ]->vertex_inputs ) {
+		VkVertexInputAttributeDescription attribute {};
+		attribute.binding		= 0;
+		attribute.location		= input.location;
+		attribute.format		= input.format;
+		attribute.offset		= offset;
+		offset					+= input.size;
+		program.vertex_attributes.push_back( attribute );
 	}
+	assert( offset <= sizeof( Mesh_Vertex ) && "Vertex shader reads more than Mesh_Vertex holds." );
 
+	// catch typos in constant ids, Vulkan silently ignores unknown ones
+	for( auto &c : _specialization.GetConstants() ) {
+		auto &v = reflections[ 0 ]->specialization_constant_ids;
+		auto &f = reflections[ 1 ]->specialization_constant_ids;
+		assert( ( std::find( v.begin(), v.end(), c.id ) != v.end() || std::find( f.begin(), f.end(), c.id ) != f.end() ) && "Specialization constant id not declared by any stage." );
+	}
+	return true;
+}
+
+VkPipeline Pipeline::_CreateVulkanPipeline( const Program & program, VkPipelineCreateFlags flags )
+{
 	VkPipelineShaderStageCreateInfo shader_stage_create_infos[ 2 ] { {}, {} };
 	shader_stage_create_infos[ 0 ].sType				= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shader_stage_create_infos[ 0 ].stage				= VK_SHADER_STAGE_VERTEX_BIT;
-	shader_stage_create_infos[ 0 ].module				= _shader_module_vertex;
+	shader_stage_create_infos[ 0 ].module				= program.vertex;
 	shader_stage_create_infos[ 0 ].pName				= "main";
 
 	shader_stage_create_infos[ 1 ].sType				= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shader_stage_create_infos[ 1 ].stage				= VK_SHADER_STAGE_FRAGMENT_BIT;
-	shader_stage_create_infos[ 1 ].module				= _shader_module_fragment;
+	shader_stage_create_infos[ 1 ].module				= program.fragment;
 	shader_stage_create_infos[ 1 ].pName				= "main";
 
+	std::vector<VkSpecializationMapEntry> specialization_entries;
+	VkSpecializationInfo specialization_info {};
+	if( _key.specialization ) {
+		_key.specialization->GetVulkanSpecializationInfo( specialization_entries, specialization_info );
+		shader_stage_create_infos[ 0 ].pSpecializationInfo	= &specialization_info;
+		shader_stage_create_infos[ 1 ].pSpecializationInfo	= &specialization_info;
+	}
+
 	VkVertexInputBindingDescription vertex_binding_description {};
 	vertex_binding_description.binding					= 0;
 	vertex_binding_description.stride					= sizeof( Mesh_Vertex );
 	vertex_binding_description.inputRate				= VK_VERTEX_INPUT_RATE_VERTEX;
 
-	VkVertexInputAttributeDescription vertex_attribute_description[] { {}, {} };
-	vertex_attribute_description[ 0 ].binding			= 0;
-	vertex_attribute_description[ 0 ].location			= 0;
-	vertex_attribute_description[ 0 ].offset			= 0;
-	vertex_attribute_description[ 0 ].format			= VK_FORMAT_R32G32B32_SFLOAT;
-	/*
-	vertex_attribute_description[ 1 ].binding			= 0;
-	vertex_attribute_description[ 1 ].location			= 1;
-	vertex_attribute_description[ 1 ].offset			= 12;
-	vertex_attribute_description[ 1 ].format			= VK_FORMAT_R32G32B32_SFLOAT;
-	*/
 	VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info {};
 	vertex_input_state_create_info.sType								= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_state_create_info.vertexAttributeDescriptionCount		= 1;
-	vertex_input_state_create_info.pVertexAttributeDescriptions			= vertex_attribute_description;
+	vertex_input_state_create_info.vertexAttributeDescriptionCount		= uint32_t( program.vertex_attributes.size() );
+	vertex_input_state_create_info.pVertexAttributeDescriptions			= program.vertex_attributes.data();
 	vertex_input_state_create_info.vertexBindingDescriptionCount		= 1;
 	vertex_input_state_create_info.pVertexBindingDescriptions			= &vertex_binding_description;
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info {};
 	input_assembly_create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	input_assembly_create_info.topology					= VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-	VkViewport viewport {
-		0.0f, 0.0f,
-		float( _window->GetSize().width ), float( _window->GetSize().height ),
-		0.0f, 1.0f
-	};
-
-	VkRect2D scissor {
-		{ 0, 0 },
-		{ _window->GetSize().width, _window->GetSize().height }
-	};
+	input_assembly_create_info.topology					= _key.topology;
 
+	// viewport and scissor are dynamic, see Window::CmdSetViewport()
 	VkPipelineViewportStateCreateInfo viewport_state_create_info {};
 	viewport_state_create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewport_state_create_info.viewportCount			= 1;
-	viewport_state_create_info.pViewports				= &viewport;
+	viewport_state_create_info.pViewports				= nullptr;
 	viewport_state_create_info.scissorCount				= 1;
-	viewport_state_create_info.pScissors				= &scissor;
+	viewport_state_create_info.pScissors				= nullptr;
 
 	VkPipelineRasterizationStateCreateInfo rasterization_create_info {};
 	rasterization_create_info.sType						= VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterization_create_info.depthClampEnable			= VK_FALSE;
 	rasterization_create_info.rasterizerDiscardEnable	= VK_FALSE;
-	rasterization_create_info.polygonMode				= VK_POLYGON_MODE_FILL;
-	rasterization_create_info.cullMode					= VK_CULL_MODE_NONE;
-	rasterization_create_info.frontFace					= VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterization_create_info.polygonMode				= _key.polygon_mode;
+	rasterization_create_info.cullMode					= _key.cull_mode;
+	rasterization_create_info.frontFace					= _key.front_face;
 	rasterization_create_info.depthBiasEnable			= VK_FALSE;
 	rasterization_create_info.depthBiasConstantFactor	= 0;
 	rasterization_create_info.depthBiasClamp			= 0;
@@ -160,9 +330,9 @@ void Pipeline::_SubConstructor()
 
 	VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info {};
 	depth_stencil_state_create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depth_stencil_state_create_info.depthTestEnable			= VK_TRUE;
-	depth_stencil_state_create_info.depthWriteEnable		= VK_TRUE;
-	depth_stencil_state_create_info.depthCompareOp			= VK_COMPARE_OP_LESS;
+	depth_stencil_state_create_info.depthTestEnable			= _key.depth_test;
+	depth_stencil_state_create_info.depthWriteEnable		= _key.depth_write;
+	depth_stencil_state_create_info.depthCompareOp			= _key.depth_compare;
 	depth_stencil_state_create_info.depthBoundsTestEnable	= VK_FALSE;
 	depth_stencil_state_create_info.stencilTestEnable		= VK_FALSE;
 	depth_stencil_state_create_info.minDepthBounds			= 0;
@@ -177,7 +347,7 @@ void Pipeline::_SubConstructor()
 	depth_stencil_state_create_info.back					= depth_stencil_state_create_info.front;
 
 	VkPipelineColorBlendAttachmentState color_blend_attachment_state {};
-	color_blend_attachment_state.blendEnable			= VK_FALSE;
+	color_blend_attachment_state.blendEnable			= _key.blend;
 	color_blend_attachment_state.srcColorBlendFactor	= VK_BLEND_FACTOR_SRC_ALPHA;
 	color_blend_attachment_state.dstColorBlendFactor	= VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 	color_blend_attachment_state.colorBlendOp			= VK_BLEND_OP_ADD;
@@ -201,30 +371,15 @@ void Pipeline::_SubConstructor()
 	color_blend_state_create_info.blendConstants[ 2 ]	= 1.0f;
 	color_blend_state_create_info.blendConstants[ 3 ]	= 1.0f;
 
-	std::vector<VkDynamicState> dynamic_states {};
+	std::vector<VkDynamicState> dynamic_states { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 	VkPipelineDynamicStateCreateInfo dynamic_state_create_info {};
 	dynamic_state_create_info.sType						= VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 	dynamic_state_create_info.dynamicStateCount			= dynamic_states.size();
 	dynamic_state_create_info.pDynamicStates			= dynamic_states.data();
 
-	std::vector<VkPushConstantRange> range( 1 );
-	range[ 0 ].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
-	range[ 0 ].offset			= 0;
-	range[ 0 ].size				= sizeof( float );
-
-	range.clear();
-
-	VkPipelineLayoutCreateInfo pipeline_layout_create_info {};
-	pipeline_layout_create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_create_info.setLayoutCount			= 0;
-	pipeline_layout_create_info.pSetLayouts				= nullptr;
-	pipeline_layout_create_info.pushConstantRangeCount	= range.size();
-	pipeline_layout_create_info.pPushConstantRanges		= range.data();
-	vkCreatePipelineLayout( _device, &pipeline_layout_create_info, nullptr, &_pipeline_layout );
-
 	VkGraphicsPipelineCreateInfo pipeline_create_info {};
 	pipeline_create_info.sType							= VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_create_info.flags							= VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+	pipeline_create_info.flags							= flags;
 	pipeline_create_info.stageCount						= 2;
 	pipeline_create_info.pStages						= shader_stage_create_infos;
 	pipeline_create_info.pVertexInputState				= &vertex_input_state_create_info;
@@ -238,17 +393,67 @@ void Pipeline::_SubConstructor()
 	if( dynamic_states.size() ) {
 		pipeline_create_info.pDynamicState				= &dynamic_state_create_info;
 	}
-	pipeline_create_info.layout							= _pipeline_layout;
-	pipeline_create_info.renderPass						= _window->GetRenderPass();
+	pipeline_create_info.layout							= program.layout;
+	pipeline_create_info.renderPass						= _compatible_render_pass;
 	pipeline_create_info.subpass						= 0;
 	pipeline_create_info.basePipelineIndex				= -1;
-	vkCreateGraphicsPipelines( _device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &_pipeline );
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	ErrCheck( vkCreateGraphicsPipelines( _device, _renderer->GetVulkanPipelineCache(), 1, &pipeline_create_info, _allocation_callbacks, &pipeline ) );
+	return pipeline;
 }
 
 void Pipeline::_SubDestructor()
 {
-	vkDestroyPipeline( _device, _pipeline, nullptr );
-	vkDestroyPipelineLayout( _device, _pipeline_layout, nullptr );
-	vkDestroyShaderModule( _device, _shader_module_vertex, nullptr );
-	vkDestroyShaderModule( _device, _shader_module_fragment, nullptr );
+	// unoptimized variant is kept alive until here, command buffers recorded before the swap may still use it
+	vkDestroyPipeline( _device, _pipeline_unoptimized, _allocation_callbacks );
+	vkDestroyPipeline( _device, _pipeline_optimized, _allocation_callbacks );
+	vkDestroyPipeline( _device, _reloaded_pipeline, _allocation_callbacks );
+	_pipeline					= VK_NULL_HANDLE;
+	vkDestroyRenderPass( _device, _compatible_render_pass, _allocation_callbacks );
+}
+
+void Pipeline::_CreateCompatibleRenderPass()
+{
+	// Pipelines only need a compatible render pass: same attachment formats, sample counts and subpasses
+	// as Window::_CreateRenderPass(). Keeping our own means window render passes can come and go.
+	VkAttachmentDescription attachments[ 2 ] { {}, {} };
+	attachments[ 0 ].format						= _key.depth_format;
+	attachments[ 0 ].samples					= VK_SAMPLE_COUNT_1_BIT;
+	attachments[ 0 ].loadOp						= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[ 0 ].storeOp					= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[ 0 ].stencilLoadOp				= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[ 0 ].stencilStoreOp				= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[ 0 ].initialLayout				= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachments[ 0 ].finalLayout				= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	attachments[ 1 ].format						= _key.color_format;
+	attachments[ 1 ].samples					= VK_SAMPLE_COUNT_1_BIT;
+	attachments[ 1 ].loadOp						= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[ 1 ].storeOp					= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[ 1 ].stencilLoadOp				= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[ 1 ].stencilStoreOp				= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[ 1 ].initialLayout				= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[ 1 ].finalLayout				= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depth_attachment_ref {};
+	depth_attachment_ref.attachment				= 0;
+	depth_attachment_ref.layout					= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_attachment_ref {};
+	color_attachment_ref.attachment				= 1;
+	color_attachment_ref.layout					= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass_description {};
+	subpass_description.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass_description.colorAttachmentCount	= 1;
+	subpass_description.pColorAttachments		= &color_attachment_ref;
+	subpass_description.pDepthStencilAttachment	= &depth_attachment_ref;
+
+	VkRenderPassCreateInfo render_pass_create_info {};
+	render_pass_create_info.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount		= 2;
+	render_pass_create_info.pAttachments		= attachments;
+	render_pass_create_info.subpassCount		= 1;
+	render_pass_create_info.pSubpasses			= &subpass_description;
+	ErrCheck( vkCreateRenderPass( _device, &render_pass_create_info, _allocation_callbacks, &_compatible_render_pass ) );
 }
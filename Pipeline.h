@@ -3,37 +3,102 @@
 #include "BUILD_OPTIONS.h"
 #include "Platform.h"
 
+#include "PipelineStateKey.h"
+
 #include <string>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
-class Window;
 class Renderer;
 
 // Pipeline handles vulkan pipelines, it's a relatively big object so it got it's own class
-// This class automatically creates a vulkan pipeline from given shader sources and window
+// This class automatically creates a vulkan pipeline from given shader sources and state key.
+// Pipelines are owned by the Renderer pipeline library and shared by all windows whose render
+// passes are compatible with the key. Creation happens on a worker thread, either right away
+// with BuildAsync() or on first use. Getters block until the pipeline is ready.
 class Pipeline
 {
+	friend class Renderer;
+
 public:
-	Pipeline( Renderer * renderer, Window * window, const std::string & name );
+	Pipeline( Renderer * renderer, const PipelineStateKey & key );
 	~Pipeline();
 
+	// Starts compiling on a worker thread, does nothing if already started.
+	void							BuildAsync();
+	// True when the pipeline can be used without blocking.
+	bool							IsReady() const;
+	void							WaitUntilReady();
+
+	// Returns the optimized pipeline once it's available, the unoptimized one before that.
 	VkPipeline						GetVulkanPipeline();
+	// Increases when GetVulkanPipeline() changes, command buffers recorded with an older generation should be re-recorded.
+	uint32_t						GetGeneration() const;
+	// Reflected from the shaders and shared with identical pipelines. Set 0 is the camera set and
+	// push constants hold PC_Object, shaders declaring anything else fail to load.
+	VkPipelineLayout				GetVulkanPipelineLayout();
+	// Stages to pass to vkCmdPushConstants.
+	VkShaderStageFlags				GetPushConstantStageFlags();
 
 	const std::string			&	GetName();
+	// Shader name and specialization of the returned key point to this pipeline's own copies.
+	const PipelineStateKey		&	GetStateKey() const;
+
+	// Rebuilds from the shader files on disk on a worker thread. The result is swapped in by the
+	// renderer between frames, see GetGeneration(). Broken shaders keep the current pipeline.
+	void							Reload();
 
 private:
+	// Everything derived from the shaders, replaced as a whole by a reload.
+	struct Program
+	{
+		VkShaderModule									vertex					= VK_NULL_HANDLE;		// owned by the module cache
+		VkShaderModule									fragment				= VK_NULL_HANDLE;		// owned by the module cache
+		VkPipelineLayout								layout					= VK_NULL_HANDLE;		// owned by the layout cache
+		VkShaderStageFlags								push_constant_stages	= 0;
+		std::vector<VkVertexInputAttributeDescription>	vertex_attributes;
+	};
+
 	void _SubConstructor();
 	void _SubDestructor();
 
+	void _CreateCompatibleRenderPass();
+
+	// Returns false if the shaders are missing or invalid.
+	bool _LoadProgram( Program & program, bool skip_archive );
+	VkPipeline _CreateVulkanPipeline( const Program & program, VkPipelineCreateFlags flags );
+
+	// Called by the renderer between frames, on the thread that records command buffers.
+	void _ApplyReload();
+
+	void _WaitForWorkers();
+
 	std::string						_name;
+	PipelineStateKey				_key;
+	PipelineSpecialization			_specialization;
 
 	Renderer					*	_renderer					= nullptr;
-	Window						*	_window						= nullptr;
 	VkPhysicalDevice				_gpu						= VK_NULL_HANDLE;
 	VkDevice						_device						= VK_NULL_HANDLE;
+	const VkAllocationCallbacks	*	_allocation_callbacks		= nullptr;
 	VkQueue							_queue						= VK_NULL_HANDLE;
-	VkPipeline						_pipeline					= VK_NULL_HANDLE;
-	VkPipelineLayout				_pipeline_layout			= VK_NULL_HANDLE;
-	VkShaderModule					_shader_module_vertex		= VK_NULL_HANDLE;
-	VkShaderModule					_shader_module_fragment		= VK_NULL_HANDLE;
+	std::atomic<VkPipeline>			_pipeline					{ VK_NULL_HANDLE };		// currently active variant
+	VkPipeline						_pipeline_unoptimized		= VK_NULL_HANDLE;
+	VkPipeline						_pipeline_optimized			= VK_NULL_HANDLE;
+	std::atomic<uint32_t>			_generation					{ 0 };
+	Program							_program;
+	VkRenderPass					_compatible_render_pass		= VK_NULL_HANDLE;		// only used for creation
+
+	std::mutex						_build_mutex;
+	std::shared_future<void>		_build_result;
+	std::shared_future<void>		_optimize_result;
+	bool							_build_started				= false;
+	std::atomic<bool>				_ready						{ false };
+
+	std::shared_future<void>		_reload_result;
+	Program							_reloaded_program;
+	VkPipeline						_reloaded_pipeline			= VK_NULL_HANDLE;		// waiting for _ApplyReload()
 };
 
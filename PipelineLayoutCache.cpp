@@ -0,0 +1,133 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "PipelineLayoutCache.h"
+#include "ShaderReflection.h"
+#include "Renderer.h"
+#include "Shared.hpp"
+
+#include <algorithm>
+
+PipelineLayoutCache::PipelineLayoutCache( Renderer * renderer )
+{
+	_renderer				= renderer;
+	_device					= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_PIPELINE );
+}
+
+PipelineLayoutCache::~PipelineLayoutCache()
+{
+	for( auto &l : _pipeline_layouts ) {
+		vkDestroyPipelineLayout( _device, l.second, _allocation_callbacks );
+	}
+	for( auto &l : _descriptor_set_layouts ) {
+		vkDestroyDescriptorSetLayout( _device, l.second, _allocation_callbacks );
+	}
+	_pipeline_layouts.clear();
+	_descriptor_set_layouts.clear();
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::GetDescriptorSetLayout( const std::vector<VkDescriptorSetLayoutBinding> & bindings )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _GetDescriptorSetLayout( bindings );
+}
+
+ReflectedPipelineLayout PipelineLayoutCache::GetPipelineLayout( const ShaderReflection * const * stages, uint32_t stage_count )
+{
+	ReflectedPipelineLayout result;
+
+	// merge bindings of all stages, the same binding used by several stages gets all their stage flags
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	for( uint32_t s=0; s < stage_count; ++s ) {
+		for( auto &b : stages[ s ]->bindings ) {
+			if( b.set >= sets.size() ) {
+				sets.resize( b.set + 1 );
+			}
+			auto &set	= sets[ b.set ];
+			auto it		= std::find_if( set.begin(), set.end(), [ &b ]( const VkDescriptorSetLayoutBinding & x ) { return x.binding == b.binding.binding; } );
+			if( it == set.end() ) {
+				set.push_back( b.binding );
+			} else {
+				assert( it->descriptorType == b.binding.descriptorType && it->descriptorCount == b.binding.descriptorCount && "Stages disagree on a descriptor binding." );
+				it->stageFlags |= b.binding.stageFlags;
+			}
+		}
+		if( stages[ s ]->push_constant_size ) {
+			result.push_constant_stages		|= stages[ s ]->stage;
+			result.push_constant_size		= std::max( result.push_constant_size, stages[ s ]->push_constant_size );
+		}
+	}
+	for( auto &set : sets ) {
+		std::sort( set.begin(), set.end(), []( const VkDescriptorSetLayoutBinding & a, const VkDescriptorSetLayoutBinding & b ) { return a.binding < b.binding; } );
+	}
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	// unused set numbers below the highest one get an empty layout
+	std::vector<uint64_t> key;
+	for( auto &set : sets ) {
+		result.set_layouts.push_back( _GetDescriptorSetLayout( set ) );
+		key.push_back( uint64_t( result.set_layouts.back() ) );
+	}
+	key.push_back( result.push_constant_stages );
+	key.push_back( result.push_constant_size );
+
+	auto it = _pipeline_layouts.find( key );
+	if( it != _pipeline_layouts.end() ) {
+		result.pipeline_layout = it->second;
+		return result;
+	}
+
+	// one range covering every stage that uses push constants
+	VkPushConstantRange range {};
+	range.stageFlags		= result.push_constant_stages;
+	range.offset			= 0;
+	range.size				= result.push_constant_size;
+
+	VkPipelineLayoutCreateInfo pipeline_layout_create_info {};
+	pipeline_layout_create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_create_info.setLayoutCount			= uint32_t( result.set_layouts.size() );
+	pipeline_layout_create_info.pSetLayouts				= result.set_layouts.data();
+	pipeline_layout_create_info.pushConstantRangeCount	= result.push_constant_size ? 1 : 0;
+	pipeline_layout_create_info.pPushConstantRanges		= &range;
+	ErrCheck( vkCreatePipelineLayout( _device, &pipeline_layout_create_info, _allocation_callbacks, &result.pipeline_layout ) );
+	_pipeline_layouts[ key ] = result.pipeline_layout;
+	return result;
+}
+
+uint32_t PipelineLayoutCache::GetDescriptorSetLayoutCount()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return uint32_t( _descriptor_set_layouts.size() );
+}
+
+uint32_t PipelineLayoutCache::GetPipelineLayoutCount()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return uint32_t( _pipeline_layouts.size() );
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::_GetDescriptorSetLayout( const std::vector<VkDescriptorSetLayoutBinding> & bindings )
+{
+	// immutable samplers are not part of the key, they're not supported here
+	std::vector<uint64_t> key;
+	key.reserve( bindings.size() * 2 );
+	for( auto &b : bindings ) {
+		assert( b.pImmutableSamplers == nullptr );
+		key.push_back( ( uint64_t( b.binding ) << 32 ) | b.descriptorType );
+		key.push_back( ( uint64_t( b.descriptorCount ) << 32 ) | b.stageFlags );
+	}
+	auto it = _descriptor_set_layouts.find( key );
+	if( it != _descriptor_set_layouts.end() ) {
+		return it->second;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info {};
+	descriptor_set_layout_create_info.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptor_set_layout_create_info.bindingCount		= uint32_t( bindings.size() );
+	descriptor_set_layout_create_info.pBindings			= bindings.data();
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	ErrCheck( vkCreateDescriptorSetLayout( _device, &descriptor_set_layout_create_info, _allocation_callbacks, &layout ) );
+	_descriptor_set_layouts[ key ] = layout;
+	return layout;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+class Renderer;
+struct ShaderReflection;
+
+// Pipeline layout merged from the reflection of every stage in a pipeline.
+struct ReflectedPipelineLayout
+{
+	VkPipelineLayout						pipeline_layout				= VK_NULL_HANDLE;
+	std::vector<VkDescriptorSetLayout>		set_layouts;							// indexed by set number
+	VkShaderStageFlags						push_constant_stages		= 0;		// pass to vkCmdPushConstants
+	uint32_t								push_constant_size			= 0;
+};
+
+// Descriptor set layouts and pipeline layouts are deduplicated by their definition, pipelines whose
+// shaders reflect identically share the same Vulkan objects. Everything is owned by the cache and
+// lives until the renderer is destroyed. Safe to use from pipeline build threads.
+class PipelineLayoutCache
+{
+public:
+	PipelineLayoutCache( Renderer * renderer );
+	~PipelineLayoutCache();
+
+	VkDescriptorSetLayout					GetDescriptorSetLayout( const std::vector<VkDescriptorSetLayoutBinding> & bindings );
+	ReflectedPipelineLayout					GetPipelineLayout( const ShaderReflection * const * stages, uint32_t stage_count );
+
+	uint32_t								GetDescriptorSetLayoutCount();
+	uint32_t								GetPipelineLayoutCount();
+
+private:
+	VkDescriptorSetLayout					_GetDescriptorSetLayout( const std::vector<VkDescriptorSetLayoutBinding> & bindings );
+
+	Renderer							*	_renderer						= nullptr;
+	VkDevice								_device							= VK_NULL_HANDLE;
+	const VkAllocationCallbacks			*	_allocation_callbacks			= nullptr;
+
+	std::mutex								_mutex;
+	std::map<std::vector<uint64_t>, VkDescriptorSetLayout>		_descriptor_set_layouts;
+	std::map<std::vector<uint64_t>, VkPipelineLayout>			_pipeline_layouts;
+};
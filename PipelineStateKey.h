@@ -0,0 +1,234 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// FNV-1a, usable in constant expressions
+constexpr uint64_t PIPELINE_STATE_KEY_FNV_OFFSET		= 14695981039346656037ULL;
+constexpr uint64_t PIPELINE_STATE_KEY_FNV_PRIME			= 1099511628211ULL;
+
+constexpr uint64_t PipelineStateKeyHashString( const char * string, uint64_t hash = PIPELINE_STATE_KEY_FNV_OFFSET )
+{
+	return *string ? PipelineStateKeyHashString( string + 1, ( hash ^ uint8_t( *string ) ) * PIPELINE_STATE_KEY_FNV_PRIME ) : hash;
+}
+
+constexpr uint64_t PipelineStateKeyHashValue( uint64_t hash, uint64_t value )
+{
+	return ( hash ^ value ) * PIPELINE_STATE_KEY_FNV_PRIME;
+}
+
+struct PipelineSpecializationConstant
+{
+	uint32_t					id;						// layout( constant_id = id ) in GLSL
+	uint32_t					value;					// 32 bit pattern, bools are VkBool32
+};
+
+// Specialization constant values for a pipeline variant, eg. feature toggles, loop counts or
+// workgroup sizes. The driver folds them into the shader when the pipeline is compiled, so one
+// SPIR-V file can serve many variants without runtime branching. Constants are applied to every
+// stage, ids a stage doesn't declare are ignored by Vulkan.
+class PipelineSpecialization
+{
+public:
+	PipelineSpecialization & Set( uint32_t id, uint32_t value )
+	{
+		auto it = std::lower_bound( _constants.begin(), _constants.end(), id, []( const PipelineSpecializationConstant & c, uint32_t i ) { return c.id < i; } );
+		if( it != _constants.end() && it->id == id ) {
+			it->value = value;
+		} else {
+			_constants.insert( it, PipelineSpecializationConstant { id, value } );
+		}
+		return *this;
+	}
+	PipelineSpecialization & Set( uint32_t id, int32_t value )
+	{
+		return Set( id, uint32_t( value ) );
+	}
+	PipelineSpecialization & Set( uint32_t id, float value )
+	{
+		uint32_t bits;
+		std::memcpy( &bits, &value, sizeof( bits ) );
+		return Set( id, bits );
+	}
+	PipelineSpecialization & Set( uint32_t id, bool value )
+	{
+		return Set( id, uint32_t( value ? VK_TRUE : VK_FALSE ) );
+	}
+
+	// Sorted by id.
+	const std::vector<PipelineSpecializationConstant> & GetConstants() const
+	{
+		return _constants;
+	}
+	bool IsEmpty() const
+	{
+		return _constants.empty();
+	}
+
+	// Map entries point straight at the stored values, info is valid while this object is unchanged.
+	void GetVulkanSpecializationInfo( std::vector<VkSpecializationMapEntry> & entries, VkSpecializationInfo & info ) const
+	{
+		entries.resize( _constants.size() );
+		for( size_t i=0; i < _constants.size(); ++i ) {
+			entries[ i ].constantID		= _constants[ i ].id;
+			entries[ i ].offset			= uint32_t( i * sizeof( PipelineSpecializationConstant ) + offsetof( PipelineSpecializationConstant, value ) );
+			entries[ i ].size			= sizeof( uint32_t );
+		}
+		info.mapEntryCount		= uint32_t( entries.size() );
+		info.pMapEntries		= entries.data();
+		info.dataSize			= _constants.size() * sizeof( PipelineSpecializationConstant );
+		info.pData				= _constants.data();
+	}
+
+	uint64_t Hash() const
+	{
+		uint64_t hash = PIPELINE_STATE_KEY_FNV_OFFSET;
+		for( auto &c : _constants ) {
+			hash = PipelineStateKeyHashValue( PipelineStateKeyHashValue( hash, c.id ), c.value );
+		}
+		return hash;
+	}
+
+	bool operator==( const PipelineSpecialization & other ) const
+	{
+		return _constants.size() == other._constants.size() && std::equal( _constants.begin(), _constants.end(), other._constants.begin(),
+			[]( const PipelineSpecializationConstant & a, const PipelineSpecializationConstant & b ) { return a.id == b.id && a.value == b.value; } );
+	}
+
+private:
+	std::vector<PipelineSpecializationConstant>		_constants;
+};
+
+// Full description of a graphics pipeline: shaders, fixed function state and the attachment formats
+// that decide render pass compatibility. Viewport and scissor are dynamic so window size is not part
+// of the key. Keys can be built at compile time:
+//
+//	constexpr auto key = PipelineStateKey( "default" ).WithCullMode( VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE );
+//
+// Shader name and specialization must outlive the key, pipelines keep their own copies.
+struct PipelineStateKey
+{
+	constexpr PipelineStateKey( const char * shader_name )
+		: PipelineStateKey( shader_name, PipelineStateKeyHashString( shader_name ),
+			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE,
+			VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, VK_FALSE,
+			VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED, nullptr, 0 )
+	{}
+
+	constexpr PipelineStateKey WithTopology( VkPrimitiveTopology value ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, value, polygon_mode, cull_mode, front_face, depth_test, depth_write, depth_compare, blend, color_format, depth_format, specialization, specialization_hash );
+	}
+	constexpr PipelineStateKey WithPolygonMode( VkPolygonMode value ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, value, cull_mode, front_face, depth_test, depth_write, depth_compare, blend, color_format, depth_format, specialization, specialization_hash );
+	}
+	constexpr PipelineStateKey WithCullMode( VkCullModeFlags cull, VkFrontFace front ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, polygon_mode, cull, front, depth_test, depth_write, depth_compare, blend, color_format, depth_format, specialization, specialization_hash );
+	}
+	constexpr PipelineStateKey WithDepth( VkBool32 test, VkBool32 write, VkCompareOp compare ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, polygon_mode, cull_mode, front_face, test, write, compare, blend, color_format, depth_format, specialization, specialization_hash );
+	}
+	constexpr PipelineStateKey WithBlend( VkBool32 value ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, polygon_mode, cull_mode, front_face, depth_test, depth_write, depth_compare, value, color_format, depth_format, specialization, specialization_hash );
+	}
+	constexpr PipelineStateKey WithRenderPassFormats( VkFormat color, VkFormat depth ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, polygon_mode, cull_mode, front_face, depth_test, depth_write, depth_compare, blend, color, depth, specialization, specialization_hash );
+	}
+
+	// Not constexpr, specialization values are only known at run time.
+	PipelineStateKey WithSpecialization( const PipelineSpecialization & value ) const
+	{
+		return PipelineStateKey( shader_name, shader_name_hash, topology, polygon_mode, cull_mode, front_face, depth_test, depth_write, depth_compare, blend, color_format, depth_format,
+			value.IsEmpty() ? nullptr : &value, value.IsEmpty() ? 0 : value.Hash() );
+	}
+
+	constexpr uint64_t Hash() const
+	{
+		return
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue(
+			PipelineStateKeyHashValue( shader_name_hash,
+				uint64_t( topology ) ),
+				uint64_t( polygon_mode ) ),
+				uint64_t( cull_mode ) ),
+				uint64_t( front_face ) ),
+				uint64_t( depth_test ) ),
+				uint64_t( depth_write ) ),
+				uint64_t( depth_compare ) ),
+				uint64_t( blend ) ),
+				uint64_t( color_format ) ),
+				uint64_t( depth_format ) ),
+				specialization_hash ),
+				0 );
+	}
+
+	bool operator==( const PipelineStateKey & other ) const
+	{
+		return
+			shader_name_hash	== other.shader_name_hash &&
+			topology			== other.topology &&
+			polygon_mode		== other.polygon_mode &&
+			cull_mode			== other.cull_mode &&
+			front_face			== other.front_face &&
+			depth_test			== other.depth_test &&
+			depth_write			== other.depth_write &&
+			depth_compare		== other.depth_compare &&
+			blend				== other.blend &&
+			color_format		== other.color_format &&
+			depth_format		== other.depth_format &&
+			specialization_hash	== other.specialization_hash &&
+			( specialization == other.specialization || ( specialization && other.specialization && *specialization == *other.specialization ) ) &&
+			0 == std::strcmp( shader_name, other.shader_name );
+	}
+	bool operator!=( const PipelineStateKey & other ) const
+	{
+		return !( *this == other );
+	}
+
+	const char				*	shader_name;			// directory under BUILD_PIPELINE_DIRECTORY
+	uint64_t					shader_name_hash;
+	VkPrimitiveTopology			topology;
+	VkPolygonMode				polygon_mode;
+	VkCullModeFlags				cull_mode;
+	VkFrontFace					front_face;
+	VkBool32					depth_test;
+	VkBool32					depth_write;
+	VkCompareOp					depth_compare;
+	VkBool32					blend;
+	VkFormat					color_format;			// render pass compatibility
+	VkFormat					depth_format;			// render pass compatibility
+	const PipelineSpecialization	*	specialization;		// nullptr if there are no constants
+	uint64_t					specialization_hash;
+
+private:
+	constexpr PipelineStateKey( const char * shader_name, uint64_t shader_name_hash,
+		VkPrimitiveTopology topology, VkPolygonMode polygon_mode, VkCullModeFlags cull_mode, VkFrontFace front_face,
+		VkBool32 depth_test, VkBool32 depth_write, VkCompareOp depth_compare, VkBool32 blend,
+		VkFormat color_format, VkFormat depth_format,
+		const PipelineSpecialization * specialization, uint64_t specialization_hash )
+		: shader_name( shader_name ), shader_name_hash( shader_name_hash ),
+		topology( topology ), polygon_mode( polygon_mode ), cull_mode( cull_mode ), front_face( front_face ),
+		depth_test( depth_test ), depth_write( depth_write ), depth_compare( depth_compare ), blend( blend ),
+		color_format( color_format ), depth_format( depth_format ),
+		specialization( specialization ), specialization_hash( specialization_hash )
+	{}
+};
@@ -14,7 +14,8 @@
 #define VK_USE_PLATFORM_WIN32_KHR 1
 #define PLATFORM_DEPENDENT_EXTENSION_NAME VK_KHR_WIN32_SURFACE_EXTENSION_NAME
 
-#ifndef _DEBUG
+// command line tools define PLATFORM_CONSOLE_APPLICATION to keep their console, see tools/AssetPacker.vcxproj
+#if !defined( _DEBUG ) && !defined( PLATFORM_CONSOLE_APPLICATION )
 #pragma comment( linker, "/SUBSYSTEM:WINDOWS /ENTRY:mainCRTStartup" )
 #endif
 
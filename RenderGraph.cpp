@@ -0,0 +1,977 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "Shared.hpp"
+#include "RenderGraph.h"
+#include "Renderer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace {
+
+struct AccessInfo
+{
+	VkPipelineStageFlags			stage;
+	VkAccessFlags					access;
+	VkImageLayout					layout;			// images only
+	VkImageUsageFlags				image_usage;
+	VkBufferUsageFlags				buffer_usage;
+};
+
+// indexed by RENDER_GRAPH_ACCESS
+const AccessInfo access_table[ RENDER_GRAPH_ACCESS_COUNT ] {
+	{	VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,				0,
+		VK_IMAGE_LAYOUT_UNDEFINED,						0,												0 },
+	{	VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,				0,											// stages come from the first use
+		VK_IMAGE_LAYOUT_UNDEFINED,						0,												0 },
+	{	VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,			0,
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,				0,												0 },
+	{	VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,	VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,			0 },
+	{	VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,	VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,	0 },
+	{	VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,		VK_IMAGE_USAGE_SAMPLED_BIT,						VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,		VK_IMAGE_USAGE_SAMPLED_BIT,						VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,			VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL,						VK_IMAGE_USAGE_STORAGE_BIT,						VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_GENERAL,						VK_IMAGE_USAGE_STORAGE_BIT,						VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,						0,												VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,			VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,						0,												VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT },
+	{	VK_PIPELINE_STAGE_TRANSFER_BIT,					VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,			VK_IMAGE_USAGE_TRANSFER_SRC_BIT,				VK_BUFFER_USAGE_TRANSFER_SRC_BIT },
+	{	VK_PIPELINE_STAGE_TRANSFER_BIT,					VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,			VK_IMAGE_USAGE_TRANSFER_DST_BIT,				VK_BUFFER_USAGE_TRANSFER_DST_BIT },
+};
+
+// only writes have to be made available, reads just need the execution dependency
+constexpr VkAccessFlags WRITE_ACCESS_MASK =
+	VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+VkDeviceSize AlignUp( VkDeviceSize value, VkDeviceSize alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+}
+
+RenderGraphPass::RenderGraphPass( const std::string & name, RENDER_GRAPH_PASS_TYPE type )
+{
+	_name			= name;
+	_type			= type;
+}
+
+void RenderGraphPass::AddColorAttachment( RenderGraphResource image )
+{
+	_AddAttachment( image, false, false, VkClearValue {} );
+}
+
+void RenderGraphPass::AddColorAttachment( RenderGraphResource image, const VkClearColorValue & clear_color )
+{
+	VkClearValue clear_value {};
+	clear_value.color		= clear_color;
+	_AddAttachment( image, false, true, clear_value );
+}
+
+void RenderGraphPass::SetDepthAttachment( RenderGraphResource image )
+{
+	_AddAttachment( image, true, false, VkClearValue {} );
+}
+
+void RenderGraphPass::SetDepthAttachment( RenderGraphResource image, const VkClearDepthStencilValue & clear_depth )
+{
+	VkClearValue clear_value {};
+	clear_value.depthStencil	= clear_depth;
+	_AddAttachment( image, true, true, clear_value );
+}
+
+void RenderGraphPass::_AddAttachment( RenderGraphResource image, bool depth, bool clear, const VkClearValue & clear_value )
+{
+	assert( RENDER_GRAPH_PASS_GRAPHICS == _type && "Only graphics passes have attachments." );
+	for( auto &a : _attachments ) {
+		assert( !( depth && a.depth ) && "Render graph pass has more than one depth attachment." );
+	}
+
+	Attachment attachment;
+	attachment.resource		= image;
+	attachment.depth		= depth;
+	attachment.clear		= clear;
+	attachment.clear_value	= clear_value;
+	_attachments.push_back( attachment );
+
+	ResourceUse use;
+	use.resource			= image;
+	use.access				= depth ? RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT : RENDER_GRAPH_ACCESS_COLOR_ATTACHMENT;
+	use.write				= true;
+	use.attachment			= true;
+	use.clear				= clear;
+	_uses.push_back( use );
+}
+
+void RenderGraphPass::Read( RenderGraphResource resource, RENDER_GRAPH_ACCESS access )
+{
+	ResourceUse use;
+	use.resource			= resource;
+	use.access				= access;
+	_uses.push_back( use );
+}
+
+void RenderGraphPass::Write( RenderGraphResource resource, RENDER_GRAPH_ACCESS access )
+{
+	ResourceUse use;
+	use.resource			= resource;
+	use.access				= access;
+	use.write				= true;
+	_uses.push_back( use );
+}
+
+void RenderGraphPass::SetSideEffects()
+{
+	_side_effects			= true;
+}
+
+void RenderGraphPass::SetRecord( std::function<void( VkCommandBuffer command_buffer )> record )
+{
+	_record					= std::move( record );
+}
+
+void RenderGraphPass::SetExecute( std::function<void( VkCommandBuffer command_buffer )> execute )
+{
+	_execute				= std::move( execute );
+}
+
+const std::string & RenderGraphPass::GetName() const
+{
+	return _name;
+}
+
+RenderGraph::RenderGraph( Renderer * renderer, uint32_t frame_count )
+{
+	_renderer						= renderer;
+	_device							= _renderer->GetVulkanDevice();
+	_allocation_callbacks			= _renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_WINDOW );
+	_memory_allocation_callbacks	= _renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY );
+	_frame_count					= std::max( frame_count, 1u );
+}
+
+RenderGraph::~RenderGraph()
+{
+	Reset();
+}
+
+void RenderGraph::Reset()
+{
+	for( auto pass : _passes ) {
+		_DestroyPassObjects( pass );
+		delete pass;
+	}
+	_DestroyTransientResources();
+
+	_passes.clear();
+	_pass_order.clear();
+	_recorded_passes.clear();
+	_resources.clear();
+	_final_barriers.clear();
+	_final_src_stages			= 0;
+	_final_dst_stages			= 0;
+	_frame_index				= 0;
+	_compiled					= false;
+}
+
+RenderGraphResource RenderGraph::CreateImage( const std::string & name, const RenderGraphImageInfo & info )
+{
+	Resource r;
+	r.name				= name;
+	r.image				= true;
+	r.image_info		= info;
+	return _AddResource( r );
+}
+
+RenderGraphResource RenderGraph::CreateBuffer( const std::string & name, const RenderGraphBufferInfo & info )
+{
+	Resource r;
+	r.name				= name;
+	r.image				= false;
+	r.buffer_info		= info;
+	return _AddResource( r );
+}
+
+RenderGraphResource RenderGraph::ImportImage( const std::string & name, const RenderGraphImageInfo & info, RENDER_GRAPH_ACCESS initial_access, RENDER_GRAPH_ACCESS final_access )
+{
+	Resource r;
+	r.name				= name;
+	r.image				= true;
+	r.imported			= true;
+	r.image_info		= info;
+	r.initial_access	= initial_access;
+	r.final_access		= final_access;
+	return _AddResource( r );
+}
+
+RenderGraphResource RenderGraph::ImportBuffer( const std::string & name, VkDeviceSize size, RENDER_GRAPH_ACCESS initial_access, RENDER_GRAPH_ACCESS final_access )
+{
+	Resource r;
+	r.name				= name;
+	r.image				= false;
+	r.imported			= true;
+	r.buffer_info.size	= size;
+	r.initial_access	= initial_access;
+	r.final_access		= final_access;
+	return _AddResource( r );
+}
+
+RenderGraphResource RenderGraph::_AddResource( const Resource & resource )
+{
+	assert( !_compiled && "Render graph is already compiled, Reset before declaring new resources." );
+	_resources.push_back( resource );
+	return RenderGraphResource( _resources.size() - 1 );
+}
+
+RenderGraphPass * RenderGraph::AddPass( const std::string & name, RENDER_GRAPH_PASS_TYPE type )
+{
+	assert( !_compiled && "Render graph is already compiled, Reset before declaring new passes." );
+	auto pass = new RenderGraphPass( name, type );
+	_passes.push_back( pass );
+	return pass;
+}
+
+void RenderGraph::Compile()
+{
+	assert( !_compiled && "Render graph is already compiled." );
+	for( auto pass : _passes ) {
+		for( auto &u : pass->_uses ) {
+			if( u.resource >= _resources.size() ) {
+				assert( 0 && "Render graph pass uses an unknown resource." );
+				std::exit( -1 );
+			}
+		}
+	}
+
+	_Cull();
+	_ComputeLifetimes();
+	_CreateTransientResources();
+	_DeriveBarriers();
+	_CreateCommandBuffers();
+	_compiled			= true;
+}
+
+void RenderGraph::_Cull()
+{
+	// walk backwards from the outputs, a pass survives if something after it needs what it writes
+	std::vector<bool> needed( _resources.size(), false );
+	for( size_t i=0; i < _resources.size(); ++i ) {
+		needed[ i ]		= _resources[ i ].imported && RENDER_GRAPH_ACCESS_NONE != _resources[ i ].final_access;
+	}
+
+	for( auto it = _passes.rbegin(); it != _passes.rend(); ++it ) {
+		auto pass		= *it;
+		bool keep		= pass->_side_effects;
+		for( auto &u : pass->_uses ) {
+			keep		|= u.write && needed[ u.resource ];
+		}
+		pass->_culled	= !keep;
+		if( !keep ) continue;
+
+		// cleared attachments don't care what was written before, loaded ones and reads do
+		for( auto &u : pass->_uses ) {
+			if( u.clear ) needed[ u.resource ] = false;
+		}
+		for( auto &u : pass->_uses ) {
+			if( !u.clear ) needed[ u.resource ] = true;
+		}
+	}
+
+	_pass_order.clear();
+	for( auto pass : _passes ) {
+		if( !pass->_culled ) _pass_order.push_back( pass );
+	}
+}
+
+void RenderGraph::_ComputeLifetimes()
+{
+	for( uint32_t p=0; p < uint32_t( _pass_order.size() ); ++p ) {
+		for( auto &u : _pass_order[ p ]->_uses ) {
+			auto &r				= _resources[ u.resource ];
+			auto &info			= access_table[ u.access ];
+			if( UINT32_MAX == r.first_pass || r.first_pass == p ) {
+				r.first_use_stages	|= info.stage;
+			}
+			r.first_pass		= std::min( r.first_pass, p );
+			r.last_pass			= std::max( r.last_pass, p );
+			r.used_stages		|= info.stage;
+			if( u.write ) {
+				r.written_access	|= info.access & WRITE_ACCESS_MASK;
+			}
+			if( r.image ) {
+				r.image_info.usage	|= info.image_usage;
+			} else {
+				r.buffer_info.usage	|= info.buffer_usage;
+			}
+		}
+	}
+}
+
+void RenderGraph::_CreateTransientResources()
+{
+	auto &mem_props				= _renderer->GetVulkanPhysicalDeviceMemoryProperties();
+	VkDeviceSize granularity	= _renderer->GetVulkanPhysicalDeviceProperties().limits.bufferImageGranularity;
+
+	std::vector<RenderGraphResource> transients;
+	for( RenderGraphResource i=0; i < RenderGraphResource( _resources.size() ); ++i ) {
+		auto &r = _resources[ i ];
+		// unused or only used by culled passes
+		if( r.imported || UINT32_MAX == r.first_pass ) continue;
+
+		if( r.image ) {
+			VkImageCreateInfo image_create_info {};
+			image_create_info.sType					= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType				= VK_IMAGE_TYPE_2D;
+			image_create_info.format				= r.image_info.format;
+			image_create_info.extent.width			= r.image_info.extent.width;
+			image_create_info.extent.height			= r.image_info.extent.height;
+			image_create_info.extent.depth			= 1;
+			image_create_info.arrayLayers			= 1;
+			image_create_info.mipLevels				= 1;
+			image_create_info.samples				= VK_SAMPLE_COUNT_1_BIT;
+			image_create_info.tiling				= VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.initialLayout			= VK_IMAGE_LAYOUT_UNDEFINED;
+			image_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.usage					= r.image_info.usage;
+			ErrCheck( vkCreateImage( _device, &image_create_info, _allocation_callbacks, &r.vulkan_image ) );
+			vkGetImageMemoryRequirements( _device, r.vulkan_image, &r.memory_requirements );
+		} else {
+			VkBufferCreateInfo buffer_create_info {};
+			buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_create_info.size					= r.buffer_info.size;
+			buffer_create_info.usage				= r.buffer_info.usage;
+			buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+			ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &r.vulkan_buffer ) );
+			vkGetBufferMemoryRequirements( _device, r.vulkan_buffer, &r.memory_requirements );
+		}
+		transients.push_back( i );
+	}
+
+	// biggest first, smaller resources fill the gaps they leave
+	std::sort( transients.begin(), transients.end(), [ this ]( RenderGraphResource a, RenderGraphResource b ) {
+		return _resources[ a ].memory_requirements.size > _resources[ b ].memory_requirements.size;
+	} );
+
+	std::vector<RenderGraphResource> placed;
+	std::vector<VkDeviceSize> candidates;
+	for( auto i : transients ) {
+		auto &r = _resources[ i ];
+
+		uint32_t memory_type_index	= UINT32_MAX;
+		for( uint32_t t=0; t < mem_props.memoryTypeCount; ++t ) {
+			if( ( r.memory_requirements.memoryTypeBits & ( 1u << t ) ) &&
+				( mem_props.memoryTypes[ t ].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ) ) {
+				memory_type_index	= t;
+				break;
+			}
+		}
+		if( UINT32_MAX == memory_type_index ) {
+			assert( 0 && "No device local memory type for a render graph resource." );
+			std::exit( -1 );
+		}
+
+		// one block per memory type
+		r.memory_block		= UINT32_MAX;
+		for( uint32_t b=0; b < uint32_t( _memory_blocks.size() ); ++b ) {
+			if( _memory_blocks[ b ].memory_type_index == memory_type_index ) r.memory_block = b;
+		}
+		if( UINT32_MAX == r.memory_block ) {
+			MemoryBlock block;
+			block.memory_type_index		= memory_type_index;
+			_memory_blocks.push_back( block );
+			r.memory_block				= uint32_t( _memory_blocks.size() - 1 );
+		}
+
+		// first offset that doesn't collide with a resource alive at the same time
+		VkDeviceSize alignment	= std::max( r.memory_requirements.alignment, granularity );
+		candidates.clear();
+		candidates.push_back( 0 );
+		for( auto p : placed ) {
+			auto &o = _resources[ p ];
+			if( o.memory_block == r.memory_block ) {
+				candidates.push_back( AlignUp( o.memory_offset + o.memory_requirements.size, alignment ) );
+			}
+		}
+		std::sort( candidates.begin(), candidates.end() );
+		for( auto offset : candidates ) {
+			bool collides	= false;
+			for( auto p : placed ) {
+				auto &o = _resources[ p ];
+				if( o.memory_block != r.memory_block ) continue;
+				bool alive_together		= !BUILD_ENABLE_RENDER_GRAPH_ALIASING ||
+					( o.first_pass <= r.last_pass && r.first_pass <= o.last_pass );
+				bool overlaps			= offset < o.memory_offset + o.memory_requirements.size &&
+					o.memory_offset < offset + r.memory_requirements.size;
+				if( alive_together && overlaps ) {
+					collides		= true;
+					break;
+				}
+			}
+			if( !collides ) {
+				r.memory_offset		= offset;
+				break;
+			}
+		}
+		auto &block				= _memory_blocks[ r.memory_block ];
+		block.size				= std::max( block.size, r.memory_offset + r.memory_requirements.size );
+		placed.push_back( i );
+
+		_transient_memory_unaliased		+= r.memory_requirements.size;
+	}
+
+	for( auto &block : _memory_blocks ) {
+		VkMemoryAllocateInfo allocate_info {};
+		allocate_info.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.allocationSize	= block.size;
+		allocate_info.memoryTypeIndex	= block.memory_type_index;
+		ErrCheck( vkAllocateMemory( _device, &allocate_info, _memory_allocation_callbacks, &block.memory ) );
+
+		_transient_memory_size			+= block.size;
+	}
+
+	for( auto i : transients ) {
+		auto &r			= _resources[ i ];
+		auto memory		= _memory_blocks[ r.memory_block ].memory;
+		if( r.image ) {
+			ErrCheck( vkBindImageMemory( _device, r.vulkan_image, memory, r.memory_offset ) );
+
+			VkImageViewCreateInfo view_create_info {};
+			view_create_info.sType			= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.viewType		= VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.image			= r.vulkan_image;
+			view_create_info.format			= r.image_info.format;
+			view_create_info.components.r	= VK_COMPONENT_SWIZZLE_R;
+			view_create_info.components.g	= VK_COMPONENT_SWIZZLE_G;
+			view_create_info.components.b	= VK_COMPONENT_SWIZZLE_B;
+			view_create_info.components.a	= VK_COMPONENT_SWIZZLE_A;
+			view_create_info.subresourceRange.aspectMask		= r.image_info.aspect;
+			view_create_info.subresourceRange.levelCount		= 1;
+			view_create_info.subresourceRange.layerCount		= 1;
+			view_create_info.subresourceRange.baseMipLevel		= 0;
+			view_create_info.subresourceRange.baseArrayLayer	= 0;
+			ErrCheck( vkCreateImageView( _device, &view_create_info, _allocation_callbacks, &r.vulkan_image_view ) );
+		} else {
+			ErrCheck( vkBindBufferMemory( _device, r.vulkan_buffer, memory, r.memory_offset ) );
+		}
+	}
+}
+
+void RenderGraph::_DestroyTransientResources()
+{
+	for( auto &r : _resources ) {
+		if( r.imported ) continue;
+		vkDestroyImageView( _device, r.vulkan_image_view, _allocation_callbacks );
+		vkDestroyImage( _device, r.vulkan_image, _allocation_callbacks );
+		vkDestroyBuffer( _device, r.vulkan_buffer, _allocation_callbacks );
+		r.vulkan_image_view		= VK_NULL_HANDLE;
+		r.vulkan_image			= VK_NULL_HANDLE;
+		r.vulkan_buffer			= VK_NULL_HANDLE;
+	}
+	for( auto &block : _memory_blocks ) {
+		vkFreeMemory( _device, block.memory, _memory_allocation_callbacks );
+	}
+	_memory_blocks.clear();
+	_transient_memory_size			= 0;
+	_transient_memory_unaliased		= 0;
+}
+
+RenderGraph::ResourceState RenderGraph::_GetInitialState( RenderGraphResource resource ) const
+{
+	auto &r = _resources[ resource ];
+	ResourceState state;
+	if( r.imported ) {
+		auto &info				= access_table[ r.initial_access ];
+		state.layout			= r.image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		if( RENDER_GRAPH_ACCESS_SWAPCHAIN_ACQUIRE == r.initial_access ) {
+			// the semaphore wait blocks the first use, transitions chain on the same stages
+			state.read_stages	= r.first_use_stages ? r.first_use_stages : info.stage;
+		} else if( info.access & WRITE_ACCESS_MASK ) {
+			state.write_stages	= info.stage;
+			state.write_access	= info.access & WRITE_ACCESS_MASK;
+		} else {
+			state.read_stages	= info.stage;
+			state.read_access	= info.access;
+		}
+		return state;
+	}
+
+	// Transient contents are undefined, but the memory may still be in use by an aliased resource
+	// earlier in the frame or by the last frame. Wait for everything that shares the memory range.
+	for( auto &o : _resources ) {
+		if( o.imported || o.memory_block != r.memory_block ) continue;
+		bool overlaps			= r.memory_offset < o.memory_offset + o.memory_requirements.size &&
+			o.memory_offset < r.memory_offset + r.memory_requirements.size;
+		if( overlaps ) {
+			state.write_stages	|= o.used_stages;
+			state.write_access	|= o.written_access;
+		}
+	}
+	return state;
+}
+
+bool RenderGraph::_Transition( const Resource & resource, ResourceState & state, RENDER_GRAPH_ACCESS access, bool write,
+	RenderGraphPass::Barrier & barrier, VkPipelineStageFlags & src_stages, VkPipelineStageFlags & dst_stages ) const
+{
+	auto &info					= access_table[ access ];
+	VkImageLayout new_layout	= resource.image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+	bool layout_change			= resource.image && new_layout != state.layout;
+
+	VkPipelineStageFlags src	= 0;
+	VkAccessFlags src_access	= 0;
+	barrier.old_layout			= state.layout;
+	barrier.new_layout			= new_layout;
+
+	if( write || layout_change ) {
+		// writes and layout transitions wait for every access before them
+		src						= state.write_stages | state.read_stages;
+		src_access				= state.write_access;
+		if( 0 == src && !layout_change ) {
+			// first write of a resource nobody touched before
+			state.write_stages	= info.stage;
+			state.write_access	= info.access & WRITE_ACCESS_MASK;
+			return false;
+		}
+		if( write ) {
+			state.write_stages	= info.stage;
+			state.write_access	= info.access & WRITE_ACCESS_MASK;
+			state.read_stages	= 0;
+			state.read_access	= 0;
+		} else {
+			// the transition is the write, later reads chain on the stage that waited for it
+			state.write_stages	= info.stage;
+			state.write_access	= 0;
+			state.read_stages	= info.stage;
+			state.read_access	= info.access;
+		}
+		state.layout			= new_layout;
+	} else {
+		// reads only wait for the last write, and only once per stage
+		if( ( state.read_stages & info.stage ) == info.stage && ( state.read_access & info.access ) == info.access ) return false;
+		state.read_stages		|= info.stage;
+		state.read_access		|= info.access;
+		if( 0 == state.write_stages ) return false;
+		src						= state.write_stages;
+		src_access				= state.write_access;
+	}
+
+	barrier.src_access			= src_access;
+	barrier.dst_access			= info.access;
+	src_stages					|= src ? src : VkPipelineStageFlags( VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+	dst_stages					|= info.stage;
+	return true;
+}
+
+void RenderGraph::_DeriveBarriers()
+{
+	std::vector<ResourceState> states( _resources.size() );
+	for( RenderGraphResource i=0; i < RenderGraphResource( _resources.size() ); ++i ) {
+		states[ i ]		= _GetInitialState( i );
+	}
+	// resources whose last use already matches their final access need no hand off, the next
+	// Execute waits for that access through the initial state
+	std::vector<bool> finalized( _resources.size(), false );
+	for( auto pass : _pass_order ) {
+		for( auto &u : pass->_uses ) {
+			finalized[ u.resource ]		= u.access == _resources[ u.resource ].final_access;
+		}
+	}
+
+	for( uint32_t p=0; p < uint32_t( _pass_order.size() ); ++p ) {
+		auto pass				= _pass_order[ p ];
+		bool graphics			= RENDER_GRAPH_PASS_GRAPHICS == pass->_type;
+
+		std::vector<VkAttachmentDescription> attachments;
+		VkSubpassDependency dependency_in {};
+		dependency_in.srcSubpass		= VK_SUBPASS_EXTERNAL;
+		dependency_in.dstSubpass		= 0;
+		VkSubpassDependency dependency_out {};
+		dependency_out.srcSubpass		= 0;
+		dependency_out.dstSubpass		= VK_SUBPASS_EXTERNAL;
+
+		for( auto &u : pass->_uses ) {
+			auto &r				= _resources[ u.resource ];
+			auto &state			= states[ u.resource ];
+
+			RenderGraphPass::Barrier barrier;
+			barrier.resource	= u.resource;
+			VkImageLayout old_layout	= state.layout;
+
+			if( !( graphics && u.attachment ) ) {
+				if( _Transition( r, state, u.access, u.write, barrier, pass->_barrier_src_stages, pass->_barrier_dst_stages ) ) {
+					pass->_barriers.push_back( barrier );
+				}
+				continue;
+			}
+
+			// attachment transitions become the render pass initial layout and incoming dependency
+			if( _Transition( r, state, u.access, u.write, barrier, dependency_in.srcStageMask, dependency_in.dstStageMask ) ) {
+				dependency_in.srcAccessMask	|= barrier.src_access;
+				dependency_in.dstAccessMask	|= barrier.dst_access;
+			}
+
+			bool discard			= u.clear || VK_IMAGE_LAYOUT_UNDEFINED == old_layout;
+			bool used_later			= r.imported || r.last_pass > p;
+			VkAttachmentDescription attachment {};
+			attachment.format				= r.image_info.format;
+			attachment.samples				= VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp				= u.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : ( discard ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD );
+			attachment.storeOp				= used_later ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp		= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp		= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			if( r.image_info.aspect & VK_IMAGE_ASPECT_STENCIL_BIT ) {
+				attachment.stencilLoadOp	= attachment.loadOp;
+				attachment.stencilStoreOp	= attachment.storeOp;
+			}
+			attachment.initialLayout		= discard ? VK_IMAGE_LAYOUT_UNDEFINED : old_layout;
+			attachment.finalLayout			= state.layout;
+
+			// last use of a graph output, leave the render pass in the final layout right away
+			if( r.imported && RENDER_GRAPH_ACCESS_NONE != r.final_access && r.last_pass == p && !finalized[ u.resource ] ) {
+				if( _Transition( r, state, r.final_access, false, barrier, dependency_out.srcStageMask, dependency_out.dstStageMask ) ) {
+					dependency_out.srcAccessMask	|= barrier.src_access;
+					dependency_out.dstAccessMask	|= barrier.dst_access;
+				}
+				attachment.finalLayout		= state.layout;
+				finalized[ u.resource ]		= true;
+			}
+			attachments.push_back( attachment );
+		}
+
+		if( graphics ) {
+			std::vector<VkSubpassDependency> dependencies;
+			if( dependency_in.srcStageMask ) dependencies.push_back( dependency_in );
+			if( dependency_out.srcStageMask ) dependencies.push_back( dependency_out );
+			_CreateRenderPass( pass, attachments, dependencies );
+		}
+	}
+
+	// outputs that weren't left in their final access by a render pass
+	for( RenderGraphResource i=0; i < RenderGraphResource( _resources.size() ); ++i ) {
+		auto &r = _resources[ i ];
+		if( !r.imported || RENDER_GRAPH_ACCESS_NONE == r.final_access || finalized[ i ] ) continue;
+
+		RenderGraphPass::Barrier barrier;
+		barrier.resource	= i;
+		if( _Transition( r, states[ i ], r.final_access, false, barrier, _final_src_stages, _final_dst_stages ) ) {
+			_final_barriers.push_back( barrier );
+		}
+	}
+}
+
+void RenderGraph::_CreateRenderPass( RenderGraphPass * pass, const std::vector<VkAttachmentDescription> & attachments, const std::vector<VkSubpassDependency> & dependencies )
+{
+	std::vector<VkAttachmentReference> color_attachment_refs;
+	VkAttachmentReference depth_attachment_ref {};
+	bool has_depth		= false;
+	for( uint32_t i=0; i < uint32_t( pass->_attachments.size() ); ++i ) {
+		auto &a = pass->_attachments[ i ];
+		VkAttachmentReference ref {};
+		ref.attachment		= i;
+		ref.layout			= access_table[ a.depth ? RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT : RENDER_GRAPH_ACCESS_COLOR_ATTACHMENT ].layout;
+		if( a.depth ) {
+			depth_attachment_ref	= ref;
+			has_depth				= true;
+		} else {
+			color_attachment_refs.push_back( ref );
+		}
+		pass->_clear_values.push_back( a.clear_value );
+	}
+	pass->_attachment_views.resize( pass->_attachments.size() );
+	if( !pass->_attachments.empty() ) {
+		pass->_render_area	= _resources[ pass->_attachments[ 0 ].resource ].image_info.extent;
+	}
+
+	VkSubpassDescription subpass_description {};
+	subpass_description.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass_description.colorAttachmentCount	= uint32_t( color_attachment_refs.size() );
+	subpass_description.pColorAttachments		= color_attachment_refs.data();
+	subpass_description.pDepthStencilAttachment	= has_depth ? &depth_attachment_ref : nullptr;
+
+	VkRenderPassCreateInfo render_pass_create_info {};
+	render_pass_create_info.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount		= uint32_t( attachments.size() );
+	render_pass_create_info.pAttachments		= attachments.data();
+	render_pass_create_info.subpassCount		= 1;
+	render_pass_create_info.pSubpasses			= &subpass_description;
+	render_pass_create_info.dependencyCount		= uint32_t( dependencies.size() );
+	render_pass_create_info.pDependencies		= dependencies.data();
+
+	ErrCheck( vkCreateRenderPass( _device, &render_pass_create_info, _allocation_callbacks, &pass->_render_pass ) );
+}
+
+void RenderGraph::_CreateCommandBuffers()
+{
+	_recorded_passes.clear();
+	for( auto pass : _pass_order ) {
+		if( !pass->_record ) continue;
+		_recorded_passes.push_back( pass );
+
+		// pools are externally synchronized, one per pass lets passes record on different threads
+		pass->_command_pools.resize( _frame_count );
+		pass->_command_buffers.resize( _frame_count );
+		for( uint32_t f=0; f < _frame_count; ++f ) {
+			VkCommandPoolCreateInfo pool_create_info {};
+			pool_create_info.sType					= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			pool_create_info.queueFamilyIndex		= _renderer->GetVulkanGraphicsQueueFamilyIndex();
+			pool_create_info.flags					= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			ErrCheck( vkCreateCommandPool( _device, &pool_create_info, _allocation_callbacks, &pass->_command_pools[ f ] ) );
+
+			VkCommandBufferAllocateInfo allocate_info {};
+			allocate_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocate_info.commandPool				= pass->_command_pools[ f ];
+			allocate_info.level						= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocate_info.commandBufferCount		= 1;
+			ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, &pass->_command_buffers[ f ] ) );
+		}
+	}
+}
+
+void RenderGraph::_DestroyPassObjects( RenderGraphPass * pass )
+{
+	for( auto pool : pass->_command_pools ) {
+		vkDestroyCommandPool( _device, pool, _allocation_callbacks );
+	}
+	for( auto &f : pass->_framebuffers ) {
+		vkDestroyFramebuffer( _device, f.second, _allocation_callbacks );
+	}
+	vkDestroyRenderPass( _device, pass->_render_pass, _allocation_callbacks );
+	pass->_command_pools.clear();
+	pass->_command_buffers.clear();
+	pass->_framebuffers.clear();
+	pass->_render_pass			= VK_NULL_HANDLE;
+}
+
+void RenderGraph::SetImportedImage( RenderGraphResource image, VkImage vulkan_image, VkImageView vulkan_image_view )
+{
+	assert( _resources[ image ].imported && _resources[ image ].image && "Not an imported image." );
+	_resources[ image ].vulkan_image		= vulkan_image;
+	_resources[ image ].vulkan_image_view	= vulkan_image_view;
+}
+
+void RenderGraph::SetImportedBuffer( RenderGraphResource buffer, VkBuffer vulkan_buffer )
+{
+	assert( _resources[ buffer ].imported && !_resources[ buffer ].image && "Not an imported buffer." );
+	_resources[ buffer ].vulkan_buffer		= vulkan_buffer;
+}
+
+void RenderGraph::SetFramebuffer( RenderGraphPass * pass, VkFramebuffer framebuffer )
+{
+	pass->_external_framebuffer		= framebuffer;
+}
+
+void RenderGraph::SetRenderArea( RenderGraphPass * pass, VkExtent2D render_area )
+{
+	pass->_render_area_override		= render_area;
+}
+
+VkFramebuffer RenderGraph::_GetFramebuffer( RenderGraphPass * pass )
+{
+	if( VK_NULL_HANDLE != pass->_external_framebuffer ) return pass->_external_framebuffer;
+
+	auto &views = pass->_attachment_views;
+	for( size_t i=0; i < views.size(); ++i ) {
+		views[ i ] = _resources[ pass->_attachments[ i ].resource ].vulkan_image_view;
+	}
+	for( auto &f : pass->_framebuffers ) {
+		if( f.first == views ) return f.second;
+	}
+
+	VkFramebufferCreateInfo framebuffer_create_info {};
+	framebuffer_create_info.sType				= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_create_info.renderPass			= pass->_render_pass;
+	framebuffer_create_info.attachmentCount		= uint32_t( views.size() );
+	framebuffer_create_info.pAttachments		= views.data();
+	framebuffer_create_info.width				= pass->_render_area.width;
+	framebuffer_create_info.height				= pass->_render_area.height;
+	framebuffer_create_info.layers				= 1;
+
+	VkFramebuffer framebuffer					= VK_NULL_HANDLE;
+	ErrCheck( vkCreateFramebuffer( _device, &framebuffer_create_info, _allocation_callbacks, &framebuffer ) );
+	pass->_framebuffers.push_back( std::make_pair( views, framebuffer ) );
+	return framebuffer;
+}
+
+void RenderGraph::_CmdBarriers( VkCommandBuffer command_buffer, const std::vector<RenderGraphPass::Barrier> & barriers, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages )
+{
+	if( barriers.empty() ) return;
+
+	_image_barriers.clear();
+	_buffer_barriers.clear();
+	for( auto &b : barriers ) {
+		auto &r = _resources[ b.resource ];
+		if( r.image ) {
+			VkImageMemoryBarrier image_barrier {};
+			image_barrier.sType						= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			image_barrier.image						= r.vulkan_image;
+			image_barrier.oldLayout					= b.old_layout;
+			image_barrier.newLayout					= b.new_layout;
+			image_barrier.srcAccessMask				= b.src_access;
+			image_barrier.dstAccessMask				= b.dst_access;
+			image_barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.subresourceRange.aspectMask		= r.image_info.aspect;
+			image_barrier.subresourceRange.layerCount		= 1;
+			image_barrier.subresourceRange.levelCount		= 1;
+			image_barrier.subresourceRange.baseArrayLayer	= 0;
+			image_barrier.subresourceRange.baseMipLevel		= 0;
+			_image_barriers.push_back( image_barrier );
+		} else {
+			VkBufferMemoryBarrier buffer_barrier {};
+			buffer_barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			buffer_barrier.buffer					= r.vulkan_buffer;
+			buffer_barrier.offset					= 0;
+			buffer_barrier.size						= VK_WHOLE_SIZE;
+			buffer_barrier.srcAccessMask			= b.src_access;
+			buffer_barrier.dstAccessMask			= b.dst_access;
+			buffer_barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+			buffer_barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+			_buffer_barriers.push_back( buffer_barrier );
+		}
+	}
+
+	vkCmdPipelineBarrier( command_buffer,
+		src_stages,
+		dst_stages,
+		0,
+		0, nullptr,
+		uint32_t( _buffer_barriers.size() ), _buffer_barriers.data(),
+		uint32_t( _image_barriers.size() ), _image_barriers.data() );
+}
+
+void RenderGraph::Execute( VkCommandBuffer command_buffer )
+{
+	assert( _compiled && "Render graph must be compiled before it's executed." );
+
+	uint32_t frame		= _frame_index;
+	_frame_index		= ( _frame_index + 1 ) % _frame_count;
+
+	// framebuffers may be created here, do it before recording goes wide
+	for( auto pass : _pass_order ) {
+		if( RENDER_GRAPH_PASS_GRAPHICS == pass->_type ) {
+			pass->_current_framebuffer	= _GetFramebuffer( pass );
+		}
+	}
+
+	if( !_recorded_passes.empty() ) {
+		// queued by reference, must outlive the wait below
+		std::function<void( uint32_t, uint32_t )> record_range = [ this, frame ]( uint32_t begin, uint32_t end ) {
+			for( uint32_t i=begin; i < end; ++i ) {
+				auto pass				= _recorded_passes[ i ];
+				auto secondary			= pass->_command_buffers[ frame ];
+				bool graphics			= RENDER_GRAPH_PASS_GRAPHICS == pass->_type;
+				ErrCheck( vkResetCommandPool( _device, pass->_command_pools[ frame ], 0 ) );
+
+				VkCommandBufferInheritanceInfo inheritance_info {};
+				inheritance_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+				inheritance_info.renderPass				= graphics ? pass->_render_pass : VK_NULL_HANDLE;
+				inheritance_info.subpass				= 0;
+				inheritance_info.framebuffer			= graphics ? pass->_current_framebuffer : VK_NULL_HANDLE;
+
+				VkCommandBufferBeginInfo begin_info {};
+				begin_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				begin_info.flags						= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | ( graphics ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0 );
+				begin_info.pInheritanceInfo				= &inheritance_info;
+
+				ErrCheck( vkBeginCommandBuffer( secondary, &begin_info ) );
+				pass->_record( secondary );
+				ErrCheck( vkEndCommandBuffer( secondary ) );
+			}
+		};
+		auto job_system		= _renderer->GetJobSystem();
+		JobCounter counter( 0 );
+		job_system->ParallelFor( counter, uint32_t( _recorded_passes.size() ), 1, record_range );
+		job_system->Wait( counter );
+	}
+
+	for( auto pass : _pass_order ) {
+		_CmdBarriers( command_buffer, pass->_barriers, pass->_barrier_src_stages, pass->_barrier_dst_stages );
+
+		bool graphics		= RENDER_GRAPH_PASS_GRAPHICS == pass->_type;
+		if( graphics ) {
+			VkRect2D render_area;
+			render_area.offset.x		= 0;
+			render_area.offset.y		= 0;
+			render_area.extent			= pass->_render_area_override.width ? pass->_render_area_override : pass->_render_area;
+
+			VkRenderPassBeginInfo begin_info {};
+			begin_info.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			begin_info.renderPass		= pass->_render_pass;
+			begin_info.framebuffer		= pass->_current_framebuffer;
+			begin_info.renderArea		= render_area;
+			begin_info.clearValueCount	= uint32_t( pass->_clear_values.size() );
+			begin_info.pClearValues		= pass->_clear_values.data();
+			vkCmdBeginRenderPass( command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+		}
+
+		if( pass->_record ) {
+			vkCmdExecuteCommands( command_buffer, 1, &pass->_command_buffers[ frame ] );
+		} else if( pass->_execute ) {
+			pass->_execute( command_buffer );
+		}
+
+		if( graphics ) {
+			vkCmdEndRenderPass( command_buffer );
+		}
+	}
+
+	_CmdBarriers( command_buffer, _final_barriers, _final_src_stages, _final_dst_stages );
+}
+
+VkImage RenderGraph::GetImage( RenderGraphResource image ) const
+{
+	return _resources[ image ].vulkan_image;
+}
+
+VkImageView RenderGraph::GetImageView( RenderGraphResource image ) const
+{
+	return _resources[ image ].vulkan_image_view;
+}
+
+VkBuffer RenderGraph::GetBuffer( RenderGraphResource buffer ) const
+{
+	return _resources[ buffer ].vulkan_buffer;
+}
+
+VkRenderPass RenderGraph::GetRenderPass( const RenderGraphPass * pass ) const
+{
+	return pass->_render_pass;
+}
+
+bool RenderGraph::IsCulled( const RenderGraphPass * pass ) const
+{
+	return pass->_culled;
+}
+
+VkPipelineStageFlags RenderGraph::GetFirstUseStages( RenderGraphResource resource ) const
+{
+	auto &r		= _resources[ resource ];
+	return r.first_use_stages ? r.first_use_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+void RenderGraph::PrintStatistics( std::ostream & stream ) const
+{
+	size_t barrier_count	= _final_barriers.size();
+	for( auto pass : _pass_order ) {
+		barrier_count		+= pass->_barriers.size();
+	}
+	stream << "Render graph: " << _pass_order.size() << " of " << _passes.size() << " passes, "
+		<< _recorded_passes.size() << " recorded in parallel, "
+		<< barrier_count << " barriers outside of render passes, "
+		<< "transient memory " << _transient_memory_size / 1024 << " KiB ("
+		<< _transient_memory_unaliased / 1024 << " KiB without aliasing)\n";
+	for( auto pass : _passes ) {
+		if( pass->_culled ) stream << "  culled \"" << pass->_name << "\"\n";
+	}
+}
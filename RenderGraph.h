@@ -0,0 +1,283 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <ostream>
+
+class Renderer;
+class RenderGraph;
+
+// Index of an image or buffer declared in a RenderGraph.
+typedef uint32_t RenderGraphResource;
+constexpr RenderGraphResource		RENDER_GRAPH_RESOURCE_NONE		= UINT32_MAX;
+
+// How a pass uses a resource. Decides pipeline stages, access masks and image layouts of the
+// barriers the graph derives, see RenderGraph.cpp for the table.
+enum RENDER_GRAPH_ACCESS : uint32_t
+{
+	RENDER_GRAPH_ACCESS_NONE					= 0,	// undefined contents, nothing to wait for
+	RENDER_GRAPH_ACCESS_SWAPCHAIN_ACQUIRE,				// initial access of swapchain images, wait for the acquire semaphore at RenderGraph::GetFirstUseStages
+	RENDER_GRAPH_ACCESS_PRESENT,
+	RENDER_GRAPH_ACCESS_COLOR_ATTACHMENT,
+	RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT,
+	RENDER_GRAPH_ACCESS_FRAGMENT_SAMPLED,				// sampled image or uniform texel data read in fragment shaders
+	RENDER_GRAPH_ACCESS_COMPUTE_SAMPLED,
+	RENDER_GRAPH_ACCESS_COMPUTE_READ,					// storage image or buffer
+	RENDER_GRAPH_ACCESS_COMPUTE_WRITE,
+	RENDER_GRAPH_ACCESS_VERTEX_BUFFER,					// vertex or index buffer
+	RENDER_GRAPH_ACCESS_INDIRECT_BUFFER,
+	RENDER_GRAPH_ACCESS_TRANSFER_READ,
+	RENDER_GRAPH_ACCESS_TRANSFER_WRITE,
+	RENDER_GRAPH_ACCESS_COUNT
+};
+
+enum RENDER_GRAPH_PASS_TYPE : uint32_t
+{
+	RENDER_GRAPH_PASS_GRAPHICS					= 0,	// runs inside a render pass made from its attachments
+	RENDER_GRAPH_PASS_COMPUTE,							// compute and transfer work, outside of render passes
+};
+
+struct RenderGraphImageInfo
+{
+	VkFormat						format					= VK_FORMAT_UNDEFINED;
+	VkExtent2D						extent					= { 0, 0 };
+	VkImageAspectFlags				aspect					= VK_IMAGE_ASPECT_COLOR_BIT;
+	VkImageUsageFlags				usage					= 0;		// on top of what the passes need
+};
+
+struct RenderGraphBufferInfo
+{
+	VkDeviceSize					size					= 0;
+	VkBufferUsageFlags				usage					= 0;		// on top of what the passes need
+};
+
+// Declared through RenderGraph::AddPass, describes what a pass touches and how it records.
+class RenderGraphPass
+{
+	friend class RenderGraph;
+
+public:
+	// Attachments are numbered in the order they are declared, external framebuffers
+	// given to RenderGraph::SetFramebuffer must use the same order.
+	void									AddColorAttachment( RenderGraphResource image );
+	void									AddColorAttachment( RenderGraphResource image, const VkClearColorValue & clear_color );
+	void									SetDepthAttachment( RenderGraphResource image );
+	void									SetDepthAttachment( RenderGraphResource image, const VkClearDepthStencilValue & clear_depth );
+
+	void									Read( RenderGraphResource resource, RENDER_GRAPH_ACCESS access );
+	void									Write( RenderGraphResource resource, RENDER_GRAPH_ACCESS access );
+
+	// Kept even when nothing reads what it writes, for work on resources outside of the graph.
+	void									SetSideEffects();
+
+	// Records into a secondary command buffer owned by the graph. Passes with a record
+	// function are recorded in parallel on the job system and must not share state.
+	void									SetRecord( std::function<void( VkCommandBuffer command_buffer )> record );
+	// Called with the primary command buffer instead, for secondary command buffers recorded
+	// elsewhere. Graphics passes are inside a render pass begun with secondary command buffer contents.
+	void									SetExecute( std::function<void( VkCommandBuffer command_buffer )> execute );
+
+	const std::string					&	GetName() const;
+
+private:
+	struct ResourceUse
+	{
+		RenderGraphResource					resource				= RENDER_GRAPH_RESOURCE_NONE;
+		RENDER_GRAPH_ACCESS					access					= RENDER_GRAPH_ACCESS_NONE;
+		bool								write					= false;
+		bool								attachment				= false;
+		bool								clear					= false;	// attachment contents are replaced
+	};
+
+	struct Attachment
+	{
+		RenderGraphResource					resource				= RENDER_GRAPH_RESOURCE_NONE;
+		bool								depth					= false;
+		bool								clear					= false;
+		VkClearValue						clear_value				= {};
+	};
+
+	// Pre computed by RenderGraph::Compile, image and buffer handles are filled in by Execute.
+	struct Barrier
+	{
+		RenderGraphResource					resource				= RENDER_GRAPH_RESOURCE_NONE;
+		VkAccessFlags						src_access				= 0;
+		VkAccessFlags						dst_access				= 0;
+		VkImageLayout						old_layout				= VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout						new_layout				= VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	RenderGraphPass( const std::string & name, RENDER_GRAPH_PASS_TYPE type );
+
+	void									_AddAttachment( RenderGraphResource image, bool depth, bool clear, const VkClearValue & clear_value );
+
+	std::string								_name;
+	RENDER_GRAPH_PASS_TYPE					_type					= RENDER_GRAPH_PASS_GRAPHICS;
+	std::vector<ResourceUse>				_uses;					// attachments included
+	std::vector<Attachment>					_attachments;
+	bool									_side_effects			= false;
+	std::function<void( VkCommandBuffer )>	_record;
+	std::function<void( VkCommandBuffer )>	_execute;
+
+	// compiled
+	bool									_culled					= false;
+	std::vector<Barrier>					_barriers;
+	VkPipelineStageFlags					_barrier_src_stages		= 0;
+	VkPipelineStageFlags					_barrier_dst_stages		= 0;
+	VkRenderPass							_render_pass			= VK_NULL_HANDLE;
+	VkExtent2D								_render_area			= { 0, 0 };
+	VkExtent2D								_render_area_override	= { 0, 0 };
+	std::vector<VkClearValue>				_clear_values;
+	VkFramebuffer							_external_framebuffer	= VK_NULL_HANDLE;
+	VkFramebuffer							_current_framebuffer	= VK_NULL_HANDLE;
+	std::vector<VkImageView>				_attachment_views;	// refilled in place each frame to look up _framebuffers
+	std::vector<std::pair<std::vector<VkImageView>, VkFramebuffer>>	_framebuffers;		// keyed by attachment views, imported views change per frame
+	std::vector<VkCommandPool>				_command_pools;			// one per frame set, passes with a record function only
+	std::vector<VkCommandBuffer>			_command_buffers;
+};
+
+// RenderGraph takes a list of passes with the resources they read and write and turns it into
+// command buffers. Passes whose results are never used are culled, layout transitions and
+// barriers are derived from the declared accesses, attachment transitions are folded into the
+// render passes. Transient images and buffers are created by the graph and share memory when
+// their lifetimes don't overlap.
+// Declare passes in execution order, Compile once, then Execute every frame. Execute cycles
+// through frame_count sets of command buffers, the GPU must have finished a set before it comes
+// around again, the window frame arena fence takes care of that.
+class RenderGraph
+{
+public:
+	RenderGraph( Renderer * renderer, uint32_t frame_count );
+	~RenderGraph();
+
+	// Drops all passes, resources and compiled objects. The GPU must be done with the graph.
+	void									Reset();
+
+	// Transient resources live only during Execute, their contents don't survive between frames.
+	RenderGraphResource						CreateImage( const std::string & name, const RenderGraphImageInfo & info );
+	RenderGraphResource						CreateBuffer( const std::string & name, const RenderGraphBufferInfo & info );
+	// Imported resources are owned elsewhere. They are expected in initial_access when Execute starts
+	// and left in final_access, resources with a final access other than none are graph outputs.
+	RenderGraphResource						ImportImage( const std::string & name, const RenderGraphImageInfo & info, RENDER_GRAPH_ACCESS initial_access, RENDER_GRAPH_ACCESS final_access );
+	RenderGraphResource						ImportBuffer( const std::string & name, VkDeviceSize size, RENDER_GRAPH_ACCESS initial_access, RENDER_GRAPH_ACCESS final_access );
+
+	// Returned pass is owned by the graph and valid until Reset.
+	RenderGraphPass						*	AddPass( const std::string & name, RENDER_GRAPH_PASS_TYPE type );
+
+	// Culls passes, creates transient resources, render passes and derives barriers.
+	void									Compile();
+
+	// Handles of imported resources, can change every frame.
+	void									SetImportedImage( RenderGraphResource image, VkImage vulkan_image, VkImageView vulkan_image_view );
+	void									SetImportedBuffer( RenderGraphResource buffer, VkBuffer vulkan_buffer );
+	// Use a framebuffer created elsewhere for a graphics pass, needed when secondary command buffers inherit it.
+	void									SetFramebuffer( RenderGraphPass * pass, VkFramebuffer framebuffer );
+	// Renders only the top left corner of the attachments, { 0, 0 } covers them whole.
+	void									SetRenderArea( RenderGraphPass * pass, VkExtent2D render_area );
+
+	// Records all passes that survived culling together with their barriers.
+	void									Execute( VkCommandBuffer command_buffer );
+
+	VkImage									GetImage( RenderGraphResource image ) const;
+	VkImageView								GetImageView( RenderGraphResource image ) const;
+	VkBuffer								GetBuffer( RenderGraphResource buffer ) const;
+	// Render pass of a compiled graphics pass, pipelines used by the pass must be compatible with it.
+	VkRenderPass							GetRenderPass( const RenderGraphPass * pass ) const;
+	bool									IsCulled( const RenderGraphPass * pass ) const;
+	// Stages of the first surviving pass that uses the resource. Semaphores guarding imported
+	// resources, like the swapchain acquire semaphore, must be waited on at these stages.
+	VkPipelineStageFlags					GetFirstUseStages( RenderGraphResource resource ) const;
+
+	void									PrintStatistics( std::ostream & stream ) const;
+
+private:
+	struct Resource
+	{
+		std::string							name;
+		bool								image					= true;
+		bool								imported				= false;
+		RenderGraphImageInfo				image_info;
+		RenderGraphBufferInfo				buffer_info;
+		RENDER_GRAPH_ACCESS					initial_access			= RENDER_GRAPH_ACCESS_NONE;
+		RENDER_GRAPH_ACCESS					final_access			= RENDER_GRAPH_ACCESS_NONE;
+
+		VkImage								vulkan_image			= VK_NULL_HANDLE;
+		VkImageView							vulkan_image_view		= VK_NULL_HANDLE;
+		VkBuffer							vulkan_buffer			= VK_NULL_HANDLE;
+
+		// compiled
+		uint32_t							first_pass				= UINT32_MAX;	// index into _pass_order
+		uint32_t							last_pass				= 0;
+		VkPipelineStageFlags				used_stages				= 0;
+		VkPipelineStageFlags				first_use_stages		= 0;
+		VkAccessFlags						written_access			= 0;
+		VkMemoryRequirements				memory_requirements		= {};
+		uint32_t							memory_block			= UINT32_MAX;
+		VkDeviceSize						memory_offset			= 0;
+	};
+
+	struct MemoryBlock
+	{
+		uint32_t							memory_type_index		= 0;
+		VkDeviceSize						size					= 0;
+		VkDeviceMemory						memory					= VK_NULL_HANDLE;
+	};
+
+	// Synchronization state of a resource while Compile walks the passes.
+	struct ResourceState
+	{
+		VkImageLayout						layout					= VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags				write_stages			= 0;
+		VkAccessFlags						write_access			= 0;
+		VkPipelineStageFlags				read_stages				= 0;	// reads since the last write that already see it
+		VkAccessFlags						read_access				= 0;
+	};
+
+	RenderGraphResource						_AddResource( const Resource & resource );
+
+	void									_Cull();
+	void									_ComputeLifetimes();
+	void									_CreateTransientResources();
+	void									_DestroyTransientResources();
+	// Returns false if no barrier is needed, otherwise fills the barrier and updates the state.
+	bool									_Transition( const Resource & resource, ResourceState & state, RENDER_GRAPH_ACCESS access, bool write,
+												RenderGraphPass::Barrier & barrier, VkPipelineStageFlags & src_stages, VkPipelineStageFlags & dst_stages ) const;
+	ResourceState							_GetInitialState( RenderGraphResource resource ) const;
+	void									_DeriveBarriers();
+	void									_CreateRenderPass( RenderGraphPass * pass, const std::vector<VkAttachmentDescription> & attachments, const std::vector<VkSubpassDependency> & dependencies );
+	void									_CreateCommandBuffers();
+	void									_DestroyPassObjects( RenderGraphPass * pass );
+
+	VkFramebuffer							_GetFramebuffer( RenderGraphPass * pass );
+	void									_CmdBarriers( VkCommandBuffer command_buffer, const std::vector<RenderGraphPass::Barrier> & barriers, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages );
+
+	Renderer							*	_renderer					= nullptr;
+	VkDevice								_device						= VK_NULL_HANDLE;
+	const VkAllocationCallbacks			*	_allocation_callbacks		= nullptr;
+	const VkAllocationCallbacks			*	_memory_allocation_callbacks	= nullptr;
+
+	uint32_t								_frame_count				= 1;
+	uint32_t								_frame_index				= 0;
+
+	std::vector<Resource>					_resources;
+	std::vector<RenderGraphPass*>			_passes;
+	std::vector<RenderGraphPass*>			_pass_order;				// passes that survived culling
+	std::vector<RenderGraphPass*>			_recorded_passes;			// surviving passes with a record function
+	std::vector<MemoryBlock>				_memory_blocks;
+	bool									_compiled					= false;
+
+	// imported resources leaving in their final access
+	std::vector<RenderGraphPass::Barrier>	_final_barriers;
+	VkPipelineStageFlags					_final_src_stages			= 0;
+	VkPipelineStageFlags					_final_dst_stages			= 0;
+
+	std::vector<VkImageMemoryBarrier>		_image_barriers;			// scratch for _CmdBarriers
+	std::vector<VkBufferMemoryBarrier>		_buffer_barriers;
+
+	VkDeviceSize							_transient_memory_size		= 0;
+	VkDeviceSize							_transient_memory_unaliased	= 0;
+};
@@ -6,21 +6,46 @@
 #include "Renderer.h"
 #include "Window.h"
 #include "Scene.h"
+#include "ComputePipeline.h"
+#include "Pipeline.h"
+#include "ShaderModuleCache.h"
+#include "AssetArchive.h"
+#include "PipelineLayoutCache.h"
+#include "FileWatcher.h"
+#include "JobSystem.h"
 
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 #include <assert.h>
 
-Renderer::Renderer( const std::vector<std::string> & used_pipeline_names )
+// quiet time after the last change before a pipeline is reloaded, editors and compilers write files in steps
+constexpr auto PIPELINE_RELOAD_SETTLE_TIME		= std::chrono::milliseconds( 100 );
+
+Renderer::Renderer( const std::vector<std::string> & used_pipeline_names, const std::vector<std::string> & lazy_pipeline_names, const std::string & preferred_device )
 {
+	_preferred_device		= preferred_device;
 	_pipeline_names			= used_pipeline_names;
+	_lazy_pipeline_names	= lazy_pipeline_names;
+	_allocation_callbacks	= _host_allocator.GetCallbacks( HOST_ALLOCATION_CATEGORY_RENDERER );
+	_asset_archive			= new AssetArchive( BUILD_ASSET_ARCHIVE_PATH );
+	_job_system				= new JobSystem( BUILD_JOB_SYSTEM_WORKER_COUNT );
 
 	_SetupLayersAndExtensions();
 	_SetupDebug();
 	_CreateInstance();
 	_CreateDebug();
 	_CreateDevice();
+	_pipeline_layout_cache	= new PipelineLayoutCache( this );
+	_CreateDescriptorSetLayouts();
+	_CreatePipelineCache();
+	_shader_module_cache	= new ShaderModuleCache( this );
+#if BUILD_ENABLE_SHADER_HOT_RELOAD
+	_pipeline_watcher		= new FileWatcher( BUILD_PIPELINE_DIRECTORY );
+#endif
 }
 
 
@@ -28,9 +53,25 @@ Renderer::~Renderer()
 {
 	_DestroyScenes();
 	_DestroyWindows();
+	_DestroyComputePipelines();
+	delete _pipeline_watcher;
+	_pipeline_watcher		= nullptr;
+	vkDeviceWaitIdle( _device );
+	_RunDeferredDestroys( true );
+	_DestroyPipelineLibrary();
+	delete _shader_module_cache;
+	_shader_module_cache	= nullptr;
+	_DestroyPipelineCache();
+	delete _pipeline_layout_cache;
+	_pipeline_layout_cache	= nullptr;
+	_camera_descriptor_set_layout	= VK_NULL_HANDLE;
 	_DestroyDevice();
 	_DestroyDebug();
 	_DestroyInstance();
+	delete _asset_archive;
+	_asset_archive			= nullptr;
+	delete _job_system;
+	_job_system				= nullptr;
 }
 
 
@@ -49,30 +90,73 @@ Scene * Renderer::CreateScene()
 	return scene;
 }
 
+ComputePipeline * Renderer::GetComputePipeline( const std::string & name, const PipelineSpecialization & specialization )
+{
+	for( auto p : _compute_pipelines ) {
+		if( p->GetName() == name && p->GetSpecialization() == specialization ) {
+			return p;
+		}
+	}
+	auto pipeline = new ComputePipeline( this, name, specialization );
+	_compute_pipelines.push_back( pipeline );
+	return pipeline;
+}
+
+Pipeline * Renderer::GetPipeline( const PipelineStateKey & key, bool build_now )
+{
+	auto &bucket = _pipeline_library[ key.Hash() ];
+	for( auto p : bucket ) {
+		if( p->GetStateKey() == key ) {
+			if( build_now ) p->BuildAsync();
+			return p;
+		}
+	}
+	auto pipeline = new Pipeline( this, key );
+	if( build_now ) {
+		pipeline->BuildAsync();
+	}
+	bucket.push_back( pipeline );
+	return pipeline;
+}
+
 bool Renderer::Run()
 {
-	std::vector<Window*> windows_to_destroy;
-	for( auto w : _windows ) {
+	++_frame_number;
+	_UpdateHotReload();
+	_RunDeferredDestroys( false );
+
+	// erase in place, no temporary list needed every frame
+	for( auto it = _windows.begin(); it != _windows.end(); ) {
+		auto w = *it;
 		w->Update();
 		if( w->_window_should_close ) {
-			windows_to_destroy.push_back( w );
+			delete w;
+			it = _windows.erase( it );
+		} else {
+			++it;
 		}
 	}
-	for( auto w : windows_to_destroy ) {
-		delete w;
-		_windows.remove( w );
-	}
 	if( _windows.size() == 0 ) {
 		return false;
 	}
 	return true;
 }
 
+void Renderer::DeferDestroy( std::function<void()> destroy )
+{
+	_deferred_destroys.push_back( DeferredDestroy { _frame_number, std::move( destroy ) } );
+}
+
 const std::vector<std::string> & Renderer::GetPipelineNames()
 {
 	return _pipeline_names;
 }
 
+const std::vector<std::string> & Renderer::GetLazyPipelineNames()
+{
+	return _lazy_pipeline_names;
+}
+
 const std::list<Scene*> * Renderer::GetSceneList()
 {
 	return &_scenes;
@@ -88,14 +172,174 @@ VkPhysicalDevice Renderer::GetVulkanPhysicalDevice()
 	return _gpu;
 }
 
+HostAllocator * Renderer::GetHostAllocator()
+{
+	return &_host_allocator;
+}
+
+const VkAllocationCallbacks * Renderer::GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY category ) const
+{
+	return _host_allocator.GetCallbacks( category );
+}
+
+const VkPhysicalDeviceProperties & Renderer::GetVulkanPhysicalDeviceProperties() const
+{
+	return _gpu_properties;
+}
+
 const VkPhysicalDeviceMemoryProperties & Renderer::GetVulkanPhysicalDeviceMemoryProperties() const
 {
 	return _gpu_memory_properties;
 }
 
-VkQueue Renderer::GetVulkanQueue()
+VkQueue Renderer::GetVulkanQueue( QUEUE_TYPE type )
+{
+	return _queues[ type ];
+}
+
+uint32_t Renderer::GetVulkanQueueFamilyIndex( QUEUE_TYPE type )
+{
+	return _queue_family_indices[ type ];
+}
+
+bool Renderer::IsDedicatedQueue( QUEUE_TYPE type ) const
 {
-	return _queue;
+	return QUEUE_TYPE_GRAPHICS == type || _queue_family_indices[ type ] != _queue_family_indices[ QUEUE_TYPE_GRAPHICS ];
+}
+
+void Renderer::Submit( QUEUE_TYPE type, const VkSubmitInfo & submit_info, VkFence fence )
+{
+	std::lock_guard<std::mutex> lock( _GetQueueMutex( type ) );
+	ErrCheck( vkQueueSubmit( _queues[ type ], 1, &submit_info, fence ) );
+}
+
+VkResult Renderer::Present( const VkPresentInfoKHR & present_info )
+{
+	std::lock_guard<std::mutex> lock( _GetQueueMutex( QUEUE_TYPE_GRAPHICS ) );
+	return vkQueuePresentKHR( _queues[ QUEUE_TYPE_GRAPHICS ], &present_info );
+}
+
+void Renderer::WaitQueueIdle( QUEUE_TYPE type )
+{
+	std::lock_guard<std::mutex> lock( _GetQueueMutex( type ) );
+	vkQueueWaitIdle( _queues[ type ] );
+}
+
+VkSemaphore Renderer::AllocateSemaphore()
+{
+	{
+		std::lock_guard<std::mutex> lock( _semaphore_mutex );
+		if( _free_semaphores.size() ) {
+			auto semaphore = _free_semaphores.back();
+			_free_semaphores.pop_back();
+			return semaphore;
+		}
+	}
+	VkSemaphoreCreateInfo create_info {};
+	create_info.sType		= VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VkSemaphore semaphore	= VK_NULL_HANDLE;
+	ErrCheck( vkCreateSemaphore( _device, &create_info, _allocation_callbacks, &semaphore ) );
+	return semaphore;
+}
+
+void Renderer::FreeSemaphore( VkSemaphore semaphore )
+{
+	std::lock_guard<std::mutex> lock( _semaphore_mutex );
+	_free_semaphores.push_back( semaphore );
+}
+
+void Renderer::CmdReleaseQueueOwnership( VkCommandBuffer command_buffer, const BufferOwnershipTransfer & transfer )
+{
+	uint32_t src_family = _queue_family_indices[ transfer.src_queue ];
+	uint32_t dst_family = _queue_family_indices[ transfer.dst_queue ];
+
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask			= transfer.src_access;
+	barrier.buffer					= transfer.buffer;
+	barrier.offset					= transfer.offset;
+	barrier.size					= transfer.size;
+	if( src_family == dst_family ) {
+		// same queue, an ordinary barrier is enough
+		barrier.dstAccessMask			= transfer.dst_access;
+		barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier( command_buffer, transfer.src_stage, transfer.dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+	} else {
+		// dst access is ignored on release, visibility comes from the acquire
+		barrier.dstAccessMask			= 0;
+		barrier.srcQueueFamilyIndex		= src_family;
+		barrier.dstQueueFamilyIndex		= dst_family;
+		vkCmdPipelineBarrier( command_buffer, transfer.src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+	}
+}
+
+void Renderer::CmdReleaseQueueOwnership( VkCommandBuffer command_buffer, const ImageOwnershipTransfer & transfer )
+{
+	uint32_t src_family = _queue_family_indices[ transfer.src_queue ];
+	uint32_t dst_family = _queue_family_indices[ transfer.dst_queue ];
+
+	VkImageMemoryBarrier barrier {};
+	barrier.sType					= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask			= transfer.src_access;
+	barrier.oldLayout				= transfer.old_layout;
+	barrier.newLayout				= transfer.new_layout;
+	barrier.image					= transfer.image;
+	barrier.subresourceRange		= transfer.subresource_range;
+	if( src_family == dst_family ) {
+		barrier.dstAccessMask			= transfer.dst_access;
+		barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier( command_buffer, transfer.src_stage, transfer.dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+	} else {
+		barrier.dstAccessMask			= 0;
+		barrier.srcQueueFamilyIndex		= src_family;
+		barrier.dstQueueFamilyIndex		= dst_family;
+		vkCmdPipelineBarrier( command_buffer, transfer.src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+	}
+}
+
+void Renderer::CmdAcquireQueueOwnership( VkCommandBuffer command_buffer, const BufferOwnershipTransfer & transfer )
+{
+	uint32_t src_family = _queue_family_indices[ transfer.src_queue ];
+	uint32_t dst_family = _queue_family_indices[ transfer.dst_queue ];
+	if( src_family == dst_family ) {
+		// release already made the range visible
+		return;
+	}
+
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask			= 0;
+	barrier.dstAccessMask			= transfer.dst_access;
+	barrier.srcQueueFamilyIndex		= src_family;
+	barrier.dstQueueFamilyIndex		= dst_family;
+	barrier.buffer					= transfer.buffer;
+	barrier.offset					= transfer.offset;
+	barrier.size					= transfer.size;
+	vkCmdPipelineBarrier( command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, transfer.dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+}
+
+void Renderer::CmdAcquireQueueOwnership( VkCommandBuffer command_buffer, const ImageOwnershipTransfer & transfer )
+{
+	uint32_t src_family = _queue_family_indices[ transfer.src_queue ];
+	uint32_t dst_family = _queue_family_indices[ transfer.dst_queue ];
+	if( src_family == dst_family ) {
+		return;
+	}
+
+	// layouts must match the release barrier exactly
+	VkImageMemoryBarrier barrier {};
+	barrier.sType					= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask			= 0;
+	barrier.dstAccessMask			= transfer.dst_access;
+	barrier.oldLayout				= transfer.old_layout;
+	barrier.newLayout				= transfer.new_layout;
+	barrier.srcQueueFamilyIndex		= src_family;
+	barrier.dstQueueFamilyIndex		= dst_family;
+	barrier.image					= transfer.image;
+	barrier.subresourceRange		= transfer.subresource_range;
+	vkCmdPipelineBarrier( command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, transfer.dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier );
 }
 
 VkDevice Renderer::GetVulkanDevice()
@@ -103,9 +347,49 @@ VkDevice Renderer::GetVulkanDevice()
 	return _device;
 }
 
+VkPipelineCache Renderer::GetVulkanPipelineCache()
+{
+	return _pipeline_cache;
+}
+
+const AssetArchive * Renderer::GetAssetArchive() const
+{
+	return _asset_archive;
+}
+
+JobSystem * Renderer::GetJobSystem()
+{
+	return _job_system;
+}
+
+PipelineLayoutCache * Renderer::GetPipelineLayoutCache()
+{
+	return _pipeline_layout_cache;
+}
+
+ShaderModuleCache * Renderer::GetShaderModuleCache()
+{
+	return _shader_module_cache;
+}
+
+VkDescriptorSetLayout Renderer::GetCameraDescriptorSetLayout()
+{
+	return _camera_descriptor_set_layout;
+}
+
 uint32_t Renderer::GetVulkanGraphicsQueueFamilyIndex()
 {
-	return _render_queue_family_index;
+	return _queue_family_indices[ QUEUE_TYPE_GRAPHICS ];
+}
+
+const VkPhysicalDeviceFeatures & Renderer::GetVulkanEnabledFeatures() const
+{
+	return _enabled_features;
+}
+
+PFN_vkCmdDrawIndexedIndirectCountKHR Renderer::GetVulkanCmdDrawIndexedIndirectCount() const
+{
+	return _vkCmdDrawIndexedIndirectCount;
 }
 
 
@@ -125,6 +409,88 @@ void Renderer::_DestroyWindows()
 	_windows.clear();
 }
 
+void Renderer::_DestroyComputePipelines()
+{
+	for( auto pipeline : _compute_pipelines ) {
+		delete pipeline;
+	}
+	_compute_pipelines.clear();
+}
+
+void Renderer::_DestroyPipelineLibrary()
+{
+	for( auto &bucket : _pipeline_library ) {
+		for( auto p : bucket.second ) {
+			delete p;
+		}
+	}
+	_pipeline_library.clear();
+}
+
+void Renderer::_UpdateHotReload()
+{
+#if BUILD_ENABLE_SHADER_HOT_RELOAD
+	if( !_pipeline_watcher ) return;
+
+	// changes are "<pipeline name>/<stage>.spv"
+	auto now = std::chrono::steady_clock::now();
+	_changed_pipeline_files.clear();
+	_pipeline_watcher->Poll( _changed_pipeline_files );
+	for( auto &f : _changed_pipeline_files ) {
+		auto slash = f.find( '/' );
+		if( slash == std::string::npos || f.size() < 4 || f.compare( f.size() - 4, 4, ".spv" ) != 0 ) continue;
+		_pending_pipeline_reloads[ f.substr( 0, slash ) ] = now;
+	}
+
+	for( auto it = _pending_pipeline_reloads.begin(); it != _pending_pipeline_reloads.end(); ) {
+		if( now - it->second < PIPELINE_RELOAD_SETTLE_TIME ) {
+			++it;
+			continue;
+		}
+		for( auto &bucket : _pipeline_library ) {
+			for( auto p : bucket.second ) {
+				if( p->GetName() == it->first ) {
+					p->Reload();
+				}
+			}
+		}
+		it = _pending_pipeline_reloads.erase( it );
+	}
+
+	// swap between frames, users re-record when they see the new generation
+	for( auto &bucket : _pipeline_library ) {
+		for( auto p : bucket.second ) {
+			p->_ApplyReload();
+		}
+	}
+#endif
+}
+
+void Renderer::_RunDeferredDestroys( bool all )
+{
+	uint64_t frames_in_flight = _GetMaxFramesInFlight();
+	size_t kept = 0;
+	// destroys may defer more, those are appended and looked at in the same pass
+	for( size_t i=0; i < _deferred_destroys.size(); ++i ) {
+		if( all || _frame_number > _deferred_destroys[ i ].frame + frames_in_flight ) {
+			auto destroy = std::move( _deferred_destroys[ i ].destroy );
+			destroy();
+		} else {
+			_deferred_destroys[ kept++ ] = std::move( _deferred_destroys[ i ] );
+		}
+	}
+	_deferred_destroys.resize( kept );
+}
+
+uint32_t Renderer::_GetMaxFramesInFlight()
+{
+	uint32_t count = 0;
+	for( auto w : _windows ) {
+		count = std::max( count, w->GetFrameArena()->GetFrameCount() );
+	}
+	return count;
+}
+
 
 void Renderer::_SetupLayersAndExtensions()
 {
@@ -151,73 +517,317 @@ void Renderer::_CreateInstance()
 	create_info.ppEnabledExtensionNames		= _instance_extensions.data();
 	create_info.pNext						= _debug_report_callback_create_info;
 
-	ErrCheck( vkCreateInstance( &create_info, nullptr, &_instance ) );
+	ErrCheck( vkCreateInstance( &create_info, _allocation_callbacks, &_instance ) );
 }
 
 
 void Renderer::_DestroyInstance()
 {
-	vkDestroyInstance( _instance, nullptr );
+	vkDestroyInstance( _instance, _allocation_callbacks );
 	_instance = nullptr;
 }
 
 
 void Renderer::_CreateDevice()
 {
-	{
-		uint32_t gpu_count = 0;
-		vkEnumeratePhysicalDevices( _instance, &gpu_count, nullptr );
-		std::vector<VkPhysicalDevice> gpu_list( gpu_count );
-		vkEnumeratePhysicalDevices( _instance, &gpu_count, gpu_list.data() );
-		_gpu = gpu_list[ 0 ];
+	_SelectPhysicalDevice();
+	_FindQueueFamilies();
+
+	// one queue per distinct family, roles without their own family share the graphics queue
+	float queue_priorities[] { 1.0f };
+	VkDeviceQueueCreateInfo queue_create_infos[ QUEUE_TYPE_COUNT ] {};
+	uint32_t queue_create_info_count		= 0;
+	for( uint32_t t=0; t < QUEUE_TYPE_COUNT; ++t ) {
+		if( _queue_mutex_indices[ t ] != t ) continue;
+		auto &info = queue_create_infos[ queue_create_info_count++ ];
+		info.sType							= VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		info.pQueuePriorities				= queue_priorities;
+		info.queueCount						= 1;
+		info.queueFamilyIndex				= _queue_family_indices[ t ];
 	}
+
+	// optional features and extensions used by the indirect draw path, we fall back if these are not available
+	VkPhysicalDeviceFeatures supported_features {};
+	vkGetPhysicalDeviceFeatures( _gpu, &supported_features );
+
+	bool draw_indirect_count_supported		= false;
 	{
-		uint32_t family_count = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties( _gpu, &family_count, nullptr );
-		std::vector<VkQueueFamilyProperties> family_list( family_count );
-		vkGetPhysicalDeviceQueueFamilyProperties( _gpu, &family_count, family_list.data() );
-		bool found = false;
-		for( uint32_t i=0; i < family_count; ++i ) {
-			if( family_list[ i ].queueFlags & VK_QUEUE_GRAPHICS_BIT ) {
-				found = true;
-				_render_queue_family_index = i;
+		uint32_t extension_count = 0;
+		vkEnumerateDeviceExtensionProperties( _gpu, nullptr, &extension_count, nullptr );
+		std::vector<VkExtensionProperties> extension_list( extension_count );
+		vkEnumerateDeviceExtensionProperties( _gpu, nullptr, &extension_count, extension_list.data() );
+		for( auto &e : extension_list ) {
+			if( std::strcmp( e.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME ) == 0 ) {
+				draw_indirect_count_supported	= true;
+				_device_extensions.push_back( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
 				break;
 			}
 		}
 	}
-	float queue_priorities[] { 1.0f };
-	VkDeviceQueueCreateInfo queue_create_info {};
-	queue_create_info.sType					= VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queue_create_info.pQueuePriorities		= queue_priorities;
-	queue_create_info.queueCount			= 1;
-	queue_create_info.queueFamilyIndex		= _render_queue_family_index;
 
 	VkPhysicalDeviceFeatures features {};
 	features.shaderClipDistance				= VK_TRUE;
+	features.multiDrawIndirect				= supported_features.multiDrawIndirect;
 
 	VkDeviceCreateInfo create_info {};
 	create_info.sType						= VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	create_info.queueCreateInfoCount		= 1;
-	create_info.pQueueCreateInfos			= &queue_create_info;
+	create_info.queueCreateInfoCount		= queue_create_info_count;
+	create_info.pQueueCreateInfos			= queue_create_infos;
 	create_info.enabledLayerCount			= _device_layers.size();
 	create_info.ppEnabledLayerNames			= _device_layers.data();
 	create_info.enabledExtensionCount		= _device_extensions.size();
 	create_info.ppEnabledExtensionNames		= _device_extensions.data();
 	create_info.pEnabledFeatures			= &features;
 
-	ErrCheck( vkCreateDevice( _gpu, &create_info, nullptr, &_device ) );
+	ErrCheck( vkCreateDevice( _gpu, &create_info, _allocation_callbacks, &_device ) );
 
-	vkGetDeviceQueue( _device, _render_queue_family_index, 0, &_queue );
+	for( uint32_t t=0; t < QUEUE_TYPE_COUNT; ++t ) {
+		vkGetDeviceQueue( _device, _queue_family_indices[ t ], 0, &_queues[ t ] );
+	}
+	_queue									= _queues[ QUEUE_TYPE_GRAPHICS ];
+	vkGetPhysicalDeviceProperties( _gpu, &_gpu_properties );
 	vkGetPhysicalDeviceMemoryProperties( _gpu, &_gpu_memory_properties );
+	_enabled_features						= features;
+
+	if( draw_indirect_count_supported ) {
+		_vkCmdDrawIndexedIndirectCount		= (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr( _device, "vkCmdDrawIndexedIndirectCountKHR" );
+	}
 }
 
 
+void Renderer::_SelectPhysicalDevice()
+{
+	uint32_t gpu_count = 0;
+	vkEnumeratePhysicalDevices( _instance, &gpu_count, nullptr );
+	std::vector<VkPhysicalDevice> gpu_list( gpu_count );
+	vkEnumeratePhysicalDevices( _instance, &gpu_count, gpu_list.data() );
+
+	std::string preferred	= _preferred_device;
+	const char * env		= std::getenv( BUILD_DEVICE_ENVIRONMENT_VARIABLE );
+	if( env && env[ 0 ] ) {
+		preferred			= env;
+	}
+	auto lower = []( std::string s ) {
+		std::transform( s.begin(), s.end(), s.begin(), []( char c ) { return char( std::tolower( (unsigned char)c ) ); } );
+		return s;
+	};
+	bool by_index			= preferred.size() && preferred.find_first_not_of( "0123456789" ) == std::string::npos;
+
+	int64_t best_score		= -1;
+	for( uint32_t i=0; i < gpu_count; ++i ) {
+		VkPhysicalDeviceProperties properties {};
+		vkGetPhysicalDeviceProperties( gpu_list[ i ], &properties );
+		int64_t score		= _ScorePhysicalDevice( gpu_list[ i ] );
+		if( preferred.size() ) {
+			// explicit choice is all or nothing so benchmarks never silently run elsewhere
+			bool match		= by_index ? std::strtoul( preferred.c_str(), nullptr, 10 ) == i
+				: lower( properties.deviceName ).find( lower( preferred ) ) != std::string::npos;
+			if( !match ) continue;
+		}
+		if( score > best_score ) {
+			best_score		= score;
+			_gpu			= gpu_list[ i ];
+		}
+	}
+
+	if( best_score < 0 ) {
+		std::cout << "Vulkan ERROR: No suitable physical device";
+		if( preferred.size() ) std::cout << " matching \"" << preferred << "\"";
+		std::cout << ", available devices:\n";
+		for( uint32_t i=0; i < gpu_count; ++i ) {
+			VkPhysicalDeviceProperties properties {};
+			vkGetPhysicalDeviceProperties( gpu_list[ i ], &properties );
+			std::cout << "  " << i << ": " << properties.deviceName << ", score " << _ScorePhysicalDevice( gpu_list[ i ] ) << "\n";
+		}
+		assert( 0 && "Vulkan ERROR: No suitable physical device." );
+		std::exit( -1 );
+	}
+
+	VkPhysicalDeviceProperties properties {};
+	vkGetPhysicalDeviceProperties( _gpu, &properties );
+	std::cout << "Using physical device: " << properties.deviceName << "\n";
+}
+
+int64_t Renderer::_ScorePhysicalDevice( VkPhysicalDevice gpu )
+{
+	// required: a graphics queue that can present and every device extension we enable unconditionally
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties( gpu, &family_count, nullptr );
+	std::vector<VkQueueFamilyProperties> family_list( family_count );
+	vkGetPhysicalDeviceQueueFamilyProperties( gpu, &family_count, family_list.data() );
+	uint32_t graphics_family	= UINT32_MAX;
+	bool has_async_compute		= false;
+	bool has_transfer			= false;
+	for( uint32_t i=0; i < family_count; ++i ) {
+		auto &f = family_list[ i ];
+		if( !f.queueCount ) continue;
+		if( f.queueFlags & VK_QUEUE_GRAPHICS_BIT ) {
+			// same family _FindQueueFamilies picks for rendering
+			if( UINT32_MAX == graphics_family ) graphics_family = i;
+		} else if( f.queueFlags & VK_QUEUE_COMPUTE_BIT ) {
+			has_async_compute	= true;
+		} else if( f.queueFlags & VK_QUEUE_TRANSFER_BIT ) {
+			has_transfer		= true;
+		}
+	}
+	if( UINT32_MAX == graphics_family ) return -1;
+	if( !Window::IsPresentationSupported( gpu, graphics_family ) ) return -1;
+
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties( gpu, nullptr, &extension_count, nullptr );
+	std::vector<VkExtensionProperties> extension_list( extension_count );
+	vkEnumerateDeviceExtensionProperties( gpu, nullptr, &extension_count, extension_list.data() );
+	for( auto required : _device_extensions ) {
+		auto it = std::find_if( extension_list.begin(), extension_list.end(), [ required ]( const VkExtensionProperties & e ) {
+			return std::strcmp( e.extensionName, required ) == 0;
+		} );
+		if( it == extension_list.end() ) return -1;
+	}
+
+	// compared in order: device type, queue capabilities, device local memory. Each term gets its own
+	// decimal digits so nothing after it can outweigh it, eg. a discrete GPU with both dedicated
+	// queue families and 8 GiB scores 4|3|0008192.
+	constexpr int64_t TYPE_WEIGHT			= 100000000;
+	constexpr int64_t CAPABILITY_WEIGHT		= 10000000;
+	constexpr int64_t HEAP_MIB_LIMIT		= CAPABILITY_WEIGHT - 1;
+
+	VkPhysicalDeviceProperties properties {};
+	vkGetPhysicalDeviceProperties( gpu, &properties );
+	int64_t type_rank			= 0;
+	switch( properties.deviceType ) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		type_rank				= 4;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		type_rank				= 3;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		type_rank				= 2;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		type_rank				= 1;
+		break;
+	default:
+		break;
+	}
+
+	int64_t capabilities		= 0;
+	if( has_async_compute )	capabilities	+= 2;
+	if( has_transfer )		capabilities	+= 1;
+
+	// largest device local heap in MiB
+	VkPhysicalDeviceMemoryProperties memory_properties {};
+	vkGetPhysicalDeviceMemoryProperties( gpu, &memory_properties );
+	VkDeviceSize device_local_size = 0;
+	for( uint32_t i=0; i < memory_properties.memoryHeapCount; ++i ) {
+		if( memory_properties.memoryHeaps[ i ].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ) {
+			device_local_size	= std::max( device_local_size, memory_properties.memoryHeaps[ i ].size );
+		}
+	}
+	int64_t heap_mib			= int64_t( std::min<VkDeviceSize>( device_local_size >> 20, HEAP_MIB_LIMIT ) );
+
+	return type_rank * TYPE_WEIGHT + capabilities * CAPABILITY_WEIGHT + heap_mib;
+}
+
+void Renderer::_FindQueueFamilies()
+{
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties( _gpu, &family_count, nullptr );
+	std::vector<VkQueueFamilyProperties> family_list( family_count );
+	vkGetPhysicalDeviceQueueFamilyProperties( _gpu, &family_count, family_list.data() );
+
+	// returns the first family that has all the required flags and none of the excluded ones
+	auto find = [ & ]( VkQueueFlags required, VkQueueFlags excluded ) -> uint32_t {
+		for( uint32_t i=0; i < family_count; ++i ) {
+			auto flags = family_list[ i ].queueFlags;
+			if( family_list[ i ].queueCount && ( flags & required ) == required && !( flags & excluded ) ) {
+				return i;
+			}
+		}
+		return UINT32_MAX;
+	};
+
+	uint32_t graphics		= find( VK_QUEUE_GRAPHICS_BIT, 0 );
+	if( UINT32_MAX == graphics ) {
+		assert( 0 && "Vulkan ERROR: No graphics queue family." );
+		std::exit( -1 );
+	}
+	uint32_t compute		= graphics;
+	uint32_t transfer		= graphics;
+#if BUILD_ENABLE_DEDICATED_QUEUES
+	// async compute family
+	uint32_t found			= find( VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT );
+	if( UINT32_MAX != found ) compute = found;
+
+	// DMA family, then anything outside graphics. Graphics and compute families support
+	// transfers without advertising VK_QUEUE_TRANSFER_BIT so only the bit-less graphics
+	// fallback relies on that.
+	found					= find( VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT );
+	if( UINT32_MAX == found ) {
+		found				= find( VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT );
+	}
+	if( UINT32_MAX != found ) transfer = found;
+#endif
+
+	_queue_family_indices[ QUEUE_TYPE_GRAPHICS ]	= graphics;
+	_queue_family_indices[ QUEUE_TYPE_COMPUTE ]		= compute;
+	_queue_family_indices[ QUEUE_TYPE_TRANSFER ]	= transfer;
+	_render_queue_family_index						= graphics;
+
+	for( uint32_t t=0; t < QUEUE_TYPE_COUNT; ++t ) {
+		_queue_mutex_indices[ t ]	= t;
+		for( uint32_t o=0; o < t; ++o ) {
+			if( _queue_family_indices[ o ] == _queue_family_indices[ t ] ) {
+				_queue_mutex_indices[ t ]	= o;
+				break;
+			}
+		}
+	}
+}
+
+std::mutex & Renderer::_GetQueueMutex( QUEUE_TYPE type )
+{
+	return _queue_mutexes[ _queue_mutex_indices[ type ] ];
+}
+
 void Renderer::_DestroyDevice()
 {
-	vkDestroyDevice( _device, nullptr );
+	for( auto s : _free_semaphores ) {
+		vkDestroySemaphore( _device, s, _allocation_callbacks );
+	}
+	_free_semaphores.clear();
+	vkDestroyDevice( _device, _allocation_callbacks );
 	_device = nullptr;
 }
 
+void Renderer::_CreateDescriptorSetLayouts()
+{
+	// camera set, binding 0 is UB_Camera. Comes from the layout cache so pipelines whose shaders
+	// reflect the same set 0 share this exact layout.
+	std::vector<VkDescriptorSetLayoutBinding> descriptor_set_layout_bindings( 1 );
+	descriptor_set_layout_bindings[ 0 ].binding					= 0;
+	descriptor_set_layout_bindings[ 0 ].descriptorType			= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptor_set_layout_bindings[ 0 ].descriptorCount			= 1;
+	descriptor_set_layout_bindings[ 0 ].stageFlags				= VK_SHADER_STAGE_VERTEX_BIT;
+	descriptor_set_layout_bindings[ 0 ].pImmutableSamplers		= nullptr;
+	_camera_descriptor_set_layout	= _pipeline_layout_cache->GetDescriptorSetLayout( descriptor_set_layout_bindings );
+}
+
+void Renderer::_CreatePipelineCache()
+{
+	VkPipelineCacheCreateInfo create_info {};
+	create_info.sType				= VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	create_info.initialDataSize		= 0;
+	create_info.pInitialData		= nullptr;
+	ErrCheck( vkCreatePipelineCache( _device, &create_info, _allocation_callbacks, &_pipeline_cache ) );
+}
+
+void Renderer::_DestroyPipelineCache()
+{
+	vkDestroyPipelineCache( _device, _pipeline_cache, _allocation_callbacks );
+	_pipeline_cache = VK_NULL_HANDLE;
+}
+
 
 #if BUILD_ENABLE_VULKAN_ERROR_REPORTING
 VKAPI_ATTR VkBool32 VKAPI_CALL
@@ -304,7 +914,7 @@ void Renderer::_CreateDebug()
 		std::exit( -1 );
 	}
 
-	ErrCheck( fvkCreateDebugReportCallbackEXT( _instance, _debug_report_callback_create_info, nullptr, &_debug_report ) );
+	ErrCheck( fvkCreateDebugReportCallbackEXT( _instance, _debug_report_callback_create_info, _allocation_callbacks, &_debug_report ) );
 #endif
 }
 
@@ -312,7 +922,7 @@ void Renderer::_CreateDebug()
 void Renderer::_DestroyDebug()
 {
 #if BUILD_ENABLE_VULKAN_ERROR_REPORTING
-	fvkDestroyDebugReportCallbackEXT( _instance, _debug_report, nullptr );
+	fvkDestroyDebugReportCallbackEXT( _instance, _debug_report, _allocation_callbacks );
 	delete _debug_report_callback_create_info;
 	_debug_report							= VK_NULL_HANDLE;
 	_debug_report_callback_create_info		= nullptr;
@@ -2,13 +2,67 @@
 
 #include "BUILD_OPTIONS.h"
 #include "Shared.hpp"
+#include "HostAllocator.h"
+#include "PipelineStateKey.h"
 
 #include <vector>
 #include <list>
 #include <string>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <mutex>
 
 class Window;
 class Scene;
+class ComputePipeline;
+class Pipeline;
+class ShaderModuleCache;
+class AssetArchive;
+class PipelineLayoutCache;
+class FileWatcher;
+class JobSystem;
+
+// Queue roles. Devices without a dedicated family for a role share the graphics
+// queue, see Renderer::IsDedicatedQueue.
+enum QUEUE_TYPE : uint32_t
+{
+	QUEUE_TYPE_GRAPHICS		= 0,
+	QUEUE_TYPE_COMPUTE,
+	QUEUE_TYPE_TRANSFER,
+	QUEUE_TYPE_COUNT
+};
+
+// Hands a buffer range from one queue to another. The same description is recorded twice:
+// CmdReleaseQueueOwnership on the source queue and CmdAcquireQueueOwnership on the
+// destination queue, with a semaphore between the two submits.
+struct BufferOwnershipTransfer
+{
+	VkBuffer					buffer				= VK_NULL_HANDLE;
+	VkDeviceSize				offset				= 0;
+	VkDeviceSize				size				= VK_WHOLE_SIZE;
+	QUEUE_TYPE					src_queue			= QUEUE_TYPE_GRAPHICS;
+	VkAccessFlags				src_access			= 0;
+	VkPipelineStageFlags		src_stage			= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	QUEUE_TYPE					dst_queue			= QUEUE_TYPE_GRAPHICS;
+	VkAccessFlags				dst_access			= 0;
+	VkPipelineStageFlags		dst_stage			= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+};
+
+// Same for images, the layout transition happens as part of the transfer.
+struct ImageOwnershipTransfer
+{
+	VkImage						image				= VK_NULL_HANDLE;
+	VkImageSubresourceRange		subresource_range	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	VkImageLayout				old_layout			= VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout				new_layout			= VK_IMAGE_LAYOUT_UNDEFINED;
+	QUEUE_TYPE					src_queue			= QUEUE_TYPE_GRAPHICS;
+	VkAccessFlags				src_access			= 0;
+	VkPipelineStageFlags		src_stage			= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	QUEUE_TYPE					dst_queue			= QUEUE_TYPE_GRAPHICS;
+	VkAccessFlags				dst_access			= 0;
+	VkPipelineStageFlags		dst_stage			= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+};
 
 // Render engine. Everything graphics related belongs to this class.
 // This is the primary thing to include in the application.
@@ -19,51 +73,162 @@ class Renderer
 	friend class Window;
 
 public:
-	Renderer( const std::vector<std::string> & used_pipeline_names );
+	// Used pipelines are compiled in the background as soon as a window opens,
+	// lazy pipelines only when they are first used.
+	// Physical device is picked by score unless preferred_device or the BUILD_DEVICE_ENVIRONMENT_VARIABLE
+	// environment variable names one, as an index or part of the device name. The environment wins.
+	Renderer( const std::vector<std::string> & used_pipeline_names, const std::vector<std::string> & lazy_pipeline_names = std::vector<std::string>(), const std::string & preferred_device = std::string() );
 	~Renderer();
 
 	Window									*	OpenWindow( VkExtent2D dimensions, std::string window_name = std::string() );
 
 	Scene									*	CreateScene();
 
+	// Compute pipelines are shared by name and specialization, first call with a combination creates the pipeline.
+	ComputePipeline							*	GetComputePipeline( const std::string & name, const PipelineSpecialization & specialization = PipelineSpecialization() );
+
+	// Pipeline library. Identical keys return the same pipeline, which is shared by every window with
+	// a compatible render pass. New pipelines start compiling right away unless build_now is false,
+	// then they compile on first use.
+	Pipeline								*	GetPipeline( const PipelineStateKey & key, bool build_now = true );
+
+	// Updates windows and applies finished pipeline reloads, call once per frame before rendering.
 	bool										Run();
 
+	// Calls destroy once every frame in flight at the time of the call has finished on the GPU.
+	// For objects that recorded command buffers may still use, no queue wait needed.
+	void										DeferDestroy( std::function<void()> destroy );
+
 	const std::vector<std::string>			&	GetPipelineNames();
+	const std::vector<std::string>			&	GetLazyPipelineNames();
 
 	const std::list<Scene*>					*	GetSceneList();
 	const std::list<Window*>				*	GetWindowList();
 
+	// Statistics of Vulkan host memory use, see BUILD_ENABLE_VULKAN_HOST_ALLOCATOR.
+	HostAllocator							*	GetHostAllocator();
+	// Pass to every vkCreate*, vkDestroy*, vkAllocate* and vkFree* call made on behalf of the category.
+	const VkAllocationCallbacks				*	GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY category ) const;
+
 	VkPhysicalDevice							GetVulkanPhysicalDevice();
+	const VkPhysicalDeviceProperties		&	GetVulkanPhysicalDeviceProperties() const;
 	const VkPhysicalDeviceMemoryProperties	&	GetVulkanPhysicalDeviceMemoryProperties() const;
-	VkQueue										GetVulkanQueue();
+	// Queues are externally synchronized, use Submit, Present and WaitQueueIdle
+	// instead of calling Vulkan directly when other threads may use the same queue.
+	VkQueue										GetVulkanQueue( QUEUE_TYPE type = QUEUE_TYPE_GRAPHICS );
+	uint32_t									GetVulkanQueueFamilyIndex( QUEUE_TYPE type );
+	// False if the role falls back to the graphics queue.
+	bool										IsDedicatedQueue( QUEUE_TYPE type ) const;
+
+	// Thread safe, roles sharing a queue also share the lock.
+	void										Submit( QUEUE_TYPE type, const VkSubmitInfo & submit_info, VkFence fence = VK_NULL_HANDLE );
+	VkResult									Present( const VkPresentInfoKHR & present_info );
+	void										WaitQueueIdle( QUEUE_TYPE type );
+
+	// Binary semaphores for cross queue submits, recycled. Free only after the wait completed.
+	VkSemaphore									AllocateSemaphore();
+	void										FreeSemaphore( VkSemaphore semaphore );
+
+	// Records the release half on the source queue. Between queues of the same family this is a
+	// plain barrier and the acquire half records nothing.
+	void										CmdReleaseQueueOwnership( VkCommandBuffer command_buffer, const BufferOwnershipTransfer & transfer );
+	void										CmdReleaseQueueOwnership( VkCommandBuffer command_buffer, const ImageOwnershipTransfer & transfer );
+	// Records the acquire half on the destination queue, submit after waiting on the release submit.
+	void										CmdAcquireQueueOwnership( VkCommandBuffer command_buffer, const BufferOwnershipTransfer & transfer );
+	void										CmdAcquireQueueOwnership( VkCommandBuffer command_buffer, const ImageOwnershipTransfer & transfer );
+
 	VkDevice									GetVulkanDevice();
+	// Shared by all pipelines, safe to use from multiple threads.
+	VkPipelineCache								GetVulkanPipelineCache();
+	// Mapped at construction from BUILD_ASSET_ARCHIVE_PATH, never nullptr but may be empty.
+	const AssetArchive						*	GetAssetArchive() const;
+	// Created on the thread that created the Renderer, used by Scene::Update.
+	JobSystem								*	GetJobSystem();
+	// Descriptor set and pipeline layouts shared by all pipelines.
+	PipelineLayoutCache						*	GetPipelineLayoutCache();
+	// SPIR-V modules shared by all pipelines.
+	ShaderModuleCache						*	GetShaderModuleCache();
+	// Layout of descriptor set 0 in every graphics pipeline.
+	VkDescriptorSetLayout						GetCameraDescriptorSetLayout();
 	uint32_t									GetVulkanGraphicsQueueFamilyIndex();
+	const VkPhysicalDeviceFeatures			&	GetVulkanEnabledFeatures() const;
+
+	// Returns nullptr if the device doesn't support count based indirect draws.
+	PFN_vkCmdDrawIndexedIndirectCountKHR		GetVulkanCmdDrawIndexedIndirectCount() const;
 
 private:
 	void _DestroyScenes();
 	void _DestroyWindows();
+	void _DestroyComputePipelines();
+	void _DestroyPipelineLibrary();
+
+	void _UpdateHotReload();
+	void _RunDeferredDestroys( bool all );
+	uint32_t _GetMaxFramesInFlight();
 
 	void _SetupLayersAndExtensions();
 
 	void _CreateInstance();
 	void _DestroyInstance();
 
+	void _SelectPhysicalDevice();
+	// Negative if the device can't run the renderer or present to a window. Otherwise higher is better,
+	// by device type first, then dedicated queue families, then device local memory.
+	int64_t _ScorePhysicalDevice( VkPhysicalDevice gpu );
+	void _FindQueueFamilies();
+	std::mutex & _GetQueueMutex( QUEUE_TYPE type );
+
 	void _CreateDevice();
 	void _DestroyDevice();
 
+	void _CreateDescriptorSetLayouts();
+
+	void _CreatePipelineCache();
+	void _DestroyPipelineCache();
+
 	void _SetupDebug();
 	void _CreateDebug();
 	void _DestroyDebug();
 
+	HostAllocator							_host_allocator;
+	const VkAllocationCallbacks			*	_allocation_callbacks			= nullptr;
+
 	std::list<Window*>						_windows;
 	std::list<Scene*>						_scenes;
+	std::list<ComputePipeline*>				_compute_pipelines;
+	std::unordered_map<uint64_t, std::vector<Pipeline*>>	_pipeline_library;		// key hash to pipelines
 
 	VkInstance								_instance						= VK_NULL_HANDLE;
 	VkPhysicalDevice						_gpu							= VK_NULL_HANDLE;
 	VkDevice								_device							= VK_NULL_HANDLE;
-	VkQueue									_queue							= VK_NULL_HANDLE;
-
+	VkQueue									_queue							= VK_NULL_HANDLE;		// graphics
+	VkQueue									_queues[ QUEUE_TYPE_COUNT ]		= {};
+	uint32_t								_queue_family_indices[ QUEUE_TYPE_COUNT ]	= {};
+	uint32_t								_queue_mutex_indices[ QUEUE_TYPE_COUNT ]	= {};		// first role using the same queue
+	std::mutex								_queue_mutexes[ QUEUE_TYPE_COUNT ];
+	std::mutex								_semaphore_mutex;
+	std::vector<VkSemaphore>				_free_semaphores;
+	VkPipelineCache							_pipeline_cache					= VK_NULL_HANDLE;
+	ShaderModuleCache					*	_shader_module_cache			= nullptr;
+	AssetArchive						*	_asset_archive					= nullptr;
+	PipelineLayoutCache					*	_pipeline_layout_cache			= nullptr;
+	FileWatcher							*	_pipeline_watcher				= nullptr;
+	JobSystem							*	_job_system						= nullptr;
+
+	struct DeferredDestroy
+	{
+		uint64_t							frame;
+		std::function<void()>				destroy;
+	};
+	uint64_t								_frame_number					= 0;
+	std::vector<DeferredDestroy>			_deferred_destroys;
+	std::vector<std::string>				_changed_pipeline_files;
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point>	_pending_pipeline_reloads;		// pipeline name to last change
+	VkDescriptorSetLayout					_camera_descriptor_set_layout	= VK_NULL_HANDLE;
+
+	VkPhysicalDeviceProperties				_gpu_properties					= {};
 	VkPhysicalDeviceMemoryProperties		_gpu_memory_properties			= {};
+	VkPhysicalDeviceFeatures				_enabled_features				= {};
 	uint32_t								_render_queue_family_index		= 0;
 
 	std::vector<const char*>				_instance_layers;
@@ -71,7 +236,11 @@ private:
 	std::vector<const char*>				_device_layers;
 	std::vector<const char*>				_device_extensions;
 
+	std::string								_preferred_device;
 	std::vector<std::string>				_pipeline_names;
+	std::vector<std::string>				_lazy_pipeline_names;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR	_vkCmdDrawIndexedIndirectCount				= nullptr;
 
 	VkDebugReportCallbackEXT				_debug_report								= VK_NULL_HANDLE;
 	VkDebugReportCallbackCreateInfoEXT	*	_debug_report_callback_create_info			= nullptr;
@@ -9,6 +9,10 @@
 #include "Pipeline.h"
 #include "Window.h"
 #include "Mesh.h"
+#include "Scene.h"
+#include "ComputePipeline.h"
+#include "UniformBuffers.h"
+#include "FrameArena.h"
 
 #include <assert.h>
 #include <cstring>
@@ -22,19 +26,79 @@ SO_DynamicMesh::SO_DynamicMesh( Scene * parent_scene, Renderer * renderer, Mesh
 }
 
 
+// local workgroup size of vertex animation compute shaders
+constexpr uint32_t VERTEX_ANIMATION_WORKGROUP_SIZE = 64;
+
+static VkDeviceSize AlignUp( VkDeviceSize value, VkDeviceSize alignment )
+{
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
 SO_DynamicMesh::~SO_DynamicMesh()
 {
+	// deferred, the object itself is only deleted once its frames are done
+	DisableComputeAnimation();
 	FreeBuffersMemory( _renderer, _buffers );
-	vkDestroyBuffer( _device, _buffers[ 0 ].buffer, nullptr );
-	vkDestroyBuffer( _device, _buffers[ 1 ].buffer, nullptr );
+	vkDestroyBuffer( _device, _buffers[ BUFFER_VERTEX ].buffer, _allocation_callbacks );
+	vkDestroyBuffer( _device, _buffers[ BUFFER_INDEX ].buffer, _allocation_callbacks );
 }
 
 void SO_DynamicMesh::Update()
 {
-	void *data = nullptr;
-	vkMapMemory( _device, _buffers[ 0 ].memory, 0, _buffers[ 0 ].memory_size, 0, &data );
-	memcpy( data, _local_vertices.data(), _buffers[ 0 ].memory_size );
-	vkUnmapMemory( _device, _buffers[ 0 ].memory );
+	if( nullptr != _mapped_animation_parameters ) {
+		// every frame, the slot still holds what the frame that last used it saw
+		uint32_t frame				= _window->GetFrameArena()->GetFrameIndex();
+		auto parameters				= reinterpret_cast<VertexAnimationParameters*>( _mapped_animation_parameters + _animation_parameter_stride * frame );
+		*parameters					= _render_animation_parameters;
+		parameters->vertex_count	= uint32_t( _render_vertices.size() );
+
+		// rest pose is read on the compute queue, each slot catches up when its frame comes around
+		if( _animation_sources_stale[ frame ] ) {
+			memcpy( _mapped_animation_sources + _animation_vertex_stride * frame, _render_vertices.data(), _render_vertices.size() * sizeof( Mesh_Vertex ) );
+			_animation_sources_stale[ frame ]	= false;
+		}
+	}
+	// in indirect draw mode the scene packs our vertices into its own buffers
+	if( _parent->IsIndirectDrawEnabled() ) {
+		return;
+	}
+	if( !_upload_pending || nullptr == _window ) {
+		return;
+	}
+
+	// kept up to date with compute animation too, disabling it draws from here again.
+	// Copied at the start of the window's frame, frames in flight keep reading the old vertices until then
+	auto &target = _buffers[ BUFFER_VERTEX ];
+	void * data = _window->GetFrameArena()->AllocateUpload( target.buffer, 0, target.memory_size );
+	if( nullptr == data ) {
+		return;
+	}
+	memcpy( data, _render_vertices.data(), target.memory_size );
+	_upload_pending = false;
+}
+
+void SO_DynamicMesh::_SyncRenderState()
+{
+	if( _transform_dirty || _vertices_dirty ) {
+		++_render_revision;
+	}
+	SceneObject::_SyncRenderState();
+	if( _vertices_dirty ) {
+		// same size every frame, no reallocation
+		_render_vertices	= _local_vertices;
+		_vertices_dirty		= false;
+		_upload_pending		= true;
+		_animation_sources_stale.assign( _animation_sources_stale.size(), true );
+	}
+	if( _animation_parameters_dirty ) {
+		_render_animation_parameters		= _animation_parameters;
+		_animation_parameters_dirty			= false;
+	}
+}
+
+bool SO_DynamicMesh::IsUpdateThreadSafe() const
+{
+	return true;
 }
 
 const std::vector<Mesh_Vertex> & SO_DynamicMesh::GetVertices() const
@@ -44,9 +108,262 @@ const std::vector<Mesh_Vertex> & SO_DynamicMesh::GetVertices() const
 
 std::vector<Mesh_Vertex> & SO_DynamicMesh::GetEditableVertices()
 {
+	_vertices_dirty = true;
 	return _local_vertices;
 }
 
+const std::vector<Mesh_Vertex> & SO_DynamicMesh::GetRenderVertices() const
+{
+	return _render_vertices;
+}
+
+uint64_t SO_DynamicMesh::GetRenderRevision() const
+{
+	return _render_revision;
+}
+
+void SO_DynamicMesh::EnableComputeAnimation( const std::string & compute_pipeline_name )
+{
+	// parameters and command buffers follow the frames in flight of the window
+	assert( nullptr != _window && "Set the active window before enabling compute animation." );
+	DisableComputeAnimation();
+
+	// descriptor set layout is reflected from the shader: source and target vertices, then parameters
+	_animation_pipeline						= _renderer->GetComputePipeline( compute_pipeline_name );
+
+	uint32_t frame_count					= _window->GetFrameArena()->GetFrameCount();
+	auto &limits							= _renderer->GetVulkanPhysicalDeviceProperties().limits;
+	VkDeviceSize vertex_size				= _local_vertices.size() * sizeof( Mesh_Vertex );
+	_animation_vertex_stride				= AlignUp( vertex_size, limits.minStorageBufferOffsetAlignment );
+	_animation_parameter_stride				= AlignUp( sizeof( VertexAnimationParameters ), limits.minUniformBufferOffsetAlignment );
+
+	// rest pose, animated vertices and parameters, one slot per frame in flight each. The rest pose is
+	// written from the CPU, frame arena uploads would land on the graphics queue after the animation ran
+	std::vector<Buffer> animation_buffers( 3 );
+	animation_buffers[ 0 ].memory_size			= _animation_vertex_stride * frame_count;
+	animation_buffers[ 1 ].memory_size			= _animation_vertex_stride * frame_count;
+	animation_buffers[ 2 ].memory_size			= _animation_parameter_stride * frame_count;
+	animation_buffers[ 0 ].memory_properties	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	animation_buffers[ 1 ].memory_properties	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	animation_buffers[ 2 ].memory_properties	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VkBufferUsageFlags animation_buffer_usages[ 3 ] {
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+	};
+	for( uint32_t i=0; i < 3; ++i ) {
+		VkBufferCreateInfo buffer_create_info {};
+		buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size					= animation_buffers[ i ].memory_size;
+		buffer_create_info.usage				= animation_buffer_usages[ i ];
+		buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+		ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &animation_buffers[ i ].buffer ) );
+	}
+
+	AllocateBuffersMemory( _renderer, animation_buffers );
+	for( auto &b : animation_buffers ) {
+		ErrCheck( vkBindBufferMemory( _device, b.buffer, b.memory, 0 ) );
+	}
+	_buffers.insert( _buffers.end(), animation_buffers.begin(), animation_buffers.end() );
+
+	{
+		// both are written by Update, keep them mapped
+		void *data = nullptr;
+		ErrCheck( vkMapMemory( _device, _buffers[ BUFFER_ANIMATION_SOURCE ].memory, 0, _buffers[ BUFFER_ANIMATION_SOURCE ].memory_size, 0, &data ) );
+		_mapped_animation_sources		= reinterpret_cast<uint8_t*>( data );
+		ErrCheck( vkMapMemory( _device, _buffers[ BUFFER_ANIMATION_PARAMETERS ].memory, 0, _buffers[ BUFFER_ANIMATION_PARAMETERS ].memory_size, 0, &data ) );
+		_mapped_animation_parameters	= reinterpret_cast<uint8_t*>( data );
+		_animation_sources_stale.assign( frame_count, true );
+		// render side, the simulation may be setting the next parameters meanwhile
+		_render_animation_parameters	= VertexAnimationParameters {};
+	}
+
+	// descriptor sets, one per slot
+	{
+		VkDescriptorPoolSize pool_sizes[ 2 ] {};
+		pool_sizes[ 0 ].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		pool_sizes[ 0 ].descriptorCount		= 2 * frame_count;
+		pool_sizes[ 1 ].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		pool_sizes[ 1 ].descriptorCount		= frame_count;
+
+		VkDescriptorPoolCreateInfo pool_create_info {};
+		pool_create_info.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_create_info.maxSets			= frame_count;
+		pool_create_info.poolSizeCount		= 2;
+		pool_create_info.pPoolSizes			= pool_sizes;
+		ErrCheck( vkCreateDescriptorPool( _device, &pool_create_info, _allocation_callbacks, &_animation_descriptor_pool ) );
+
+		std::vector<VkDescriptorSetLayout> set_layouts( frame_count, _animation_pipeline->GetVulkanDescriptorSetLayout() );
+		_animation_descriptor_sets.resize( frame_count );
+		VkDescriptorSetAllocateInfo allocate_info {};
+		allocate_info.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocate_info.descriptorPool		= _animation_descriptor_pool;
+		allocate_info.descriptorSetCount	= frame_count;
+		allocate_info.pSetLayouts			= set_layouts.data();
+		ErrCheck( vkAllocateDescriptorSets( _device, &allocate_info, _animation_descriptor_sets.data() ) );
+
+		for( uint32_t f=0; f < frame_count; ++f ) {
+			VkDescriptorBufferInfo buffer_infos[ 3 ] {};
+			buffer_infos[ 0 ].buffer			= _buffers[ BUFFER_ANIMATION_SOURCE ].buffer;
+			buffer_infos[ 0 ].offset			= _animation_vertex_stride * f;
+			buffer_infos[ 0 ].range				= vertex_size;
+			buffer_infos[ 1 ].buffer			= _buffers[ BUFFER_ANIMATION_TARGET ].buffer;
+			buffer_infos[ 1 ].offset			= _animation_vertex_stride * f;
+			buffer_infos[ 1 ].range				= vertex_size;
+			buffer_infos[ 2 ].buffer			= _buffers[ BUFFER_ANIMATION_PARAMETERS ].buffer;
+			buffer_infos[ 2 ].offset			= _animation_parameter_stride * f;
+			buffer_infos[ 2 ].range				= sizeof( VertexAnimationParameters );
+
+			VkDescriptorType descriptor_types[ 3 ] {
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+			};
+			VkWriteDescriptorSet writes[ 3 ] {};
+			for( uint32_t i=0; i < 3; ++i ) {
+				writes[ i ].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[ i ].dstSet				= _animation_descriptor_sets[ f ];
+				writes[ i ].dstBinding			= i;
+				writes[ i ].descriptorCount		= 1;
+				writes[ i ].descriptorType		= descriptor_types[ i ];
+				writes[ i ].pBufferInfo			= &buffer_infos[ i ];
+			}
+			vkUpdateDescriptorSets( _device, 3, writes, 0, nullptr );
+		}
+	}
+
+	// animation runs on the compute queue, the graphics queue only acquires the animated vertices.
+	// Own pools so disabling can hand everything to DeferDestroy in one go
+	{
+		VkCommandPoolCreateInfo create_info {};
+		create_info.sType					= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		create_info.queueFamilyIndex		= _renderer->GetVulkanQueueFamilyIndex( QUEUE_TYPE_COMPUTE );
+		create_info.flags					= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		ErrCheck( vkCreateCommandPool( _device, &create_info, _allocation_callbacks, &_animation_command_pool ) );
+		create_info.queueFamilyIndex		= _graphics_queue_family_index;
+		create_info.flags					= 0;
+		ErrCheck( vkCreateCommandPool( _device, &create_info, _allocation_callbacks, &_animation_acquire_command_pool ) );
+
+		_animation_command_buffers.resize( frame_count );
+		VkCommandBufferAllocateInfo	allocate_info {};
+		allocate_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool			= _animation_command_pool;
+		allocate_info.commandBufferCount	= frame_count;
+		allocate_info.level					= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _animation_command_buffers.data() ) );
+		_animation_command_buffers_stale.assign( frame_count, true );
+
+		_animation_acquire_command_buffers.resize( frame_count );
+		allocate_info.commandPool			= _animation_acquire_command_pool;
+		allocate_info.level					= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _animation_acquire_command_buffers.data() ) );
+
+		// slots never move, the acquire halves are recorded once
+		for( uint32_t f=0; f < frame_count; ++f ) {
+			VkCommandBufferInheritanceInfo inheritance_info {};
+			inheritance_info.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+			VkCommandBufferBeginInfo begin_info {};
+			begin_info.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.pInheritanceInfo		= &inheritance_info;
+			ErrCheck( vkBeginCommandBuffer( _animation_acquire_command_buffers[ f ], &begin_info ) );
+			_renderer->CmdAcquireQueueOwnership( _animation_acquire_command_buffers[ f ], _GetAnimationTargetTransfer( f ) );
+			ErrCheck( vkEndCommandBuffer( _animation_acquire_command_buffers[ f ] ) );
+
+			_animation_semaphores.push_back( _renderer->AllocateSemaphore() );
+		}
+	}
+
+	// draws bind the animated vertices from now on
+	_command_buffer_out_of_date		= true;
+}
+
+void SO_DynamicMesh::DisableComputeAnimation()
+{
+	if( nullptr == _animation_pipeline ) {
+		return;
+	}
+
+	// frames in flight may still run the animation, everything goes once they are done
+	auto renderer					= _renderer;
+	auto device						= _device;
+	auto allocation_callbacks		= _allocation_callbacks;
+	auto command_pool				= _animation_command_pool;
+	auto acquire_command_pool		= _animation_acquire_command_pool;
+	auto descriptor_pool			= _animation_descriptor_pool;
+	auto semaphores					= _animation_semaphores;
+	std::vector<Buffer> animation_buffers( _buffers.begin() + BUFFER_ANIMATION_SOURCE, _buffers.end() );
+	_renderer->DeferDestroy( [ renderer, device, allocation_callbacks, command_pool, acquire_command_pool, descriptor_pool, semaphores, animation_buffers ]() mutable {
+		vkDestroyCommandPool( device, command_pool, allocation_callbacks );
+		vkDestroyCommandPool( device, acquire_command_pool, allocation_callbacks );
+		vkDestroyDescriptorPool( device, descriptor_pool, allocation_callbacks );
+		vkUnmapMemory( device, animation_buffers[ BUFFER_ANIMATION_SOURCE - BUFFER_ANIMATION_SOURCE ].memory );
+		vkUnmapMemory( device, animation_buffers[ BUFFER_ANIMATION_PARAMETERS - BUFFER_ANIMATION_SOURCE ].memory );
+		for( auto &b : animation_buffers ) {
+			vkDestroyBuffer( device, b.buffer, allocation_callbacks );
+		}
+		FreeBuffersMemory( renderer, animation_buffers );
+		// their waits completed with the frames
+		for( auto semaphore : semaphores ) {
+			renderer->FreeSemaphore( semaphore );
+		}
+	} );
+	_buffers.resize( BUFFER_ANIMATION_SOURCE );
+
+	_animation_pipeline				= nullptr;
+	_animation_command_pool			= VK_NULL_HANDLE;
+	_animation_acquire_command_pool	= VK_NULL_HANDLE;
+	_animation_descriptor_pool		= VK_NULL_HANDLE;
+	_animation_descriptor_sets.clear();
+	_animation_command_buffers.clear();
+	_animation_command_buffers_stale.clear();
+	_animation_acquire_command_buffers.clear();
+	_animation_semaphores.clear();
+	_mapped_animation_sources		= nullptr;
+	_animation_sources_stale.clear();
+	_mapped_animation_parameters	= nullptr;
+
+	// vertex buffer was kept up to date, draws go back to it
+	_command_buffer_out_of_date		= true;
+}
+void SO_DynamicMesh::SetComputeAnimationParameters( const VertexAnimationParameters & parameters )
+{
+	assert( nullptr != _mapped_animation_parameters );
+	// Scene::SyncState hands these to Update, which writes the uniform buffer
+	_animation_parameters			= parameters;
+	_animation_parameters_dirty		= true;
+}
+
+VkCommandBuffer SO_DynamicMesh::GetPreRenderCommandBuffer( bool rebuild_buffers )
+{
+	if( nullptr == _animation_pipeline || _parent->IsIndirectDrawEnabled() ) {
+		return VK_NULL_HANDLE;
+	}
+	if( rebuild_buffers ) {
+		_animation_command_buffers_stale.assign( _animation_command_buffers_stale.size(), true );
+	}
+	// other frames may still be executing theirs, each uses its own slots
+	uint32_t frame = _window->GetFrameArena()->GetFrameIndex();
+	if( _animation_command_buffers_stale[ frame ] ) {
+		_RecordAnimationCommandBuffer( frame );
+		_animation_command_buffers_stale[ frame ]	= false;
+	}
+
+	// Update wrote this frame's slots already. Overlaps with whatever the graphics queue is still
+	// doing, the window frame waits for it at vertex input
+	VkSubmitInfo submit_info {};
+	submit_info.sType					= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount		= 1;
+	submit_info.pCommandBuffers			= &_animation_command_buffers[ frame ];
+	submit_info.signalSemaphoreCount	= 1;
+	submit_info.pSignalSemaphores		= &_animation_semaphores[ frame ];
+	_renderer->Submit( QUEUE_TYPE_COMPUTE, submit_info );
+	_window->AddRenderWait( _animation_semaphores[ frame ], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
+
+	return _animation_acquire_command_buffers[ frame ];
+}
+
 const std::vector<Mesh_Polygon>& SO_DynamicMesh::GetIndeces() const
 {
 	return _local_indices;
@@ -63,36 +380,34 @@ void SO_DynamicMesh::_Initialize()
 	// copy date over to object local space
 	_local_vertices					= *_mesh->GetVerticesList();
 	_local_indices					= *_mesh->GetIndicesList();
+	_render_vertices				= _local_vertices;
+	// vertex buffer is filled through the frame arena of the window, once there is one
+	_upload_pending					= true;
 
 	_buffers.resize( 2 );
 	_buffers[ 0 ].memory_size		= _mesh->GetVerticesListByteSize();
 	_buffers[ 1 ].memory_size		= _mesh->GetIndicesListByteSize();
+	// indices are written once from the CPU without flushing
 	_buffers[ 0 ].memory_properties	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	_buffers[ 1 ].memory_properties	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	_buffers[ 1 ].memory_properties	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
 	// create buffers
 	VkBufferCreateInfo vertex_buffer_create_info {};
 	vertex_buffer_create_info.sType						= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	vertex_buffer_create_info.size						= _buffers[ 0 ].memory_size;
-	vertex_buffer_create_info.usage						= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	vertex_buffer_create_info.usage						= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	vertex_buffer_create_info.sharingMode				= VK_SHARING_MODE_EXCLUSIVE;
-	ErrCheck( vkCreateBuffer( _device, &vertex_buffer_create_info, nullptr, &_buffers[ 0 ].buffer ) );
+	ErrCheck( vkCreateBuffer( _device, &vertex_buffer_create_info, _allocation_callbacks, &_buffers[ 0 ].buffer ) );
 
 	VkBufferCreateInfo index_buffer_create_info {};
 	index_buffer_create_info.sType						= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	index_buffer_create_info.size						= _buffers[ 1 ].memory_size;
 	index_buffer_create_info.usage						= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 	index_buffer_create_info.sharingMode				= VK_SHARING_MODE_EXCLUSIVE;
-	ErrCheck( vkCreateBuffer( _device, &index_buffer_create_info, nullptr, &_buffers[ 1 ].buffer ) );
+	ErrCheck( vkCreateBuffer( _device, &index_buffer_create_info, _allocation_callbacks, &_buffers[ 1 ].buffer ) );
 
 	AllocateBuffersMemory( _renderer, _buffers );
 
-	{
-		void *data = nullptr;
-		ErrCheck( vkMapMemory( _device, _buffers[ 0 ].memory, 0, _buffers[ 0 ].memory_size, 0, &data ) );
-		memcpy( data, _local_vertices.data(), _local_vertices.size() * sizeof( Mesh_Vertex ) );
-		vkUnmapMemory( _device, _buffers[ 0 ].memory );
-	}
 	{
 		void *data = nullptr;
 		ErrCheck( vkMapMemory( _device, _buffers[ 1 ].memory, 0, _buffers[ 1 ].memory_size, 0, &data ) );
@@ -104,90 +419,77 @@ void SO_DynamicMesh::_Initialize()
 }
 
 
-void SO_DynamicMesh::_RebuildCommandBuffer()
+void SO_DynamicMesh::_RecordCommandBuffer( VkCommandBuffer command_buffer )
 {
-	if( nullptr == _window || nullptr == _pipeline ) {
-		return;
-	}
+	// no framebuffer, the same recording works for every swapchain image
+	VkCommandBufferInheritanceInfo inheritance_info {};
+	inheritance_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass				= _window->GetRenderPass();
+	inheritance_info.subpass				= 0;
+	inheritance_info.framebuffer			= VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo begin_info {};
+	begin_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags						= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	begin_info.pInheritanceInfo				= &inheritance_info;
+	ErrCheck( vkBeginCommandBuffer( command_buffer, &begin_info ) );
+
+	vkCmdBindPipeline( command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->GetVulkanPipeline() );
+	_window->CmdSetViewport( command_buffer );
+
+	// camera is shared by the whole window, model matrix is per object
+	VkDescriptorSet camera_descriptor_set	= _window->GetVulkanDescriptorSet();
+	vkCmdBindDescriptorSets( command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->GetVulkanPipelineLayout(), 0, 1, &camera_descriptor_set, 0, nullptr );
+	PC_Object object_constants {};
+	object_constants.model					= _render_transform;
+	vkCmdPushConstants( command_buffer, _pipeline->GetVulkanPipelineLayout(), _pipeline->GetPushConstantStageFlags(), 0, sizeof( PC_Object ), &object_constants );
 
-	// free old command buffers if they exist, we rescale this list to match our framebuffer image count
-	if( _command_buffers.size() ) {
-		vkFreeCommandBuffers( _device, _command_pool, _command_buffers.size(), _command_buffers.data() );
-	}
-	auto new_buffer_count				= _window->GetFrameBuffers().size();
-	_command_buffers.resize( new_buffer_count );
-
-	// allocate new command buffers exactly the amount of our window framebuffer image count
-	VkCommandBufferAllocateInfo	allocate_info {};
-	allocate_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocate_info.commandPool			= _command_pool;
-	allocate_info.commandBufferCount	= new_buffer_count;
-	allocate_info.level					= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-	ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _command_buffers.data() ) );
-
-	// for each buffer, we record the whole thing
-	for( uint32_t i=0; i < new_buffer_count; ++i ) {
-
-		VkCommandBufferInheritanceInfo inheritance_info {};
-		inheritance_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-		inheritance_info.renderPass				= _window->GetRenderPass();
-		inheritance_info.subpass				= 0;
-		inheritance_info.framebuffer			= _window->GetFrameBuffers()[ i ];
-
-		VkCommandBufferBeginInfo begin_info {};
-		begin_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begin_info.flags						= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-		begin_info.pInheritanceInfo				= &inheritance_info;
-		vkBeginCommandBuffer( _command_buffers[ i ] , &begin_info );
-		/*
-		// I'm not sure if these barriers are actually needed
-		// Barrier for vertex buffer transfer
-		VkBufferMemoryBarrier vertex_buffer_barrier {};
-		vertex_buffer_barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		vertex_buffer_barrier.srcAccessMask			= VK_ACCESS_HOST_WRITE_BIT;
-		vertex_buffer_barrier.dstAccessMask			= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-		vertex_buffer_barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
-		vertex_buffer_barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
-		vertex_buffer_barrier.buffer				= _buffers[ 0 ].buffer;
-		vertex_buffer_barrier.offset				= 0;
-		vertex_buffer_barrier.size					= _buffers[ 0 ].memory_size;
-
-		vkCmdPipelineBarrier( _command_buffers[ i ],
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-			0,
-			0, nullptr,
-			1, &vertex_buffer_barrier,
-			0, nullptr );
-
-		// Barrier for index buffer transfer
-		VkBufferMemoryBarrier index_buffer_barrier {};
-		index_buffer_barrier.sType					= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		index_buffer_barrier.srcAccessMask			= VK_ACCESS_HOST_WRITE_BIT;
-		index_buffer_barrier.dstAccessMask			= VK_ACCESS_INDEX_READ_BIT;
-		index_buffer_barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
-		index_buffer_barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
-		index_buffer_barrier.buffer					= _buffers[ 1 ].buffer;
-		index_buffer_barrier.offset					= 0;
-		index_buffer_barrier.size					= _buffers[ 1 ].memory_size;
-
-		vkCmdPipelineBarrier( _command_buffers[ i ],
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-			0,
-			0, nullptr,
-			1, &index_buffer_barrier,
-			0, nullptr );
-			*/
-		vkCmdBindPipeline( _command_buffers[ i ], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->GetVulkanPipeline() );
-
-		VkDeviceSize vertex_buffer_offsets[] { 0 };
-		vkCmdBindVertexBuffers( _command_buffers[ i ], 0, 1, &_buffers[ 0 ].buffer, vertex_buffer_offsets );
-		vkCmdBindIndexBuffer( _command_buffers[ i ], _buffers[ 1 ].buffer, 0, VK_INDEX_TYPE_UINT32 );
-
-//		vkCmdDraw( _command_buffer, 3, 1, 0, 0 );
-		vkCmdDrawIndexed( _command_buffers[ i ], 3 * _local_indices.size(), 1, 0, 0, 0 );
-
-		vkEndCommandBuffer( _command_buffers[ i ] );
+	// animated vertices have a slot per frame in flight, this is the current frame's recording
+	VkBuffer vertex_buffer					= _buffers[ BUFFER_VERTEX ].buffer;
+	VkDeviceSize vertex_buffer_offset		= 0;
+	if( nullptr != _animation_pipeline ) {
+		vertex_buffer						= _buffers[ BUFFER_ANIMATION_TARGET ].buffer;
+		vertex_buffer_offset				= _animation_vertex_stride * _window->GetFrameArena()->GetFrameIndex();
 	}
+	vkCmdBindVertexBuffers( command_buffer, 0, 1, &vertex_buffer, &vertex_buffer_offset );
+	vkCmdBindIndexBuffer( command_buffer, _buffers[ 1 ].buffer, 0, VK_INDEX_TYPE_UINT32 );
+
+	vkCmdDrawIndexed( command_buffer, 3 * _local_indices.size(), 1, 0, 0, 0 );
+
+	ErrCheck( vkEndCommandBuffer( command_buffer ) );
+}
+
+void SO_DynamicMesh::_RecordAnimationCommandBuffer( uint32_t frame )
+{
+	VkCommandBuffer command_buffer		= _animation_command_buffers[ frame ];
+
+	VkCommandBufferBeginInfo begin_info {};
+	begin_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	ErrCheck( vkBeginCommandBuffer( command_buffer, &begin_info ) );
+
+	// no barrier up front, the frame arena fence waited for the frame that last drew from this slot.
+	// Every vertex is overwritten, the slot is taken back from the graphics queue without a transfer
+	vkCmdBindPipeline( command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _animation_pipeline->GetVulkanPipeline() );
+	vkCmdBindDescriptorSets( command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _animation_pipeline->GetVulkanPipelineLayout(), 0, 1, &_animation_descriptor_sets[ frame ], 0, nullptr );
+	vkCmdDispatch( command_buffer, ( uint32_t( _render_vertices.size() ) + VERTEX_ANIMATION_WORKGROUP_SIZE - 1 ) / VERTEX_ANIMATION_WORKGROUP_SIZE, 1, 1 );
+
+	// acquire half is the pre render command buffer of the frame
+	_renderer->CmdReleaseQueueOwnership( command_buffer, _GetAnimationTargetTransfer( frame ) );
+
+	ErrCheck( vkEndCommandBuffer( command_buffer ) );
+}
+
+BufferOwnershipTransfer SO_DynamicMesh::_GetAnimationTargetTransfer( uint32_t frame ) const
+{
+	BufferOwnershipTransfer transfer;
+	transfer.buffer			= _buffers[ BUFFER_ANIMATION_TARGET ].buffer;
+	transfer.offset			= _animation_vertex_stride * frame;
+	transfer.size			= _local_vertices.size() * sizeof( Mesh_Vertex );
+	transfer.src_queue		= QUEUE_TYPE_COMPUTE;
+	transfer.src_access		= VK_ACCESS_SHADER_WRITE_BIT;
+	transfer.src_stage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	transfer.dst_queue		= QUEUE_TYPE_GRAPHICS;
+	transfer.dst_access		= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	transfer.dst_stage		= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	return transfer;
 }
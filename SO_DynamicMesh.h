@@ -8,9 +8,22 @@
 #include "VulkanCollections.h"
 
 #include <vector>
+#include <string>
 
 class Mesh;
 class Scene;
+class ComputePipeline;
+struct BufferOwnershipTransfer;
+
+// Uniform parameters of vertex animation compute shaders, layout must match
+// "AnimationParameters" in the shader. "values" meaning is up to the shader.
+struct VertexAnimationParameters
+{
+	float									time;
+	uint32_t								vertex_count;			// filled in automatically
+	uint32_t								padding[ 2 ];
+	float									values[ 4 ];
+};
 
 // SceneObject of DynamicMesh variety. This class has it's own copy of the data
 // which can be updated without modifying the original mesh.
@@ -20,20 +33,76 @@ public:
 	SO_DynamicMesh( Scene * parent_scene, Renderer * renderer, Mesh * mesh );
 	~SO_DynamicMesh();
 
-	void									Update();
+	void									Update() override;
+	// Update only writes this object's own vertex memory.
+	bool									IsUpdateThreadSafe() const override;
 	const std::vector<Mesh_Vertex>		&	GetVertices() const;
 	std::vector<Mesh_Vertex>			&	GetEditableVertices();
 	const std::vector<Mesh_Polygon>		&	GetIndeces() const;
 	std::vector<Mesh_Polygon>			&	GetEditableIndices();
+	// Vertices as of the last Scene::SyncState, these are the ones uploaded to the GPU.
+	const std::vector<Mesh_Vertex>		&	GetRenderVertices() const;
+	// Increases when Scene::SyncState changes the render vertices or the render transform.
+	uint64_t								GetRenderRevision() const;
+
+	// Vertices are animated on the GPU by a compute shader loaded from "BUILD_PIPELINE_DIRECTORY/<name>/comp.spv".
+	// Shader reads the local vertices as the rest pose and writes the vertices that are drawn, CPU only
+	// updates the parameters. Dispatched on the compute queue, the window waits for it at vertex input.
+	// Not used when the parent scene is in indirect draw mode.
+	// Enable and disable create and destroy Vulkan objects, call them from the render thread after
+	// SetActiveWindow. Disabling hands the objects to Renderer::DeferDestroy, it never waits.
+	void									EnableComputeAnimation( const std::string & compute_pipeline_name );
+	void									DisableComputeAnimation();
+	void									SetComputeAnimationParameters( const VertexAnimationParameters & parameters );
+
+	// Submits this frame's animation to the compute queue, returned command buffer takes the
+	// animated vertices over to the graphics queue.
+	VkCommandBuffer							GetPreRenderCommandBuffer( bool rebuild_buffers = false ) override;
 
 protected:
-	void									_Initialize();
-	void									_RebuildCommandBuffer();
+	void									_Initialize() override;
+	void									_RecordCommandBuffer( VkCommandBuffer command_buffer ) override;
+	void									_SyncRenderState() override;
 
 private:
+	enum BUFFER_ID : uint32_t
+	{
+		BUFFER_VERTEX						= 0,
+		BUFFER_INDEX,
+		BUFFER_ANIMATION_SOURCE,			// only exists when compute animation is enabled
+		BUFFER_ANIMATION_TARGET,			// only exists when compute animation is enabled
+		BUFFER_ANIMATION_PARAMETERS,		// only exists when compute animation is enabled
+	};
+
+	void									_RecordAnimationCommandBuffer( uint32_t frame );
+	BufferOwnershipTransfer					_GetAnimationTargetTransfer( uint32_t frame ) const;
+
 	Mesh								*	_mesh;
 	std::vector<Mesh_Vertex>				_local_vertices;
 	std::vector<Mesh_Polygon>				_local_indices;
+	bool									_vertices_dirty						= false;
+	std::vector<Mesh_Vertex>				_render_vertices;
+	uint64_t								_render_revision					= 0;
+	bool									_upload_pending						= false;
+	VertexAnimationParameters				_animation_parameters				= {};
+	bool									_animation_parameters_dirty			= false;
+	VertexAnimationParameters				_render_animation_parameters		= {};
 
 	std::vector<Buffer>						_buffers;
+
+	// everything below has one copy per frame in flight of the window, animation buffers have one slot per frame
+	ComputePipeline						*	_animation_pipeline					= nullptr;
+	VkCommandPool							_animation_command_pool				= VK_NULL_HANDLE;		// compute queue
+	VkCommandPool							_animation_acquire_command_pool		= VK_NULL_HANDLE;		// graphics queue
+	VkDescriptorPool						_animation_descriptor_pool			= VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet>			_animation_descriptor_sets;
+	std::vector<VkCommandBuffer>			_animation_command_buffers;
+	std::vector<bool>						_animation_command_buffers_stale;
+	std::vector<VkCommandBuffer>			_animation_acquire_command_buffers;
+	std::vector<VkSemaphore>				_animation_semaphores;
+	uint8_t								*	_mapped_animation_sources			= nullptr;
+	std::vector<bool>						_animation_sources_stale;
+	VkDeviceSize							_animation_vertex_stride			= 0;		// between the slots, source and target
+	uint8_t								*	_mapped_animation_parameters		= nullptr;
+	VkDeviceSize							_animation_parameter_stride			= 0;
 };
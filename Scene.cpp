@@ -4,9 +4,15 @@
 
 #include "Shared.hpp"
 #include "Scene.h"
+#include "IndirectDrawList.h"
+#include "Renderer.h"
+#include "JobSystem.h"
 
 #include "SO_DynamicMesh.h"
 
+// objects per job, small enough to balance, big enough to keep the scheduling cost down
+constexpr uint32_t SCENE_UPDATE_BATCH_SIZE		= 16;
+
 Scene::Scene( Scene * parent_scene, Renderer * renderer )
 {
 	_parent			= parent_scene;
@@ -15,46 +21,179 @@ Scene::Scene( Scene * parent_scene, Renderer * renderer )
 
 Scene::~Scene()
 {
+	delete _indirect_draw_list;
 	for( auto obj : _scene_objects ) {
 		delete obj;
 	}
 	for( auto sce : _child_scenes ) {
 		delete sce;
 	}
+	for( auto obj : _created_scene_objects ) {
+		delete obj;
+	}
+	for( auto sce : _created_child_scenes ) {
+		delete sce;
+	}
 }
 
 void Scene::Update()
 {
-	for( auto obj : _scene_objects ) {
+	if( !_manual_sync ) {
+		SyncState();
+	}
+
+	_parallel_update_objects.clear();
+	_serial_update_objects.clear();
+	_indirect_update_scenes.clear();
+	_CollectUpdates( _parallel_update_objects, _serial_update_objects, _indirect_update_scenes );
+
+	auto job_system = _renderer->GetJobSystem();
+	JobCounter counter( 0 );
+	std::function<void( uint32_t, uint32_t )> update_range = [ this ]( uint32_t begin, uint32_t end ) {
+		for( uint32_t i=begin; i < end; ++i ) {
+			_parallel_update_objects[ i ]->Update();
+		}
+	};
+	job_system->ParallelFor( counter, uint32_t( _parallel_update_objects.size() ), SCENE_UPDATE_BATCH_SIZE, update_range );
+	for( auto obj : _serial_update_objects ) {
 		obj->Update();
 	}
+	job_system->Wait( counter );
+
+	// draw lists pack the updated objects, each into it's own buffers
+	for( auto sce : _indirect_update_scenes ) {
+		job_system->Run( counter, [ sce ]() {
+			sce->_indirect_draw_list->Update( sce->_scene_objects );
+		} );
+	}
+	job_system->Wait( counter );
+}
+
+void Scene::_CollectUpdates( std::vector<SceneObject*> & parallel_objects, std::vector<SceneObject*> & serial_objects, std::vector<Scene*> & indirect_scenes )
+{
+	for( auto obj : _scene_objects ) {
+		if( obj->IsUpdateThreadSafe() ) {
+			parallel_objects.push_back( obj );
+		} else {
+			serial_objects.push_back( obj );
+		}
+	}
+	if( nullptr != _indirect_draw_list ) {
+		indirect_scenes.push_back( this );
+	}
 	for( auto sce : _child_scenes ) {
-		sce->Update();
+		sce->_CollectUpdates( parallel_objects, serial_objects, indirect_scenes );
 	}
 }
 
 Scene * Scene::CreateChildScene()
 {
 	Scene * child = new Scene( this, _renderer );
-	_child_scenes.push_back( child );
+	_created_child_scenes.push_back( child );
 	return child;
 }
 
 SO_DynamicMesh * Scene::CreateSceneObject_DynamicMesh( Mesh * mesh )
 {
 	auto obj = new SO_DynamicMesh( this, _renderer, mesh );
-	_scene_objects.push_back( obj );
+	_created_scene_objects.push_back( obj );
 	return obj;
 }
 
-void Scene::CollectCommandBuffers_Local( std::vector<VkCommandBuffer>& out_command_buffers, bool force_recalculate ) const
+void Scene::DestroySceneObject( SceneObject * scene_object )
 {
+	_destroyed_scene_objects.push_back( scene_object );
+}
+
+void Scene::SyncState()
+{
+	_scene_objects.insert( _scene_objects.end(), _created_scene_objects.begin(), _created_scene_objects.end() );
+	_created_scene_objects.clear();
+	_child_scenes.insert( _child_scenes.end(), _created_child_scenes.begin(), _created_child_scenes.end() );
+	_created_child_scenes.clear();
+
+	for( auto obj : _destroyed_scene_objects ) {
+		_scene_objects.remove( obj );
+		// recorded command buffers of the frames in flight may still use it
+		_renderer->DeferDestroy( [ obj ]() {
+			delete obj;
+		} );
+	}
+	_destroyed_scene_objects.clear();
+
+	for( auto obj : _scene_objects ) {
+		obj->_SyncRenderState();
+	}
+	for( auto sce : _child_scenes ) {
+		sce->SyncState();
+	}
+}
+
+void Scene::SetManualSync( bool manual_sync )
+{
+	_manual_sync = manual_sync;
+}
+
+void Scene::EnableIndirectDraw( Window * window, Pipeline * pipeline )
+{
+	delete _indirect_draw_list;
+	_indirect_draw_list = new IndirectDrawList( _renderer, window, pipeline );
+}
+
+void Scene::DisableIndirectDraw()
+{
+	delete _indirect_draw_list;
+	_indirect_draw_list = nullptr;
+}
+
+bool Scene::IsIndirectDrawEnabled() const
+{
+	return nullptr != _indirect_draw_list;
+}
+
+IndirectDrawList * Scene::GetIndirectDrawList()
+{
+	return _indirect_draw_list;
+}
+
+void Scene::CollectPreRenderCommandBuffers_Local( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate ) const
+{
+	if( nullptr != _indirect_draw_list ) {
+		out_command_buffers.push_back( _indirect_draw_list->GetCullCommandBuffer( force_recalculate ) );
+	}
+	for( auto obj : _scene_objects ) {
+		auto command_buffer = obj->GetPreRenderCommandBuffer( force_recalculate );
+		if( VK_NULL_HANDLE != command_buffer ) {
+			out_command_buffers.push_back( command_buffer );
+		}
+	}
+}
+
+void Scene::CollectPreRenderCommandBuffers_Recursive( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate ) const
+{
+	CollectPreRenderCommandBuffers_Local( out_command_buffers, force_recalculate );
+	for( auto sce : _child_scenes ) {
+		sce->CollectPreRenderCommandBuffers_Recursive( out_command_buffers, force_recalculate );
+	}
+}
+
+void Scene::CollectCommandBuffers_Local( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate ) const
+{
+	if( nullptr != _indirect_draw_list ) {
+		out_command_buffers.push_back( _indirect_draw_list->GetDrawCommandBuffer( force_recalculate ) );
+	}
 	for( auto obj : _scene_objects ) {
-		out_command_buffers.push_back( obj->GetActiveCommandBuffer( force_recalculate ) );
+		if( nullptr != _indirect_draw_list && _indirect_draw_list->IsHandled( obj ) ) {
+			continue;
+		}
+		auto command_buffer = obj->GetActiveCommandBuffer( force_recalculate );
+		if( VK_NULL_HANDLE != command_buffer ) {
+			out_command_buffers.push_back( command_buffer );
+		}
 	}
 }
 
-void Scene::CollectCommandBuffers_Recursive( std::vector<VkCommandBuffer>& out_command_buffers, bool force_recalculate ) const
+void Scene::CollectCommandBuffers_Recursive( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate ) const
 {
 	CollectCommandBuffers_Local( out_command_buffers, force_recalculate );
 	for( auto sce : _child_scenes ) {
@@ -3,11 +3,16 @@
 #include "BUILD_OPTIONS.h"
 #include "Platform.h"
 
+#include "FrameArena.h"
+
 #include <vector>
 #include <list>
 
 class Renderer;
+class Window;
+class Pipeline;
 class SceneObject;
+class IndirectDrawList;
 
 class Mesh;
 
@@ -21,19 +26,58 @@ public:
 	Scene( Scene * parent_scene, Renderer * renderer );
 	~Scene();
 
+	// Updates objects of this scene and all child scenes. Thread safe objects are updated in
+	// parallel on the Renderer job system, the rest on the calling thread.
 	void							Update();
 
+	// New child scenes and objects become part of the render side on the next SyncState,
+	// they can be created from a simulation thread.
 	Scene						*	CreateChildScene();
 
 	SO_DynamicMesh				*	CreateSceneObject_DynamicMesh( Mesh * mesh );
 
-	void							CollectCommandBuffers_Local( std::vector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
-	void							CollectCommandBuffers_Recursive( std::vector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
+	// Removed on the next SyncState, deleted once the GPU is done with it's command buffers.
+	void							DestroySceneObject( SceneObject * scene_object );
+
+	// Applies simulation side changes of this scene tree to the render side: new and destroyed
+	// objects, vertex edits and transforms. Nothing may edit the scene while this runs.
+	void							SyncState();
+	// False by default, Update then calls SyncState itself. SimulationThread turns this on and
+	// syncs between simulated frames instead.
+	void							SetManualSync( bool manual_sync );
+
+	// In indirect draw mode objects of this scene ( not child scenes ) are culled and
+	// drawn on the GPU with indirect draws instead of their own command buffers.
+	void							EnableIndirectDraw( Window * window, Pipeline * pipeline );
+	void							DisableIndirectDraw();
+	bool							IsIndirectDrawEnabled() const;
+	IndirectDrawList			*	GetIndirectDrawList();
+
+	// Command buffers that need to be executed before the render pass begins, compute work mostly.
+	void							CollectPreRenderCommandBuffers_Local( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
+	void							CollectPreRenderCommandBuffers_Recursive( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
+
+	void							CollectCommandBuffers_Local( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
+	void							CollectCommandBuffers_Recursive( FrameVector<VkCommandBuffer> & out_command_buffers, bool force_recalculate = false ) const;
 
 private:
+	void							_CollectUpdates( std::vector<SceneObject*> & parallel_objects, std::vector<SceneObject*> & serial_objects, std::vector<Scene*> & indirect_scenes );
+
 	Renderer					*	_renderer				= nullptr;
 	Scene						*	_parent					= nullptr;
+	IndirectDrawList			*	_indirect_draw_list		= nullptr;
 
 	std::list<Scene*>				_child_scenes;
 	std::list<SceneObject*>			_scene_objects;
+
+	// simulation side changes waiting for SyncState
+	std::vector<Scene*>				_created_child_scenes;
+	std::vector<SceneObject*>		_created_scene_objects;
+	std::vector<SceneObject*>		_destroyed_scene_objects;
+	bool							_manual_sync			= false;
+
+	// rebuilt every update, kept to reuse the memory
+	std::vector<SceneObject*>		_parallel_update_objects;
+	std::vector<SceneObject*>		_serial_update_objects;
+	std::vector<Scene*>				_indirect_update_scenes;
 };
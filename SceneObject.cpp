@@ -7,6 +7,8 @@
 #include "SceneObject.h"
 #include "Window.h"
 #include "Renderer.h"
+#include "Pipeline.h"
+#include "FrameArena.h"
 
 #include <vector>
 
@@ -16,6 +18,7 @@ SceneObject::SceneObject( Scene * parent_scene, Renderer *renderer )
 	_parent							= parent_scene;
 	_renderer						= renderer;
 	_device							= renderer->GetVulkanDevice();
+	_allocation_callbacks			= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_SCENE );
 	_queue							= renderer->GetVulkanQueue();
 	_graphics_queue_family_index	= renderer->GetVulkanGraphicsQueueFamilyIndex();
 
@@ -23,22 +26,66 @@ SceneObject::SceneObject( Scene * parent_scene, Renderer *renderer )
 	create_info.sType				= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	create_info.queueFamilyIndex	= _graphics_queue_family_index;
 	create_info.flags				= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	vkCreateCommandPool( _device, &create_info, nullptr, &_command_pool );
+	vkCreateCommandPool( _device, &create_info, _allocation_callbacks, &_command_pool );
 }
 
 SceneObject::~SceneObject()
 {
-	vkDestroyCommandPool( _device, _command_pool, nullptr );
+	vkDestroyCommandPool( _device, _command_pool, _allocation_callbacks );
 }
 
 
 VkCommandBuffer SceneObject::GetActiveCommandBuffer( bool rebuild_buffers )
 {
-	if( _command_buffer_out_of_date || rebuild_buffers ) {
-		_RebuildCommandBuffer();
-		_command_buffer_out_of_date = false;
+	if( nullptr == _window || nullptr == _pipeline ) {
+		return VK_NULL_HANDLE;
 	}
-	return _command_buffers[ _window->GetCurrentFrameBufferIndex() ];
+	_AllocateCommandBuffers();
+
+	// pipeline may have been swapped to it's optimized variant since we last recorded
+	bool pipeline_changed = _pipeline->GetGeneration() != _recorded_pipeline_generation;
+	if( _command_buffer_out_of_date || rebuild_buffers || pipeline_changed ) {
+		// read before recording, a swap during recording is then caught on the next frame
+		_recorded_pipeline_generation	= _pipeline->GetGeneration();
+		_command_buffers_stale.assign( _command_buffers.size(), true );
+		_command_buffer_out_of_date		= false;
+	}
+
+	// other frames may still be executing theirs, this one was waited for by the frame arena
+	uint32_t frame = _window->GetFrameArena()->GetFrameIndex();
+	if( _command_buffers_stale[ frame ] ) {
+		_RecordCommandBuffer( _command_buffers[ frame ] );
+		_command_buffers_stale[ frame ]	= false;
+	}
+	return _command_buffers[ frame ];
+}
+
+void SceneObject::_AllocateCommandBuffers()
+{
+	uint32_t frame_count = _window->GetFrameArena()->GetFrameCount();
+	if( _command_buffers.size() == frame_count ) {
+		return;
+	}
+	// a previous window may still be executing the old ones, they are released with the pool
+	_command_buffers.resize( frame_count );
+
+	VkCommandBufferAllocateInfo	allocate_info {};
+	allocate_info.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool			= _command_pool;
+	allocate_info.commandBufferCount	= frame_count;
+	allocate_info.level					= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _command_buffers.data() ) );
+	_command_buffers_stale.assign( frame_count, true );
+}
+
+bool SceneObject::IsUpdateThreadSafe() const
+{
+	return false;
+}
+
+VkCommandBuffer SceneObject::GetPreRenderCommandBuffer( bool rebuild_buffers )
+{
+	return VK_NULL_HANDLE;
 }
 
 void SceneObject::SetActiveWindow( Window * window )
@@ -56,3 +103,28 @@ void SceneObject::SetActivePipeline( Pipeline * pipeline )
 	}
 	_pipeline = pipeline;
 }
+
+void SceneObject::SetTransform( const Matrix4 & transform )
+{
+	_transform					= transform;
+	_transform_dirty			= true;
+}
+
+const Matrix4 & SceneObject::GetTransform() const
+{
+	return _transform;
+}
+
+const Matrix4 & SceneObject::GetRenderTransform() const
+{
+	return _render_transform;
+}
+
+void SceneObject::_SyncRenderState()
+{
+	if( _transform_dirty ) {
+		_render_transform			= _transform;
+		_transform_dirty			= false;
+		_command_buffer_out_of_date	= true;
+	}
+}
@@ -3,6 +3,8 @@
 #include "BUILD_OPTIONS.h"
 #include "Platform.h"
 
+#include "Matrix.h"
+
 #include <vector>
 
 class Scene;
@@ -12,33 +14,67 @@ class Pipeline;
 
 // SceneObject is a base object for "in-scene" objects. These are individual
 // entities within a scene, SceneObject is unique for each object within the scene
+//
+// Setters and editable getters change the simulation side of the object. Scene::SyncState
+// copies it to the render side which Update and command buffer recording read, so a
+// simulation thread can edit the next frame while the current one renders.
 class SceneObject
 {
+	friend class Scene;
+
 public:
 	SceneObject( Scene * parent_scene, Renderer * renderer );
 	virtual ~SceneObject();
 
 	virtual void					Update() = 0;
+	// True if Update only touches the object's own data and may run on a worker thread
+	// in parallel with other objects. Otherwise it runs on the thread calling Scene::Update.
+	virtual bool					IsUpdateThreadSafe() const;
 
+	// Secondary command buffer of the window's current frame in flight, VK_NULL_HANDLE without a window
+	// or pipeline. Changes mark every frame's copy stale, each is re-recorded when its frame comes around.
 	VkCommandBuffer					GetActiveCommandBuffer( bool rebuild_buffers = false );
+	// Command buffer executed before the render pass begins, VK_NULL_HANDLE if the object has none.
+	virtual VkCommandBuffer			GetPreRenderCommandBuffer( bool rebuild_buffers = false );
 	void							SetActiveWindow( Window * window );
 	void							SetActivePipeline( Pipeline * pipeline );
 
+	// Model matrix is given to the vertex shader as a push constant, moving an object
+	// only re-records it's own command buffers and never touches the vertex data.
+	void							SetTransform( const Matrix4 & transform );
+	const Matrix4				&	GetTransform() const;
+	// Transform as of the last Scene::SyncState.
+	const Matrix4				&	GetRenderTransform() const;
+
 protected:
 	Scene						*	_parent							= nullptr;
 	Renderer					*	_renderer						= nullptr;
 	Window						*	_window							= nullptr;
 	Pipeline					*	_pipeline						= nullptr;
 	VkDevice						_device							= VK_NULL_HANDLE;
+	const VkAllocationCallbacks	*	_allocation_callbacks			= nullptr;
 	VkQueue							_queue							= VK_NULL_HANDLE;
 
 	uint32_t						_graphics_queue_family_index	= 0;
 
 	VkCommandPool					_command_pool					= VK_NULL_HANDLE;
-	std::vector<VkCommandBuffer>	_command_buffers;
+	std::vector<VkCommandBuffer>	_command_buffers;				// one per frame in flight of the window
+	std::vector<bool>				_command_buffers_stale;
+
+	Matrix4							_transform						= Matrix4Identity();
+	Matrix4							_render_transform				= Matrix4Identity();
+	bool							_transform_dirty				= false;
 
 	bool							_command_buffer_out_of_date		= true;
+	uint32_t						_recorded_pipeline_generation	= 0;
 
 	virtual void					_Initialize()					= 0;
-	virtual void					_RebuildCommandBuffer()			= 0;
+	// Records the object into a secondary command buffer that continues the window render pass.
+	virtual void					_RecordCommandBuffer( VkCommandBuffer command_buffer )		= 0;
+	// Copies simulation side changes to the render side, called by Scene::SyncState.
+	virtual void					_SyncRenderState();
+
+private:
+	// Matches the command buffer count to the frames in flight of the window.
+	void							_AllocateCommandBuffers();
 };
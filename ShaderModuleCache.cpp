@@ -0,0 +1,161 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "ShaderModuleCache.h"
+#include "MappedFile.h"
+#include "AssetArchive.h"
+#include "Renderer.h"
+#include "Shared.hpp"
+
+#include <chrono>
+#include <iostream>
+
+constexpr uint32_t SPIRV_MAGIC_NUMBER			= 0x07230203;
+constexpr size_t SPIRV_HEADER_SIZE				= 5 * sizeof( uint32_t );
+
+// FNV-1a over 32 bit words, SPIR-V is always a whole number of words
+static uint64_t HashSPIRV( const uint32_t * code, size_t word_count )
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for( size_t i=0; i < word_count; ++i ) {
+		hash ^= code[ i ];
+		hash *= 0x100000001b3ull;
+	}
+	return hash ^ ( uint64_t( word_count ) << 32 );
+}
+
+static double MillisecondsSince( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+}
+
+ShaderModuleCache::ShaderModuleCache( Renderer * renderer )
+{
+	_renderer				= renderer;
+	_device					= renderer->GetVulkanDevice();
+	_allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_PIPELINE );
+}
+
+ShaderModuleCache::~ShaderModuleCache()
+{
+	for( auto &m : _modules ) {
+		vkDestroyShaderModule( _device, m.second, _allocation_callbacks );
+	}
+	_modules.clear();
+}
+
+VkShaderModule ShaderModuleCache::GetShaderModule( const std::string & path, bool skip_archive )
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// archive first, uncompressed entries are used in place
+	auto archive	= _renderer->GetAssetArchive();
+	auto entry		= skip_archive ? nullptr : archive->FindEntry( path );
+	if( entry ) {
+		auto code = archive->GetUncompressedData( entry );
+		if( code ) {
+			return _GetShaderModule( code, size_t( entry->size ), MillisecondsSince( start ) );
+		}
+		std::vector<uint8_t> decompressed;
+		if( !archive->Read( path, decompressed ) ) {
+			assert( 0 && "Corrupt shader in asset archive." );
+			return VK_NULL_HANDLE;
+		}
+		return _GetShaderModule( decompressed.data(), decompressed.size(), MillisecondsSince( start ) );
+	}
+
+	MappedFile file( path );
+	if( !file.IsOpen() ) {
+		std::cout << "Shader file not found: " << path << std::endl;
+		return VK_NULL_HANDLE;
+	}
+	return _GetShaderModule( file.GetData(), file.GetSize(), MillisecondsSince( start ) );
+}
+
+VkShaderModule ShaderModuleCache::GetShaderModule( const void * code, size_t size )
+{
+	return _GetShaderModule( code, size, 0.0 );
+}
+
+const ShaderReflection & ShaderModuleCache::GetReflection( VkShaderModule module )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	auto it = _reflections.find( module );
+	assert( it != _reflections.end() && "Shader module doesn't belong to this cache." );
+	return it->second;
+}
+
+ShaderModuleCacheStatistics ShaderModuleCache::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _statistics;
+}
+
+void ShaderModuleCache::PrintStatistics( std::ostream & stream )
+{
+	auto s = GetStatistics();
+	stream << "Shader modules: " << s.module_count
+		<< " unique, requests " << s.request_count
+		<< " (hits " << s.hit_count << ")"
+		<< ", " << s.bytes_loaded << " B loaded in " << s.load_milliseconds
+		<< " ms, created in " << s.create_milliseconds << " ms\n";
+}
+
+VkShaderModule ShaderModuleCache::_GetShaderModule( const void * code, size_t size, double load_milliseconds )
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// driver requires whole words, 4 byte alignment and a SPIR-V header. Not an assert,
+	// hot reload can see files that are still being written.
+	auto words = reinterpret_cast<const uint32_t*>( code );
+	if( size < SPIRV_HEADER_SIZE || size % sizeof( uint32_t ) != 0 || reinterpret_cast<uintptr_t>( code ) % alignof( uint32_t ) != 0 ) {
+		std::cout << "Invalid SPIR-V size or alignment." << std::endl;
+		return VK_NULL_HANDLE;
+	}
+	if( words[ 0 ] != SPIRV_MAGIC_NUMBER ) {
+		std::cout << "Invalid SPIR-V magic number." << std::endl;
+		return VK_NULL_HANDLE;
+	}
+	auto hash = HashSPIRV( words, size / sizeof( uint32_t ) );
+	load_milliseconds += MillisecondsSince( start );
+
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		++_statistics.request_count;
+		_statistics.load_milliseconds	+= load_milliseconds;
+		auto it = _modules.find( hash );
+		if( it != _modules.end() ) {
+			++_statistics.hit_count;
+			return it->second;
+		}
+	}
+
+	// reflect and create outside the lock so pipeline threads compiling different shaders don't serialize
+	start = std::chrono::steady_clock::now();
+	ShaderReflection reflection;
+	if( !ReflectSPIRV( words, size / sizeof( uint32_t ), reflection ) ) {
+		assert( 0 && "SPIR-V reflection failed, layouts may be incomplete." );
+	}
+
+	VkShaderModuleCreateInfo shader_module_create_info {};
+	shader_module_create_info.sType				= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shader_module_create_info.codeSize			= size;
+	shader_module_create_info.pCode				= words;
+	VkShaderModule module = VK_NULL_HANDLE;
+	ErrCheck( vkCreateShaderModule( _device, &shader_module_create_info, _allocation_callbacks, &module ) );
+	auto create_milliseconds = MillisecondsSince( start );
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	_statistics.create_milliseconds		+= create_milliseconds;
+	auto result = _modules.insert( std::make_pair( hash, module ) );
+	if( !result.second ) {
+		// another thread created the same module meanwhile
+		vkDestroyShaderModule( _device, module, _allocation_callbacks );
+		++_statistics.hit_count;
+		return result.first->second;
+	}
+	_reflections[ module ] = std::move( reflection );
+	++_statistics.module_count;
+	_statistics.bytes_loaded			+= size;
+	return module;
+}
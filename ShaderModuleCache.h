@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "ShaderReflection.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <ostream>
+
+class Renderer;
+
+struct ShaderModuleCacheStatistics
+{
+	uint64_t						module_count				= 0;		// unique modules alive
+	uint64_t						request_count				= 0;
+	uint64_t						hit_count					= 0;		// requests served by an existing module
+	uint64_t						bytes_loaded				= 0;		// SPIR-V bytes handed to the driver
+	double							load_milliseconds			= 0.0;		// mapping, validation and hashing
+	double							create_milliseconds			= 0.0;		// reflection and vkCreateShaderModule
+};
+
+// Shader modules are shared by every pipeline in every window. Modules are keyed by the hash of
+// their SPIR-V so identical code loaded from different paths results in a single module.
+// Each module is reflected once, see ShaderReflection.h.
+// Files are memory mapped and handed to the driver directly, there are no intermediate copies.
+// Safe to call from pipeline build threads, modules live until the renderer is destroyed.
+class ShaderModuleCache
+{
+public:
+	ShaderModuleCache( Renderer * renderer );
+	~ShaderModuleCache();
+
+	// Looks in the renderer asset archive first, then on disk. Hot reload skips the archive.
+	// Returns VK_NULL_HANDLE if the file doesn't exist or isn't valid SPIR-V.
+	VkShaderModule							GetShaderModule( const std::string & path, bool skip_archive = false );
+	// Code must be 4 byte aligned and stay valid for the duration of the call.
+	VkShaderModule							GetShaderModule( const void * code, size_t size );
+
+	// Reflected once when the module is created, valid as long as the cache.
+	const ShaderReflection				&	GetReflection( VkShaderModule module );
+
+	ShaderModuleCacheStatistics				GetStatistics();
+	void									PrintStatistics( std::ostream & stream );
+
+private:
+	VkShaderModule							_GetShaderModule( const void * code, size_t size, double load_milliseconds );
+
+	Renderer							*	_renderer						= nullptr;
+	VkDevice								_device							= VK_NULL_HANDLE;
+	const VkAllocationCallbacks			*	_allocation_callbacks			= nullptr;
+
+	std::mutex								_mutex;
+	std::unordered_map<uint64_t, VkShaderModule>	_modules;				// content hash to module
+	std::unordered_map<VkShaderModule, ShaderReflection>	_reflections;
+	ShaderModuleCacheStatistics				_statistics;
+};
@@ -0,0 +1,367 @@
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "ShaderReflection.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <unordered_map>
+
+// Subset of the SPIR-V specification we need, values from spirv.h
+enum SPIRV_OP : uint32_t
+{
+	SPIRV_OP_ENTRY_POINT				= 15,
+	SPIRV_OP_EXECUTION_MODE				= 16,
+	SPIRV_OP_TYPE_INT					= 21,
+	SPIRV_OP_TYPE_FLOAT					= 22,
+	SPIRV_OP_TYPE_VECTOR				= 23,
+	SPIRV_OP_TYPE_MATRIX				= 24,
+	SPIRV_OP_TYPE_IMAGE					= 25,
+	SPIRV_OP_TYPE_SAMPLER				= 26,
+	SPIRV_OP_TYPE_SAMPLED_IMAGE			= 27,
+	SPIRV_OP_TYPE_ARRAY					= 28,
+	SPIRV_OP_TYPE_RUNTIME_ARRAY			= 29,
+	SPIRV_OP_TYPE_STRUCT				= 30,
+	SPIRV_OP_TYPE_POINTER				= 32,
+	SPIRV_OP_CONSTANT					= 43,
+	SPIRV_OP_VARIABLE					= 59,
+	SPIRV_OP_DECORATE					= 71,
+	SPIRV_OP_MEMBER_DECORATE			= 72,
+};
+
+enum SPIRV_DECORATION : uint32_t
+{
+	SPIRV_DECORATION_SPEC_ID			= 1,
+	SPIRV_DECORATION_BLOCK				= 2,
+	SPIRV_DECORATION_BUFFER_BLOCK		= 3,
+	SPIRV_DECORATION_ARRAY_STRIDE		= 6,
+	SPIRV_DECORATION_MATRIX_STRIDE		= 7,
+	SPIRV_DECORATION_BUILT_IN			= 11,
+	SPIRV_DECORATION_LOCATION			= 30,
+	SPIRV_DECORATION_BINDING			= 33,
+	SPIRV_DECORATION_DESCRIPTOR_SET		= 34,
+	SPIRV_DECORATION_OFFSET				= 35,
+};
+
+enum SPIRV_STORAGE_CLASS : uint32_t
+{
+	SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT	= 0,
+	SPIRV_STORAGE_CLASS_INPUT				= 1,
+	SPIRV_STORAGE_CLASS_UNIFORM				= 2,
+	SPIRV_STORAGE_CLASS_PUSH_CONSTANT		= 9,
+	SPIRV_STORAGE_CLASS_STORAGE_BUFFER		= 12,
+};
+
+constexpr uint32_t SPIRV_EXECUTION_MODE_LOCAL_SIZE	= 17;
+constexpr uint32_t SPIRV_DIM_BUFFER					= 5;
+constexpr uint32_t SPIRV_HEADER_WORDS				= 5;
+
+struct SPIRVDecorations
+{
+	int64_t					location		= -1;
+	int64_t					binding			= -1;
+	int64_t					set				= -1;
+	uint32_t				array_stride	= 0;
+	bool					built_in		= false;
+	bool					block			= false;
+	bool					buffer_block	= false;
+};
+
+class SPIRVParser
+{
+public:
+	SPIRVParser( const uint32_t * code, size_t word_count )
+	{
+		_bound			= code[ 3 ];
+		_instructions.resize( _bound, nullptr );
+		_decorations.resize( _bound );
+
+		size_t i = SPIRV_HEADER_WORDS;
+		while( i < word_count ) {
+			auto inst			= code + i;
+			uint32_t count		= inst[ 0 ] >> 16;
+			uint32_t op			= inst[ 0 ] & 0xffff;
+			if( count == 0 || i + count > word_count ) {
+				_valid = false;
+				return;
+			}
+			switch( op ) {
+			case SPIRV_OP_ENTRY_POINT:
+				if( !_entry_point ) _entry_point = inst;
+				break;
+			case SPIRV_OP_EXECUTION_MODE:
+				if( count >= 6 && inst[ 2 ] == SPIRV_EXECUTION_MODE_LOCAL_SIZE ) _local_size = inst;
+				break;
+			case SPIRV_OP_TYPE_INT:
+			case SPIRV_OP_TYPE_FLOAT:
+			case SPIRV_OP_TYPE_VECTOR:
+			case SPIRV_OP_TYPE_MATRIX:
+			case SPIRV_OP_TYPE_IMAGE:
+			case SPIRV_OP_TYPE_SAMPLER:
+			case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			case SPIRV_OP_TYPE_ARRAY:
+			case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+			case SPIRV_OP_TYPE_STRUCT:
+			case SPIRV_OP_TYPE_POINTER:
+				if( inst[ 1 ] < _bound ) _instructions[ inst[ 1 ] ] = inst;
+				break;
+			case SPIRV_OP_CONSTANT:
+				if( inst[ 2 ] < _bound ) _instructions[ inst[ 2 ] ] = inst;
+				break;
+			case SPIRV_OP_VARIABLE:
+				if( inst[ 2 ] < _bound ) _variables.push_back( inst );
+				break;
+			case SPIRV_OP_DECORATE:
+				if( inst[ 1 ] < _bound ) _Decorate( _decorations[ inst[ 1 ] ], inst[ 2 ], count > 3 ? inst[ 3 ] : 0 );
+				if( count > 3 && inst[ 2 ] == SPIRV_DECORATION_SPEC_ID ) _specialization_constant_ids.push_back( inst[ 3 ] );
+				break;
+			case SPIRV_OP_MEMBER_DECORATE:
+				if( count > 4 && inst[ 3 ] == SPIRV_DECORATION_OFFSET )			_member_offsets[ _MemberKey( inst[ 1 ], inst[ 2 ] ) ]			= inst[ 4 ];
+				if( count > 4 && inst[ 3 ] == SPIRV_DECORATION_MATRIX_STRIDE )	_member_matrix_strides[ _MemberKey( inst[ 1 ], inst[ 2 ] ) ]	= inst[ 4 ];
+				break;
+			default:
+				break;
+			}
+			i += count;
+		}
+	}
+
+	bool Reflect( ShaderReflection & reflection )
+	{
+		if( !_valid || !_entry_point ) {
+			return false;
+		}
+		switch( _entry_point[ 1 ] ) {
+		case 0:		reflection.stage	= VK_SHADER_STAGE_VERTEX_BIT;					break;
+		case 1:		reflection.stage	= VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;		break;
+		case 2:		reflection.stage	= VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;	break;
+		case 3:		reflection.stage	= VK_SHADER_STAGE_GEOMETRY_BIT;					break;
+		case 4:		reflection.stage	= VK_SHADER_STAGE_FRAGMENT_BIT;					break;
+		case 5:		reflection.stage	= VK_SHADER_STAGE_COMPUTE_BIT;					break;
+		default:	return false;
+		}
+		if( _local_size ) {
+			reflection.local_size[ 0 ]	= _local_size[ 3 ];
+			reflection.local_size[ 1 ]	= _local_size[ 4 ];
+			reflection.local_size[ 2 ]	= _local_size[ 5 ];
+		}
+
+		bool success = true;
+		for( auto var : _variables ) {
+			auto pointer			= _Instruction( var[ 1 ] );
+			auto storage_class		= var[ 3 ];
+			auto &decorations		= _decorations[ var[ 2 ] ];
+			if( !pointer || ( pointer[ 0 ] & 0xffff ) != SPIRV_OP_TYPE_POINTER ) {
+				continue;
+			}
+			auto type_id			= pointer[ 3 ];
+
+			switch( storage_class ) {
+			case SPIRV_STORAGE_CLASS_INPUT:
+				if( reflection.stage == VK_SHADER_STAGE_VERTEX_BIT && !decorations.built_in && decorations.location >= 0 ) {
+					ShaderReflectionVertexInput input {};
+					input.location		= uint32_t( decorations.location );
+					input.format		= _VertexFormat( type_id, input.size );
+					success				&= input.format != VK_FORMAT_UNDEFINED;
+					reflection.vertex_inputs.push_back( input );
+				}
+				break;
+			case SPIRV_STORAGE_CLASS_PUSH_CONSTANT:
+				reflection.push_constant_size = std::max( reflection.push_constant_size, _Size( type_id, 0 ) );
+				break;
+			case SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT:
+			case SPIRV_STORAGE_CLASS_UNIFORM:
+			case SPIRV_STORAGE_CLASS_STORAGE_BUFFER:
+			{
+				if( decorations.binding < 0 ) {
+					break;
+				}
+				ShaderReflectionBinding b {};
+				b.set								= decorations.set >= 0 ? uint32_t( decorations.set ) : 0;
+				b.binding.binding					= uint32_t( decorations.binding );
+				b.binding.descriptorCount			= 1;
+				b.binding.stageFlags				= reflection.stage;
+				auto type							= _Instruction( type_id );
+				while( type && ( ( type[ 0 ] & 0xffff ) == SPIRV_OP_TYPE_ARRAY || ( type[ 0 ] & 0xffff ) == SPIRV_OP_TYPE_RUNTIME_ARRAY ) ) {
+					if( ( type[ 0 ] & 0xffff ) == SPIRV_OP_TYPE_ARRAY ) {
+						b.binding.descriptorCount	*= _ConstantValue( type[ 3 ] );
+					}
+					type_id							= type[ 2 ];
+					type							= _Instruction( type_id );
+				}
+				b.binding.descriptorType			= _DescriptorType( storage_class, type_id );
+				success								&= b.binding.descriptorType != VK_DESCRIPTOR_TYPE_MAX_ENUM;
+				reflection.bindings.push_back( b );
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		reflection.specialization_constant_ids = _specialization_constant_ids;
+		std::sort( reflection.specialization_constant_ids.begin(), reflection.specialization_constant_ids.end() );
+		std::sort( reflection.vertex_inputs.begin(), reflection.vertex_inputs.end(), []( const ShaderReflectionVertexInput & a, const ShaderReflectionVertexInput & b ) {
+			return a.location < b.location;
+		} );
+		std::sort( reflection.bindings.begin(), reflection.bindings.end(), []( const ShaderReflectionBinding & a, const ShaderReflectionBinding & b ) {
+			return a.set != b.set ? a.set < b.set : a.binding.binding < b.binding.binding;
+		} );
+		return success;
+	}
+
+private:
+	static uint64_t _MemberKey( uint32_t id, uint32_t member )
+	{
+		return ( uint64_t( id ) << 32 ) | member;
+	}
+
+	static void _Decorate( SPIRVDecorations & d, uint32_t decoration, uint32_t value )
+	{
+		switch( decoration ) {
+		case SPIRV_DECORATION_BLOCK:			d.block			= true;		break;
+		case SPIRV_DECORATION_BUFFER_BLOCK:		d.buffer_block	= true;		break;
+		case SPIRV_DECORATION_ARRAY_STRIDE:		d.array_stride	= value;	break;
+		case SPIRV_DECORATION_BUILT_IN:			d.built_in		= true;		break;
+		case SPIRV_DECORATION_LOCATION:			d.location		= value;	break;
+		case SPIRV_DECORATION_BINDING:			d.binding		= value;	break;
+		case SPIRV_DECORATION_DESCRIPTOR_SET:	d.set			= value;	break;
+		default:															break;
+		}
+	}
+
+	const uint32_t * _Instruction( uint32_t id ) const
+	{
+		return id < _bound ? _instructions[ id ] : nullptr;
+	}
+
+	uint32_t _ConstantValue( uint32_t id ) const
+	{
+		auto c = _Instruction( id );
+		if( !c || ( c[ 0 ] & 0xffff ) != SPIRV_OP_CONSTANT ) {
+			assert( 0 && "SPIR-V array length is not a plain constant." );
+			return 1;
+		}
+		return c[ 3 ];
+	}
+
+	// Size in bytes as laid out in a block, matrix_stride comes from the enclosing struct member.
+	uint32_t _Size( uint32_t type_id, uint32_t matrix_stride ) const
+	{
+		auto type = _Instruction( type_id );
+		if( !type ) {
+			return 0;
+		}
+		switch( type[ 0 ] & 0xffff ) {
+		case SPIRV_OP_TYPE_INT:
+		case SPIRV_OP_TYPE_FLOAT:
+			return type[ 2 ] / 8;
+		case SPIRV_OP_TYPE_VECTOR:
+			return type[ 3 ] * _Size( type[ 2 ], 0 );
+		case SPIRV_OP_TYPE_MATRIX:
+			return type[ 3 ] * ( matrix_stride ? matrix_stride : _Size( type[ 2 ], 0 ) );
+		case SPIRV_OP_TYPE_ARRAY:
+		{
+			auto stride = _decorations[ type_id ].array_stride;
+			return _ConstantValue( type[ 3 ] ) * ( stride ? stride : _Size( type[ 2 ], matrix_stride ) );
+		}
+		case SPIRV_OP_TYPE_STRUCT:
+		{
+			uint32_t size			= 0;
+			uint32_t member_count	= ( type[ 0 ] >> 16 ) - 2;
+			for( uint32_t m=0; m < member_count; ++m ) {
+				auto key		= _MemberKey( type_id, m );
+				auto offset		= _member_offsets.find( key );
+				auto stride		= _member_matrix_strides.find( key );
+				uint32_t member_offset	= offset != _member_offsets.end() ? offset->second : size;
+				uint32_t member_stride	= stride != _member_matrix_strides.end() ? stride->second : 0;
+				size = std::max( size, member_offset + _Size( type[ 2 + m ], member_stride ) );
+			}
+			return size;
+		}
+		default:
+			// runtime arrays and opaque types have no size
+			return 0;
+		}
+	}
+
+	VkFormat _VertexFormat( uint32_t type_id, uint32_t & size ) const
+	{
+		static const VkFormat formats[ 3 ][ 4 ] {
+			{ VK_FORMAT_R32_SFLOAT,	VK_FORMAT_R32G32_SFLOAT,	VK_FORMAT_R32G32B32_SFLOAT,	VK_FORMAT_R32G32B32A32_SFLOAT },
+			{ VK_FORMAT_R32_SINT,	VK_FORMAT_R32G32_SINT,		VK_FORMAT_R32G32B32_SINT,	VK_FORMAT_R32G32B32A32_SINT },
+			{ VK_FORMAT_R32_UINT,	VK_FORMAT_R32G32_UINT,		VK_FORMAT_R32G32B32_UINT,	VK_FORMAT_R32G32B32A32_UINT },
+		};
+		auto type				= _Instruction( type_id );
+		uint32_t components		= 1;
+		if( type && ( type[ 0 ] & 0xffff ) == SPIRV_OP_TYPE_VECTOR ) {
+			components			= type[ 3 ];
+			type				= _Instruction( type[ 2 ] );
+		}
+		size = 0;
+		if( !type || components < 1 || components > 4 || type[ 2 ] != 32 ) {
+			assert( 0 && "Unsupported vertex input type, only 32 bit scalars and vectors are." );
+			return VK_FORMAT_UNDEFINED;
+		}
+		size = components * 4;
+		switch( type[ 0 ] & 0xffff ) {
+		case SPIRV_OP_TYPE_FLOAT:	return formats[ 0 ][ components - 1 ];
+		case SPIRV_OP_TYPE_INT:		return formats[ type[ 3 ] ? 1 : 2 ][ components - 1 ];
+		default:
+			assert( 0 && "Unsupported vertex input type, only 32 bit scalars and vectors are." );
+			size = 0;
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkDescriptorType _DescriptorType( uint32_t storage_class, uint32_t type_id ) const
+	{
+		auto type = _Instruction( type_id );
+		if( !type ) {
+			return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+		}
+		if( storage_class == SPIRV_STORAGE_CLASS_STORAGE_BUFFER ) {
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		if( storage_class == SPIRV_STORAGE_CLASS_UNIFORM ) {
+			// older SPIR-V marks storage buffers with BufferBlock in the Uniform storage class
+			return _decorations[ type_id ].buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		}
+		switch( type[ 0 ] & 0xffff ) {
+		case SPIRV_OP_TYPE_SAMPLER:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case SPIRV_OP_TYPE_IMAGE:
+			// word 3 is the dimension, word 7 is 1 for sampled and 2 for storage images
+			if( type[ 3 ] == SPIRV_DIM_BUFFER ) {
+				return type[ 7 ] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			return type[ 7 ] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		default:
+			assert( 0 && "Unsupported descriptor type." );
+			return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+		}
+	}
+
+	uint32_t										_bound					= 0;
+	bool											_valid					= true;
+	const uint32_t								*	_entry_point			= nullptr;
+	const uint32_t								*	_local_size				= nullptr;
+	std::vector<const uint32_t*>					_instructions;			// types and constants by result id
+	std::vector<const uint32_t*>					_variables;
+	std::vector<SPIRVDecorations>					_decorations;
+	std::vector<uint32_t>							_specialization_constant_ids;
+	std::unordered_map<uint64_t, uint32_t>			_member_offsets;
+	std::unordered_map<uint64_t, uint32_t>			_member_matrix_strides;
+};
+
+bool ReflectSPIRV( const uint32_t * code, size_t word_count, ShaderReflection & reflection )
+{
+	reflection = ShaderReflection();
+	if( word_count < SPIRV_HEADER_WORDS ) {
+		return false;
+	}
+	SPIRVParser parser( code, word_count );
+	return parser.Reflect( reflection );
+}
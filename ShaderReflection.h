@@ -0,0 +1,34 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <vector>
+
+struct ShaderReflectionVertexInput
+{
+	uint32_t							location;
+	VkFormat							format;
+	uint32_t							size;				// bytes
+};
+
+struct ShaderReflectionBinding
+{
+	uint32_t							set;
+	VkDescriptorSetLayoutBinding		binding;			// stageFlags holds the reflected stage only
+};
+
+// Interface of a single shader entry point as declared in its SPIR-V.
+struct ShaderReflection
+{
+	VkShaderStageFlags							stage						= 0;
+	std::vector<ShaderReflectionVertexInput>	vertex_inputs;							// vertex stage only, sorted by location
+	std::vector<ShaderReflectionBinding>		bindings;								// sorted by set, then binding
+	uint32_t									push_constant_size			= 0;		// 0 if the stage has no push constants
+	std::vector<uint32_t>						specialization_constant_ids;			// constant_id of every specialization constant
+	uint32_t									local_size[ 3 ]				{ 1, 1, 1 };	// compute stage only
+};
+
+// Parses the SPIR-V binary of a single entry point module. Code must be validated SPIR-V,
+// see ShaderModuleCache. Returns false if the module uses something we can't describe.
+bool ReflectSPIRV( const uint32_t * code, size_t word_count, ShaderReflection & reflection );
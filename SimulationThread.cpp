@@ -0,0 +1,62 @@
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "SimulationThread.h"
+#include "Scene.h"
+
+SimulationThread::SimulationThread( Scene * scene, std::function<void( uint64_t frame )> simulate )
+{
+	_scene				= scene;
+	_simulate			= std::move( simulate );
+	_requested_frames	= 1;
+	_scene->SetManualSync( true );
+	_thread				= std::thread( &SimulationThread::_Loop, this );
+}
+
+SimulationThread::~SimulationThread()
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_quit			= true;
+	}
+	_condition.notify_all();
+	_thread.join();
+
+	// publish whatever the last simulated frame left behind
+	_scene->SyncState();
+	_scene->SetManualSync( false );
+}
+
+void SimulationThread::Sync()
+{
+	std::unique_lock<std::mutex> lock( _mutex );
+	_condition.wait( lock, [ this ]() { return _simulated_frames == _requested_frames; } );
+
+	// simulation thread is parked until the next request, the scene is ours
+	_scene->SyncState();
+
+	++_requested_frames;
+	lock.unlock();
+	_condition.notify_all();
+}
+
+void SimulationThread::_Loop()
+{
+	uint64_t frame = 0;
+	while( true ) {
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			_condition.wait( lock, [ this, frame ]() { return _quit || _requested_frames > frame; } );
+			if( _quit ) return;
+		}
+
+		_simulate( frame );
+
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_simulated_frames = ++frame;
+		}
+		_condition.notify_all();
+	}
+}
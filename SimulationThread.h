@@ -0,0 +1,43 @@
+#pragma once
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class Scene;
+
+// Runs the simulation of a scene one frame ahead of rendering. While the render thread
+// updates and records frame N the simulation thread already edits frame N + 1, the two
+// only meet in Sync where the finished simulation is copied to the render side of the scene.
+//
+// The simulate function may edit vertices, transforms and animation parameters and create or
+// destroy scene objects. Everything else, including Vulkan setup such as enabling compute
+// animation or indirect draw, belongs to the render thread.
+class SimulationThread
+{
+public:
+	// Simulation of the first frame starts right away.
+	SimulationThread( Scene * scene, std::function<void( uint64_t frame )> simulate );
+	~SimulationThread();
+
+	// Call on the render thread once per frame before Scene::Update. Waits for the simulation
+	// of the next frame, publishes it with Scene::SyncState and starts simulating the one after.
+	void								Sync();
+
+private:
+	void								_Loop();
+
+	Scene							*	_scene							= nullptr;
+	std::function<void( uint64_t )>		_simulate;
+	std::thread							_thread;
+
+	std::mutex							_mutex;
+	std::condition_variable				_condition;
+	uint64_t							_requested_frames				= 0;
+	uint64_t							_simulated_frames				= 0;
+	bool								_quit							= false;
+};
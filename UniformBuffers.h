@@ -1,6 +1,18 @@
 #pragma once
 
-struct UB_general
+#include "Matrix.h"
+
+// Layouts of uniform buffers and push constants shared with the shaders.
+
+// Per window camera, descriptor set 0 binding 0 of every graphics pipeline
+struct UB_Camera
+{
+	Matrix4			view;
+	Matrix4			projection;
+};
+
+// Per object push constants, vertex stage
+struct PC_Object
 {
-	float			test;
+	Matrix4			model;
 };
@@ -10,7 +10,7 @@
 void FindBufferMemoryType( Renderer * renderer, Buffer & buffer )
 {
 	auto &gpu_memory_properties = renderer->GetVulkanPhysicalDeviceMemoryProperties();
-	VkMemoryPropertyFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	VkMemoryPropertyFlags requirements_mask = buffer.memory_properties;
 	auto memory_type_bits = buffer.memory_requirements.memoryTypeBits;
 	for( uint32_t i = 0; i < gpu_memory_properties.memoryTypeCount; i++ ) {
 		if( ( memory_type_bits & 1 ) == 1 ) {
@@ -28,7 +28,8 @@ void FindBufferMemoryType( Renderer * renderer, Buffer & buffer )
 
 void AllocateBuffersMemory( Renderer * renderer, std::vector<Buffer>& buffers )
 {
-	auto device = renderer->GetVulkanDevice();
+	auto device					= renderer->GetVulkanDevice();
+	auto allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY );
 
 	for( auto &b : buffers ) {
 		vkGetBufferMemoryRequirements( device, b.buffer, &b.memory_requirements );
@@ -38,13 +39,14 @@ void AllocateBuffersMemory( Renderer * renderer, std::vector<Buffer>& buffers )
 		vertex_memory_allocate_info.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		vertex_memory_allocate_info.allocationSize		= b.memory_requirements.size;
 		vertex_memory_allocate_info.memoryTypeIndex		= b.memory_type_id;
-		ErrCheck( vkAllocateMemory( device, &vertex_memory_allocate_info, nullptr, &b.memory ) );
+		ErrCheck( vkAllocateMemory( device, &vertex_memory_allocate_info, allocation_callbacks, &b.memory ) );
 	}
 }
 
 void FreeBuffersMemory( Renderer * renderer, std::vector<Buffer>& buffers )
 {
+	auto allocation_callbacks	= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_DEVICE_MEMORY );
 	for( auto &b : buffers ) {
-		vkFreeMemory( renderer->GetVulkanDevice(), b.memory, nullptr );
+		vkFreeMemory( renderer->GetVulkanDevice(), b.memory, allocation_callbacks );
 	}
 }
@@ -7,28 +7,55 @@
 #include "Renderer.h"
 #include "Pipeline.h"
 #include "Scene.h"
+#include "VulkanTools.h"
+#include "FrameArena.h"
 
 #include <algorithm>
+#include <cmath>
 #include <assert.h>
 #include <iostream>
 #include <climits>
+#include <thread>
+#include <cstring>
+
+// a drag resize sends a stream of sizes, rebuild only once the size has stayed the same this long
+constexpr auto WINDOW_RESIZE_SETTLE_TIME		= std::chrono::milliseconds( 150 );
+// render scale changes snap to this, smaller changes aren't worth re-recording the scene for
+constexpr float WINDOW_RENDER_SCALE_STEP		= 0.05f;
+// frames to measure the new scale before the next change
+constexpr uint32_t WINDOW_RENDER_SCALE_COOLDOWN	= 30;
+// scale up only below this fraction of the target scene time, keeps the scale from oscillating
+constexpr double WINDOW_RENDER_SCALE_HEADROOM	= 0.85;
+// while minimized there is no image to render into, frames are skipped at this rate
+constexpr auto WINDOW_SKIPPED_FRAME_SLEEP		= std::chrono::milliseconds( 16 );
 //#include <filesystem>			// useful but not widely supported yet.
 
 Window::Window( Renderer * renderer, VkExtent2D dimensions, std::string window_name )
 {
-	_swapchain_image_count		= 2;			// 2 = double buffering, 3 = triple buffering
+	_swapchain_image_count		= 2;			// chosen by the present policy, see WindowPresentSettings
 	_renderer					= renderer;
 	_window_name				= window_name;
 	_device						= renderer->_device;
+	_allocation_callbacks		= renderer->GetVulkanAllocationCallbacks( HOST_ALLOCATION_CATEGORY_WINDOW );
 	_queue						= renderer->_queue;
 
 	_SubConstructor( dimensions );
+
+	// graph command buffers cycle with the frame arena regions
+	_render_graph				= new RenderGraph( _renderer, _frame_arena->GetFrameCount() );
+	_BuildRenderGraph();
 }
 
 
 Window::~Window()
 {
 	_SubDestructor();
+	delete _frame_capture;
+	_frame_capture				= nullptr;
+	delete _render_graph;
+	_render_graph				= nullptr;
+	delete _frame_arena;
+	_frame_arena				= nullptr;
 }
 
 void Window::_SubConstructor( VkExtent2D dimensions )
@@ -50,18 +77,27 @@ void Window::_SubConstructor( VkExtent2D dimensions )
 	_EndSetupCommandBuffer();
 	_ExecuteSetupCommandBuffer();
 
+	// survives resizes, frames in flight are bound by the swapchain image count at creation.
+	// Render commands keep one set per frame in flight.
+	_frame_arena				= new FrameArena( _renderer, _swapchain_image_count, 64 * 1024, 1024 * 1024 );
+
 	_CreateRenderCommands();
 
+	_CreateDescriptorSets();
+	_UpdateDescriptorSets();
 	_CreatePipelines();
 
-	ErrCheck( vkAcquireNextImageKHR( _device, _swapchain, UINT64_MAX, _present_image_available, VK_NULL_HANDLE, &_current_swapchain_image ) );
+	if( !_present_settings.late_acquire ) {
+		_AcquireImage();
+	}
 }
 
 void Window::_SubDestructor()
 {
-	vkQueueWaitIdle( _queue );
+	_renderer->WaitQueueIdle( QUEUE_TYPE_GRAPHICS );
 
 	_DestroyPipelines();
+	_DestroyDescriptorSets();
 
 	_DestroyRenderCommands();
 	_DestroyFrameBuffers();
@@ -77,6 +113,126 @@ void Window::_SubDestructor()
 void Window::Update()
 {
 	_UpdateOSWindow();
+	if( _resize_pending && std::chrono::steady_clock::now() - _resize_request_time >= WINDOW_RESIZE_SETTLE_TIME ) {
+		_resize_pending		= false;
+		_RecreateSwapchain( _requested_size );
+	}
+}
+
+void Window::_RequestResize( VkExtent2D size )
+{
+	bool same_as_current	= size.width == _surface_size.width && size.height == _surface_size.height;
+	bool same_as_requested	= _resize_pending && size.width == _requested_size.width && size.height == _requested_size.height;
+	if( same_as_requested ) return;
+	if( same_as_current ) {
+		// dragged back to where we started
+		_resize_pending		= false;
+		return;
+	}
+	_requested_size			= size;
+	_resize_request_time	= std::chrono::steady_clock::now();
+	_resize_pending			= true;
+}
+
+void Window::_RecreateSwapchain( VkExtent2D size )
+{
+	// minimized, keep the old swapchain until we are visible again
+	if( 0 == size.width || 0 == size.height ) return;
+
+	// waits for the queue and releases the acquired image
+	_DestroyRenderCommands();
+	_DestroyFrameBuffers();
+	_DestroyDepthBuffer();
+	_DestroySwapchainImages();
+
+	_surface_size		= size;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR( _renderer->_gpu, _surface, &_surface_capabilities );
+
+	_BeginSetupCommandBuffer();
+	_CreateSwapchain();				// replaces the old swapchain through oldSwapchain
+	_CreateSwapchainImages();
+	_CreateDepthBuffer();
+	_CreateFrameBuffers();
+	_EndSetupCommandBuffer();
+	_ExecuteSetupCommandBuffer();
+
+	_CreateRenderCommands();
+	_BuildRenderGraph();
+
+	if( !_present_settings.late_acquire ) {
+		_AcquireImage();
+	}
+	_scene_commands_out_of_date	= true;
+}
+
+bool Window::_AcquireImage()
+{
+	// short enough to stay responsive, long enough not to spin
+	constexpr uint64_t LATE_ACQUIRE_TIMEOUT_NS	= 1000 * 1000;
+
+	uint64_t timeout		= _present_settings.late_acquire ? LATE_ACQUIRE_TIMEOUT_NS : UINT64_MAX;
+	while( true ) {
+		// signals the semaphore of the frame that renders into the image
+		VkResult result		= vkAcquireNextImageKHR( _device, _swapchain, timeout, _image_available[ _frame_arena->GetFrameIndex() ], VK_NULL_HANDLE, &_current_swapchain_image );
+		switch( result ) {
+		case VK_SUCCESS:
+		case VK_SUBOPTIMAL_KHR:
+			_image_acquired		= true;
+			return true;
+		case VK_TIMEOUT:
+		case VK_NOT_READY:
+			// every image is still queued for presentation
+			_UpdateOSWindow();
+			break;
+		case VK_ERROR_OUT_OF_DATE_KHR:
+			return false;
+		default:
+			ErrCheck( result );
+			return false;
+		}
+	}
+}
+
+bool Window::_EnsureImageAcquired()
+{
+	if( _image_acquired ) return true;
+	if( _AcquireImage() ) return true;
+
+	// nothing to render into, can't wait for the resize to settle
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR( _renderer->_gpu, _surface, &_surface_capabilities );
+	_resize_pending		= false;
+	_RecreateSwapchain( _surface_capabilities.currentExtent );
+	// a minimized window keeps the out of date swapchain, acquiring fails until it's visible again
+	return _image_acquired || _AcquireImage();
+}
+
+void Window::_SkipFrame()
+{
+	// uploads of this frame still have to land, later frames only upload what changed
+	VkCommandBuffer command_buffer				= _render_command_buffers[ _frame_arena->GetFrameIndex() ];
+	VkCommandBufferBeginInfo command_buffer_begin_info {};
+	command_buffer_begin_info.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	command_buffer_begin_info.flags				= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	ErrCheck( vkBeginCommandBuffer( command_buffer, &command_buffer_begin_info ) );
+	_UploadCamera();
+	_frame_arena->CmdCopyUploads( command_buffer );
+	ErrCheck( vkEndCommandBuffer( command_buffer ) );
+
+	// waits added for this frame are consumed anyway, their producers signal them again next frame
+	VkSubmitInfo submit_info {};
+	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount	= 1;
+	submit_info.pCommandBuffers		= &command_buffer;
+	submit_info.waitSemaphoreCount	= uint32_t( _render_wait_semaphores.size() );
+	submit_info.pWaitSemaphores		= _render_wait_semaphores.data();
+	submit_info.pWaitDstStageMask	= _render_wait_stages.data();
+	_renderer->Submit( QUEUE_TYPE_GRAPHICS, submit_info, _frame_arena->GetFrameFence() );
+	_render_wait_semaphores.clear();
+	_render_wait_stages.clear();
+
+	// frame lists may have been allocated already
+	_frame_arena->NextFrame();
+	std::this_thread::sleep_for( WINDOW_SKIPPED_FRAME_SLEEP );
 }
 
 void Window::Close()
@@ -86,108 +242,89 @@ void Window::Close()
 
 void Window::Render( const std::vector<VkCommandBuffer> & command_buffers )
 {
-	// Trying 2 pipeline barriers inside one command buffer
-	// This seems to work pretty well on my system
+	if( !_BeginFrame() ) return;
+	_Render( nullptr, 0, command_buffers.data(), uint32_t( command_buffers.size() ) );
+}
+
+void Window::Render( const std::vector<VkCommandBuffer> & pre_render_command_buffers, const std::vector<VkCommandBuffer> & command_buffers )
+{
+	if( !_BeginFrame() ) return;
+	_Render( pre_render_command_buffers.data(), uint32_t( pre_render_command_buffers.size() ), command_buffers.data(), uint32_t( command_buffers.size() ) );
+}
+
+bool Window::_BeginFrame()
+{
+	// nothing is recorded for a frame that has no image to render into
+	if( !_EnsureImageAcquired() ) {
+		_SkipFrame();
+		return false;
+	}
+
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	// before the command buffer is reset and overwrites the queries of this frame, and before
+	// anything is collected so a new render scale reaches the command buffers of this frame
+	_ReadTimestamps();
+	_UpdateRenderScale();
+#endif
+	return true;
+}
+
+void Window::_Render( const VkCommandBuffer * pre_render_command_buffers, uint32_t pre_render_command_buffer_count, const VkCommandBuffer * command_buffers, uint32_t command_buffer_count )
+{
+	if( _frame_capture ) {
+		_frame_capture->Update();
+		_frame_capture->BeginFrame();
+	}
+
+	// NextFrame waited for the last frame that used these
+	uint32_t frame								= _frame_arena->GetFrameIndex();
+	VkCommandBuffer command_buffer				= _render_command_buffers[ frame ];
+
 	VkCommandBufferBeginInfo command_buffer_begin_info {};
 	command_buffer_begin_info.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	command_buffer_begin_info.flags				= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	ErrCheck( vkBeginCommandBuffer( _render_command_buffers[ _current_swapchain_image ], &command_buffer_begin_info ) );
-
-	{
-		// memory barrier to transfer image from presentable to writeable
-		VkImageMemoryBarrier image_barrier {};
-		image_barrier.sType						= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		image_barrier.image						= _swapchain_images[ _current_swapchain_image ];
-		image_barrier.oldLayout					= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		image_barrier.newLayout					= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		image_barrier.srcAccessMask				= VK_ACCESS_MEMORY_READ_BIT;
-		image_barrier.dstAccessMask				= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		image_barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-		image_barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-		image_barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
-		image_barrier.subresourceRange.layerCount		= 1;
-		image_barrier.subresourceRange.levelCount		= 1;
-		image_barrier.subresourceRange.baseArrayLayer	= 0;
-		image_barrier.subresourceRange.baseMipLevel		= 0;
-
-		vkCmdPipelineBarrier(
-			_render_command_buffers[ _current_swapchain_image ],
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &image_barrier );
-	}
-
-	VkRect2D render_area;
-	render_area.offset.x		= 0;
-	render_area.offset.y		= 0;
-	render_area.extent			= _surface_size;
-
-	VkClearValue clear_values[ 2 ];
-	clear_values[ 0 ].depthStencil.depth	= 1.0f;
-	clear_values[ 0 ].depthStencil.stencil	= 0;
-	clear_values[ 1 ].color.float32[ 0 ]	= 0.10f;
-	clear_values[ 1 ].color.float32[ 1 ]	= 0.15f;
-	clear_values[ 1 ].color.float32[ 2 ]	= 0.20f;
-	clear_values[ 1 ].color.float32[ 3 ]	= 1.0f;
-
-	VkRenderPassBeginInfo begin_info {};
-	begin_info.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	begin_info.renderPass		= _render_pass;
-	begin_info.framebuffer		= _framebuffers[ _current_swapchain_image ];
-	begin_info.renderArea		= render_area;
-	begin_info.clearValueCount	= 2;
-	begin_info.pClearValues		= clear_values;
-	vkCmdBeginRenderPass( _render_command_buffers[ _current_swapchain_image ], &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
-	// objects render here
-
-	vkCmdExecuteCommands( _render_command_buffers[ _current_swapchain_image ], command_buffers.size(), command_buffers.data() );
-	vkCmdEndRenderPass( _render_command_buffers[ _current_swapchain_image ] );
-
-	{
-		// memory barrier to transfer image from writeable to presentable
-		VkImageMemoryBarrier image_barrier {};
-		image_barrier.sType						= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		image_barrier.image						= _swapchain_images[ _current_swapchain_image ];
-		image_barrier.oldLayout					= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		image_barrier.newLayout					= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		image_barrier.srcAccessMask				= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		image_barrier.dstAccessMask				= VK_ACCESS_MEMORY_READ_BIT;
-		image_barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-		image_barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-		image_barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
-		image_barrier.subresourceRange.layerCount		= 1;
-		image_barrier.subresourceRange.levelCount		= 1;
-		image_barrier.subresourceRange.baseArrayLayer	= 0;
-		image_barrier.subresourceRange.baseMipLevel		= 0;
-
-		vkCmdPipelineBarrier(
-			_render_command_buffers[ _current_swapchain_image ],
-			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &image_barrier );
-	}
-
-	ErrCheck( vkEndCommandBuffer( _render_command_buffers[ _current_swapchain_image ] ) );
-
-	VkPipelineStageFlags stage_flags[] { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	ErrCheck( vkBeginCommandBuffer( command_buffer, &command_buffer_begin_info ) );
+
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	_CmdBeginTimestamps( command_buffer );
+#endif
+
+	// picked up by the passes, see _BuildRenderGraph
+	_graph_pre_render_command_buffers			= pre_render_command_buffers;
+	_graph_pre_render_command_buffer_count		= pre_render_command_buffer_count;
+	_graph_command_buffers						= command_buffers;
+	_graph_command_buffer_count					= command_buffer_count;
+	_UploadCamera();
+	_render_graph->SetImportedImage( _graph_swapchain_image, _swapchain_images[ _current_swapchain_image ], _swapchain_image_views[ _current_swapchain_image ] );
+	_render_graph->SetRenderArea( _graph_scene_pass, _render_size );
+	_render_graph->Execute( command_buffer );
+
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	_CmdWriteTimestamp( command_buffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, WINDOW_TIMESTAMP_VERTEX_END );
+	_CmdWriteTimestamp( command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, WINDOW_TIMESTAMP_FRAME_END );
+#endif
+
+	ErrCheck( vkEndCommandBuffer( command_buffer ) );
+
+	// swapchain image first, then whatever other queues produced for this frame.
+	// Only the first pass writing the image waits for it, color output or the upscale,
+	// everything before runs meanwhile.
+	_render_wait_semaphores.insert( _render_wait_semaphores.begin(), _image_available[ frame ] );
+	_render_wait_stages.insert( _render_wait_stages.begin(), _render_graph->GetFirstUseStages( _graph_swapchain_image ) );
 	VkSubmitInfo submit_info {};
 	submit_info.sType					= VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount		= 1;
-	submit_info.pCommandBuffers			= &_render_command_buffers[ _current_swapchain_image ];
-	submit_info.waitSemaphoreCount		= 1;
-	submit_info.pWaitSemaphores			= &_present_image_available;
-	submit_info.pWaitDstStageMask		= stage_flags;
+	submit_info.pCommandBuffers			= &command_buffer;
+	submit_info.waitSemaphoreCount		= uint32_t( _render_wait_semaphores.size() );
+	submit_info.pWaitSemaphores			= _render_wait_semaphores.data();
+	submit_info.pWaitDstStageMask		= _render_wait_stages.data();
 	submit_info.signalSemaphoreCount	= 1;
 	submit_info.pSignalSemaphores		= &_render_complete[ _current_swapchain_image ];
 
-	ErrCheck( vkQueueSubmit( _queue, 1, &submit_info, VK_NULL_HANDLE ) );
+	_renderer->Submit( QUEUE_TYPE_GRAPHICS, submit_info, _frame_arena->GetFrameFence() );
+	_render_wait_semaphores.clear();
+	_render_wait_stages.clear();
 
 	VkPresentInfoKHR present_info {};
 	present_info.sType					= VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -196,21 +333,39 @@ void Window::Render( const std::vector<VkCommandBuffer> & command_buffers )
 	present_info.pImageIndices			= &_current_swapchain_image;
 	present_info.waitSemaphoreCount		= 1;
 	present_info.pWaitSemaphores		= &_render_complete[ _current_swapchain_image ];
-	ErrCheck( vkQueuePresentKHR( _queue, &present_info ) );
-
-	ErrCheck( vkAcquireNextImageKHR( _device, _swapchain, UINT64_MAX, _present_image_available, VK_NULL_HANDLE, &_current_swapchain_image ) );
+	// out of date swapchains are replaced below or by the pending resize
+	VkResult present_result		= _renderer->Present( present_info );
+	if( VK_ERROR_OUT_OF_DATE_KHR != present_result ) {
+		ErrCheck( present_result );
+	}
 
-	// really simple syncronization, replace with something more sophisticated later
-	vkQueueWaitIdle( _queue );
+	// No queue wait, NextFrame waits for the fence of the frame that last used the next region.
+	// Its command buffers, acquire semaphore, timestamps and ring memory are free after that.
+	// Late acquire waits until the next frame has been simulated and updated.
+	_frame_arena->NextFrame();
+	_image_acquired				= false;
+	if( !_present_settings.late_acquire ) {
+		_EnsureImageAcquired();
+	}
+	_PaceFrame();
 }
 
 void Window::RenderScene( const Scene * scene, bool force_recalculate )
 {
-	std::vector<VkCommandBuffer> render_command_buffers;
+	// lists are rebuilt every frame, keep them off the heap
+	FrameVector<VkCommandBuffer> pre_render_command_buffers { FrameArenaAllocator<VkCommandBuffer>( _frame_arena ) };
+	FrameVector<VkCommandBuffer> render_command_buffers { FrameArenaAllocator<VkCommandBuffer>( _frame_arena ) };
+
+	if( !_BeginFrame() ) return;
+
+	// secondary command buffers continue our render pass and set the viewport to the render size
+	force_recalculate			= force_recalculate || _scene_commands_out_of_date;
+	_scene_commands_out_of_date	= false;
 
 	// do a recursive search on the scene and find all objects
+	scene->CollectPreRenderCommandBuffers_Recursive( pre_render_command_buffers, force_recalculate );
 	scene->CollectCommandBuffers_Recursive( render_command_buffers, force_recalculate );
-	Render( render_command_buffers );
+	_Render( pre_render_command_buffers.data(), uint32_t( pre_render_command_buffers.size() ), render_command_buffers.data(), uint32_t( render_command_buffers.size() ) );
 }
 
 VkExtent2D Window::GetSize()
@@ -233,6 +388,12 @@ Pipeline * Window::FindPipeline( std::string name )
 	return nullptr;
 }
 
+void Window::AddRenderWait( VkSemaphore semaphore, VkPipelineStageFlags stage )
+{
+	_render_wait_semaphores.push_back( semaphore );
+	_render_wait_stages.push_back( stage );
+}
+
 VkRenderPass Window::GetRenderPass()
 {
 	return _render_pass;
@@ -250,10 +411,83 @@ uint32_t Window::GetCurrentFrameBufferIndex()
 
 void Window::Resize( VkExtent2D size )
 {
-	_SubDestructor();
-	_SubConstructor( size );
+	_ResizeOSWindow( size );
+	_resize_pending		= false;
+	_RecreateSwapchain( size );
+}
+
+
+void Window::SetCamera( const Matrix4 & view, const Matrix4 & projection )
+{
+	_camera.view			= view;
+	_camera.projection		= projection;
+	// copied into the uniform buffer by the next frame, frames in flight keep reading theirs
+	_camera_dirty			= true;
+}
+
+void Window::_UploadCamera()
+{
+	if( !_camera_dirty ) return;
+	void * data = _frame_arena->AllocateUpload( _camera_buffers[ 0 ].buffer, 0, sizeof( UB_Camera ) );
+	if( nullptr == data ) return;
+	std::memcpy( data, &_camera, sizeof( UB_Camera ) );
+	_camera_dirty			= false;
+}
+
+const UB_Camera & Window::GetCamera() const
+{
+	return _camera;
+}
+
+FrameArena * Window::GetFrameArena()
+{
+	return _frame_arena;
+}
+
+const RenderGraph * Window::GetRenderGraph() const
+{
+	return _render_graph;
 }
 
+bool Window::StartCapture( const FrameCaptureSettings & settings, FrameCaptureCallback callback )
+{
+	if( !_IsCaptureSupported() ) {
+		return false;
+	}
+
+	// the swapchain already has transfer source usage, only the graph changes
+	_frame_arena->WaitFrames();
+	delete _frame_capture;
+	_frame_capture		= new FrameCapture( _renderer, _frame_arena, settings, callback );
+	_BuildRenderGraph();
+	return true;
+}
+
+void Window::StopCapture()
+{
+	if( !_frame_capture ) return;
+
+	_frame_arena->WaitFrames();
+	delete _frame_capture;
+	_frame_capture		= nullptr;
+	_BuildRenderGraph();
+}
+
+bool Window::_IsCaptureSupported() const
+{
+	return ( _surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT ) &&
+		0 != FrameCapture::GetTexelSize( _color_format );
+}
+
+const FrameCapture * Window::GetFrameCapture() const
+{
+	return _frame_capture;
+}
+
+VkDescriptorSet Window::GetVulkanDescriptorSet()
+{
+	return _descriptor_set;
+}
 
 void Window::_CreateSetupCommandPool()
 {
@@ -262,13 +496,13 @@ void Window::_CreateSetupCommandPool()
 	command_pool_create_info.queueFamilyIndex	= _renderer->_render_queue_family_index;
 	command_pool_create_info.flags				= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-	ErrCheck( vkCreateCommandPool( _renderer->_device, &command_pool_create_info, nullptr, &_setup_command_pool ) );
+	ErrCheck( vkCreateCommandPool( _renderer->_device, &command_pool_create_info, _allocation_callbacks, &_setup_command_pool ) );
 	assert( _setup_command_pool );
 }
 
 void Window::_DestroySetupCommandPool()
 {
-	vkDestroyCommandPool( _renderer->_device, _setup_command_pool, nullptr );
+	vkDestroyCommandPool( _renderer->_device, _setup_command_pool, _allocation_callbacks );
 }
 
 void Window::_AllocateSetupCommandBuffer()
@@ -302,14 +536,14 @@ void Window::_ExecuteSetupCommandBuffer()
 	fence_create_info.sType			= VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
 	VkFence fence					= VK_NULL_HANDLE;
-	vkCreateFence( _device, &fence_create_info, nullptr, &fence );
+	vkCreateFence( _device, &fence_create_info, _allocation_callbacks, &fence );
 
 	VkSubmitInfo submit_info {};
 	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount	= 1;
 	submit_info.pCommandBuffers		= &_setup_command_buffer;
 
-	vkQueueSubmit( _renderer->_queue, 1, &submit_info, fence );
+	_renderer->Submit( QUEUE_TYPE_GRAPHICS, submit_info, fence );
 
 	VkResult err = vkWaitForFences( _device, 1, &fence, true, UINT64_MAX );
 	if( VK_TIMEOUT == err ) {
@@ -317,7 +551,7 @@ void Window::_ExecuteSetupCommandBuffer()
 		std::exit( -1 );
 	}
 
-	vkDestroyFence( _device, fence, nullptr );
+	vkDestroyFence( _device, fence, _allocation_callbacks );
 }
 
 
@@ -337,6 +571,7 @@ void Window::_CreateSurface()
 		} else {
 			_surface_format					= format_list[ 0 ];
 		}
+		_color_format						= _surface_format.format;
 	}
 	ErrCheck( vkGetPhysicalDeviceSurfaceSupportKHR( _renderer->_gpu, _renderer->_render_queue_family_index, _surface, &_WSI_supported ) );
 	if( !_WSI_supported ) {
@@ -347,15 +582,12 @@ void Window::_CreateSurface()
 
 void Window::_DestroySurface()
 {
-	vkDestroySurfaceKHR( _renderer->_instance, _surface, nullptr );
+	vkDestroySurfaceKHR( _renderer->_instance, _surface, _allocation_callbacks );
 	_surface = VK_NULL_HANDLE;
 }
 
 void Window::_CreateSwapchain()
 {
-	// select swapchain image amount
-	_swapchain_image_count			= std::min( std::max( _swapchain_image_count, _surface_capabilities.minImageCount + 1 ), _surface_capabilities.maxImageCount );
-
 	// make sure that the swapchain images and the surface area match in size
 	// checking only width is enough
 	if( _surface_capabilities.currentExtent.width < UINT32_MAX ) {
@@ -363,22 +595,62 @@ void Window::_CreateSwapchain()
 		_surface_size.height		= _surface_capabilities.currentExtent.height;
 	}
 
-	// select present mode ( also v-sync ). FIFO is always available, if we need to, we can always fall back to that
+	// select present mode ( also v-sync ) by policy preference. FIFO is always available, if we need to, we can always fall back to that
+	VkPresentModeKHR preferences[ 2 ] { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR };
+	switch( _present_settings.policy ) {
+	case WINDOW_PRESENT_POLICY_LOW_LATENCY:
+		preferences[ 0 ]			= VK_PRESENT_MODE_MAILBOX_KHR;
+		preferences[ 1 ]			= VK_PRESENT_MODE_IMMEDIATE_KHR;
+		break;
+	case WINDOW_PRESENT_POLICY_UNCAPPED:
+		preferences[ 0 ]			= VK_PRESENT_MODE_IMMEDIATE_KHR;
+		preferences[ 1 ]			= VK_PRESENT_MODE_MAILBOX_KHR;
+		break;
+	default:
+		break;
+	}
 	VkPresentModeKHR present_mode		= VK_PRESENT_MODE_FIFO_KHR;
 	{
 		uint32_t present_mode_count = 0;
 		vkGetPhysicalDeviceSurfacePresentModesKHR( _renderer->_gpu, _surface, &present_mode_count, nullptr );
 		std::vector<VkPresentModeKHR> present_mode_list( present_mode_count );
 		vkGetPhysicalDeviceSurfacePresentModesKHR( _renderer->_gpu, _surface, &present_mode_count, present_mode_list.data() );
-		uint32_t aflags = 0;
-		for( auto i : present_mode_list ) {
-			if( i == VK_PRESENT_MODE_MAILBOX_KHR )		aflags |= 1;
-			if( i == VK_PRESENT_MODE_IMMEDIATE_KHR )	aflags |= 2;
+		for( int32_t p=1; p >= 0; --p ) {
+			if( std::find( present_mode_list.begin(), present_mode_list.end(), preferences[ p ] ) != present_mode_list.end() ) {
+				present_mode		= preferences[ p ];
+			}
 		}
-		if		( aflags & 1 )		present_mode		= VK_PRESENT_MODE_MAILBOX_KHR;
-		else if	( aflags & 2 )		present_mode		= VK_PRESENT_MODE_IMMEDIATE_KHR;
 	}
 
+	// select swapchain image amount, mailbox and throughput want one image more than the minimum
+	uint32_t image_count				= _present_settings.image_count;
+	if( 0 == image_count ) {
+		bool extra_image				= VK_PRESENT_MODE_MAILBOX_KHR == present_mode || WINDOW_PRESENT_POLICY_VSYNC == _present_settings.policy;
+		image_count						= _surface_capabilities.minImageCount + ( extra_image ? 1 : 0 );
+	}
+	image_count							= std::max( image_count, std::max( _surface_capabilities.minImageCount, 2u ) );
+	if( _surface_capabilities.maxImageCount ) {
+		image_count						= std::min( image_count, _surface_capabilities.maxImageCount );
+	}
+	_swapchain_image_count				= image_count;
+
+	// the offscreen scene is blitted into the swapchain image
+	{
+		VkFormatProperties format_properties {};
+		vkGetPhysicalDeviceFormatProperties( _renderer->_gpu, _color_format, &format_properties );
+		VkFormatFeatureFlags blit_features	= VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		_dynamic_resolution				= BUILD_ENABLE_GPU_TIMESTAMPS && _resolution_settings.dynamic &&
+			( format_properties.optimalTilingFeatures & blit_features ) == blit_features &&
+			( _surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT );
+		// linear blits are an extra feature of the source format
+		_upscale_filter					= ( format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	}
+	_UpdateRenderSize();
+
+	_present_report.requested					= _present_settings;
+	_present_report.requested_present_mode		= preferences[ 0 ];
+	_present_report.present_mode				= present_mode;
+
 	VkSwapchainCreateInfoKHR create_info {};
 	create_info.sType					= VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	create_info.surface					= _surface;
@@ -391,17 +663,198 @@ void Window::_CreateSwapchain()
 	create_info.presentMode				= present_mode;
 	create_info.clipped					= true;
 	create_info.imageColorSpace			= _surface_format.colorSpace;
-	create_info.imageUsage				= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;// | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	create_info.imageUsage				= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+		( _dynamic_resolution ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0 ) |
+		( _IsCaptureSupported() ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0 );		// captures start without recreating the swapchain
 	create_info.imageSharingMode		= VK_SHARING_MODE_EXCLUSIVE;
 	create_info.queueFamilyIndexCount	= 0;
 	create_info.pQueueFamilyIndices		= nullptr;
+	create_info.oldSwapchain			= _swapchain;
+
+	// on resize the old swapchain is retired by the new one, images already presented stay valid until then
+	VkSwapchainKHR old_swapchain		= _swapchain;
+	ErrCheck( vkCreateSwapchainKHR( _renderer->_device, &create_info, _allocation_callbacks, &_swapchain ) );
+	if( VK_NULL_HANDLE != old_swapchain ) {
+		vkDestroySwapchainKHR( _renderer->_device, old_swapchain, _allocation_callbacks );
+	}
+}
+
+void Window::SetPresentSettings( const WindowPresentSettings & settings )
+{
+	_present_settings	= settings;
+	_resize_pending		= false;
+	_RecreateSwapchain( _surface_size );
+}
+
+const WindowPresentReport & Window::GetPresentReport() const
+{
+	return _present_report;
+}
+
+void Window::PrintPresentReport( std::ostream & stream ) const
+{
+	auto mode_name = []( VkPresentModeKHR mode ) -> const char * {
+		switch( mode ) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:		return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR:		return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR:			return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR:	return "fifo relaxed";
+		default:								return "unknown";
+		}
+	};
+	const char * policy_names[] { "low latency", "vsync", "power saving", "uncapped" };
+	auto &r = _present_report;
+	stream << "Window \"" << _window_name << "\": " << policy_names[ r.requested.policy ]
+		<< ", present mode " << mode_name( r.present_mode ) << " (wanted " << mode_name( r.requested_present_mode ) << ")"
+		<< ", " << r.image_count << " images";
+	if( r.requested.image_count ) stream << " (wanted " << r.requested.image_count << ")";
+	if( r.frame_rate_limit > 0.0f ) {
+		stream << ", limited to " << r.frame_rate_limit << " fps";
+	} else {
+		stream << ", no frame limit";
+	}
+	stream << ", measured " << r.present_interval_ms << " ms per present\n";
+}
+
+const WindowGpuTimings & Window::GetGpuTimings() const
+{
+	return _gpu_timings;
+}
 
-	ErrCheck( vkCreateSwapchainKHR( _renderer->_device, &create_info, nullptr, &_swapchain ) );
+void Window::PrintGpuTimings( std::ostream & stream ) const
+{
+	auto &t = _gpu_timings;
+	if( !BUILD_ENABLE_GPU_TIMESTAMPS || !t.available ) {
+		stream << "Window \"" << _window_name << "\": no GPU timings\n";
+		return;
+	}
+	stream << "Window \"" << _window_name << "\": GPU pre render " << t.pre_render_ms
+		<< " ms, vertex " << t.vertex_ms
+		<< " ms, scene " << t.scene_ms
+		<< " ms, frame " << t.frame_ms << " ms";
+	if( _dynamic_resolution ) {
+		stream << ", rendering at " << _render_size.width << "x" << _render_size.height << " (scale " << _render_scale << ")";
+	}
+	stream << "\n";
+}
+
+void Window::SetResolutionSettings( const WindowResolutionSettings & settings )
+{
+	_resolution_settings			= settings;
+	_resolution_settings.max_scale	= std::min( std::max( settings.max_scale, 0.1f ), 1.0f );
+	_resolution_settings.min_scale	= std::min( std::max( settings.min_scale, 0.1f ), _resolution_settings.max_scale );
+	_render_scale					= _resolution_settings.max_scale;
+	_render_scale_cooldown			= WINDOW_RENDER_SCALE_COOLDOWN;
+	_resize_pending					= false;
+	_RecreateSwapchain( _surface_size );
+}
+
+float Window::GetRenderScale() const
+{
+	return _render_scale;
+}
+
+VkExtent2D Window::GetRenderSize() const
+{
+	return _render_size;
+}
+
+void Window::_UpdateRenderScale()
+{
+	if( !_dynamic_resolution || _gpu_timings.scene_ms <= 0.0 ) return;
+	if( _render_scale_cooldown ) {
+		--_render_scale_cooldown;
+		return;
+	}
+
+	double target_ms		= _resolution_settings.target_gpu_time_ms;
+	if( target_ms <= 0.0 ) {
+		float frame_rate	= _present_report.frame_rate_limit > 0.0f ? _present_report.frame_rate_limit : 60.0f;
+		target_ms			= 0.9 * 1000.0 / frame_rate;
+	}
+
+	// scene time follows the pixel count, the scale is per axis
+	float wanted			= float( _render_scale * std::sqrt( target_ms / _gpu_timings.scene_ms ) );
+	wanted					= std::round( wanted / WINDOW_RENDER_SCALE_STEP ) * WINDOW_RENDER_SCALE_STEP;
+	wanted					= std::min( std::max( wanted, _resolution_settings.min_scale ), _resolution_settings.max_scale );
+
+	bool scale_down			= wanted < _render_scale - WINDOW_RENDER_SCALE_STEP * 0.5f;
+	bool scale_up			= wanted > _render_scale + WINDOW_RENDER_SCALE_STEP * 0.5f &&
+		_gpu_timings.scene_ms < target_ms * WINDOW_RENDER_SCALE_HEADROOM;
+	if( !scale_down && !scale_up ) return;
+
+	_render_scale				= wanted;
+	_render_scale_cooldown		= WINDOW_RENDER_SCALE_COOLDOWN;
+	_UpdateRenderSize();
+	// viewports of the scene command buffers
+	_scene_commands_out_of_date	= true;
+	// measurements of the old scale would drive the next change
+	_gpu_timings.scene_ms		= 0.0;
+}
+
+void Window::_UpdateRenderSize()
+{
+	if( !_dynamic_resolution ) {
+		_render_scale		= 1.0f;
+	}
+	_render_size.width		= std::max( uint32_t( _surface_size.width * _render_scale + 0.5f ), 1u );
+	_render_size.height		= std::max( uint32_t( _surface_size.height * _render_scale + 0.5f ), 1u );
+	_render_size.width		= std::min( _render_size.width, _surface_size.width );
+	_render_size.height		= std::min( _render_size.height, _surface_size.height );
+}
+
+void Window::_PaceFrame()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	// smoothed present interval, the first frame has nothing to compare against
+	if( _last_present_time.time_since_epoch().count() ) {
+		double interval_ms					= std::chrono::duration<double, std::milli>( now - _last_present_time ).count();
+		_present_report.present_interval_ms	= _present_report.present_interval_ms > 0.0
+			? _present_report.present_interval_ms * 0.9 + interval_ms * 0.1
+			: interval_ms;
+	}
+	_last_present_time	= now;
+
+	// limiter target, explicit setting first
+	float limit			= _present_settings.frame_rate_limit;
+	if( 0.0f == limit ) {
+		switch( _present_settings.policy ) {
+		case WINDOW_PRESENT_POLICY_POWER_SAVING:
+			limit		= 30.0f;
+			break;
+		default:
+			break;
+		}
+	}
+	_present_report.frame_rate_limit		= limit > 0.0f ? limit : 0.0f;
+
+	if( limit <= 0.0f ) {
+		_next_frame_time	= now;
+		return;
+	}
+
+	// deadlines advance by whole intervals from the measured present so sleep overshoot doesn't
+	// accumulate, a frame that ran over by more than an interval restarts the schedule instead
+	// of rushing to catch up
+	auto step			= std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( 1.0 / limit ) );
+	_next_frame_time	+= step;
+	if( _next_frame_time < now - step || _next_frame_time > now + step ) {
+		_next_frame_time	= now + step;
+	}
+	// sleep is coarse on most systems, spin for the last millisecond
+	auto spin_threshold	= std::chrono::milliseconds( 1 );
+	if( _next_frame_time - now > spin_threshold ) {
+		std::this_thread::sleep_for( _next_frame_time - now - spin_threshold );
+	}
+	while( std::chrono::steady_clock::now() < _next_frame_time ) {
+		std::this_thread::yield();
+	}
 }
 
 void Window::_DestroySwapchain()
 {
-	vkDestroySwapchainKHR( _renderer->_device, _swapchain, nullptr );
+	vkDestroySwapchainKHR( _renderer->_device, _swapchain, _allocation_callbacks );
 	_swapchain = VK_NULL_HANDLE;
 }
 
@@ -414,6 +867,9 @@ void Window::_CreateSwapchainImages()
 		_swapchain_image_views.resize( swapchain_image_count );
 		vkGetSwapchainImagesKHR( _renderer->_device, _swapchain, &swapchain_image_count, _swapchain_images.data() );
 		assert( swapchain_image_count );
+		// implementation may create more than we asked for
+		_swapchain_image_count			= swapchain_image_count;
+		_present_report.image_count		= swapchain_image_count;
 	}
 	for( uint32_t i=0; i < swapchain_image_count; ++i ) {
 		auto &image		= _swapchain_images[ i ];
@@ -433,31 +889,16 @@ void Window::_CreateSwapchainImages()
 		view_create_info.subresourceRange.baseMipLevel		= 0;
 		view_create_info.subresourceRange.baseArrayLayer	= 0;
 
-		ErrCheck( vkCreateImageView( _renderer->_device, &view_create_info, nullptr, &_swapchain_image_views[ i ] ) );
-
-		VkImageMemoryBarrier image_mem_barrier {};
-		image_mem_barrier.sType					= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		image_mem_barrier.image					= image;
-		image_mem_barrier.oldLayout				= VK_IMAGE_LAYOUT_UNDEFINED;
-		image_mem_barrier.newLayout				= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		image_mem_barrier.srcAccessMask			= 0;
-		image_mem_barrier.dstAccessMask			= VK_ACCESS_MEMORY_READ_BIT;
-		image_mem_barrier.subresourceRange		= view_create_info.subresourceRange;
+		ErrCheck( vkCreateImageView( _renderer->_device, &view_create_info, _allocation_callbacks, &_swapchain_image_views[ i ] ) );
 
-		vkCmdPipelineBarrier( _setup_command_buffer,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &image_mem_barrier );
+		// layout goes from undefined to present source in the first render pass
 	}
 }
 
 void Window::_DestroySwapchainImages()
 {
 	for( uint32_t i=0; i < _swapchain_images.size(); ++i ) {
-		vkDestroyImageView( _renderer->_device, _swapchain_image_views[ i ], nullptr );
+		vkDestroyImageView( _renderer->_device, _swapchain_image_views[ i ], _allocation_callbacks );
 	}
 }
 
@@ -499,7 +940,7 @@ void Window::_CreateDepthBuffer()
 	image_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
 	image_create_info.usage					= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
-	ErrCheck( vkCreateImage( _device, &image_create_info, nullptr, &_depth_image ) );
+	ErrCheck( vkCreateImage( _device, &image_create_info, _allocation_callbacks, &_depth_image ) );
 
 	VkMemoryRequirements memory_requirements {};
 	vkGetImageMemoryRequirements( _device, _depth_image, &memory_requirements );
@@ -523,7 +964,7 @@ void Window::_CreateDepthBuffer()
 	allocate_info.allocationSize			= memory_requirements.size;
 	allocate_info.memoryTypeIndex			= memory_type_index;
 
-	ErrCheck( vkAllocateMemory( _device, &allocate_info, nullptr, &_depth_image_memory ) );
+	ErrCheck( vkAllocateMemory( _device, &allocate_info, _allocation_callbacks, &_depth_image_memory ) );
 	ErrCheck( vkBindImageMemory( _device, _depth_image, _depth_image_memory, 0 ) );
 
 	VkImageMemoryBarrier image_memory_barrier {};
@@ -562,16 +1003,18 @@ void Window::_CreateDepthBuffer()
 	image_view_create_info.subresourceRange.baseArrayLayer		= 0;
 	image_view_create_info.subresourceRange.baseMipLevel		= 0;
 
-	ErrCheck( vkCreateImageView( _device, &image_view_create_info, nullptr, &_depth_image_view ) );
+	ErrCheck( vkCreateImageView( _device, &image_view_create_info, _allocation_callbacks, &_depth_image_view ) );
 }
 
 void Window::_DestroyDepthBuffer()
 {
-	vkDestroyImageView( _device, _depth_image_view, nullptr );
-	vkDestroyImage( _device, _depth_image, nullptr );
-	vkFreeMemory( _device, _depth_image_memory, nullptr );
+	vkDestroyImageView( _device, _depth_image_view, _allocation_callbacks );
+	vkDestroyImage( _device, _depth_image, _allocation_callbacks );
+	vkFreeMemory( _device, _depth_image_memory, _allocation_callbacks );
 }
 
+// Pipelines, framebuffers and scene command buffers are made against this render pass. Frames run
+// the compatible render pass of the render graph, which derives layouts and dependencies itself.
 void Window::_CreateRenderPass()
 {
 	VkAttachmentDescription attachments[ 2 ] { {}, {} };
@@ -593,8 +1036,8 @@ void Window::_CreateRenderPass()
 	attachments[ 1 ].storeOp					= VK_ATTACHMENT_STORE_OP_STORE;
 	attachments[ 1 ].stencilLoadOp				= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[ 1 ].stencilStoreOp				= VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[ 1 ].initialLayout				= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	attachments[ 1 ].finalLayout				= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[ 1 ].initialLayout				= VK_IMAGE_LAYOUT_UNDEFINED;			// cleared anyway, skips preserving the old contents
+	attachments[ 1 ].finalLayout				= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference depth_attachment_ref {};
 	depth_attachment_ref.attachment				= 0;
@@ -617,12 +1060,119 @@ void Window::_CreateRenderPass()
 	render_pass_create_info.subpassCount		= 1;
 	render_pass_create_info.pSubpasses			= &subpass_description;
 
-	ErrCheck( vkCreateRenderPass( _device, &render_pass_create_info, nullptr, &_render_pass ) );
+	ErrCheck( vkCreateRenderPass( _device, &render_pass_create_info, _allocation_callbacks, &_render_pass ) );
 }
 
 void Window::_DestroyRenderPass()
 {
-	vkDestroyRenderPass( _device, _render_pass, nullptr );
+	vkDestroyRenderPass( _device, _render_pass, _allocation_callbacks );
+}
+
+void Window::_BuildRenderGraph()
+{
+	_render_graph->Reset();
+
+	RenderGraphImageInfo color_info;
+	color_info.format			= _color_format;
+	color_info.extent			= _surface_size;
+	_graph_swapchain_image		= _render_graph->ImportImage( "swapchain", color_info, RENDER_GRAPH_ACCESS_SWAPCHAIN_ACQUIRE, RENDER_GRAPH_ACCESS_PRESENT );
+
+	RenderGraphImageInfo depth_info;
+	depth_info.format			= _depth_format;
+	depth_info.extent			= _surface_size;
+	depth_info.aspect			= VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	_graph_depth_image			= _render_graph->ImportImage( "depth", depth_info, RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT, RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT );
+	_render_graph->SetImportedImage( _graph_depth_image, _depth_image, _depth_image_view );
+
+	// dynamic resolution renders into the corner of a transient image, it lives from the scene pass to the upscale
+	_graph_scene_color_image	= RENDER_GRAPH_RESOURCE_NONE;
+	if( _dynamic_resolution ) {
+		_graph_scene_color_image	= _render_graph->CreateImage( "scene color", color_info );
+	}
+
+	// ring buffer copies into device local buffers, before anything reads them
+	auto upload_pass			= _render_graph->AddPass( "uploads", RENDER_GRAPH_PASS_COMPUTE );
+	upload_pass->SetSideEffects();
+	upload_pass->SetExecute( [ this ]( VkCommandBuffer command_buffer ) {
+		_frame_arena->CmdCopyUploads( command_buffer );
+	} );
+
+	// compute work and other things that can't be inside a render pass, they bring their own barriers
+	auto pre_render_pass		= _render_graph->AddPass( "pre render", RENDER_GRAPH_PASS_COMPUTE );
+	pre_render_pass->SetSideEffects();
+	pre_render_pass->SetExecute( [ this ]( VkCommandBuffer command_buffer ) {
+		if( _graph_pre_render_command_buffer_count ) {
+			vkCmdExecuteCommands( command_buffer, _graph_pre_render_command_buffer_count, _graph_pre_render_command_buffers );
+		}
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+		_CmdWriteTimestamp( command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, WINDOW_TIMESTAMP_PRE_RENDER_END );
+#endif
+	} );
+
+	// scene secondaries continue our render pass, attachments follow its order: depth, color.
+	// The graph owns the framebuffer, the secondaries inherit none
+	VkClearDepthStencilValue clear_depth {};
+	clear_depth.depth			= 1.0f;
+	clear_depth.stencil			= 0;
+	VkClearColorValue clear_color {};
+	clear_color.float32[ 0 ]	= 0.10f;
+	clear_color.float32[ 1 ]	= 0.15f;
+	clear_color.float32[ 2 ]	= 0.20f;
+	clear_color.float32[ 3 ]	= 1.0f;
+	_graph_scene_pass			= _render_graph->AddPass( "scene", RENDER_GRAPH_PASS_GRAPHICS );
+	_graph_scene_pass->SetDepthAttachment( _graph_depth_image, clear_depth );
+	_graph_scene_pass->AddColorAttachment( _dynamic_resolution ? _graph_scene_color_image : _graph_swapchain_image, clear_color );
+	_graph_scene_pass->SetExecute( [ this ]( VkCommandBuffer command_buffer ) {
+		// objects render here
+		if( _graph_command_buffer_count ) {
+			vkCmdExecuteCommands( command_buffer, _graph_command_buffer_count, _graph_command_buffers );
+		}
+	} );
+
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	// timestamps can't be written inside a render pass of secondary command buffers
+	auto scene_end_pass			= _render_graph->AddPass( "scene end", RENDER_GRAPH_PASS_COMPUTE );
+	scene_end_pass->SetSideEffects();
+	scene_end_pass->SetExecute( [ this ]( VkCommandBuffer command_buffer ) {
+		_CmdWriteTimestamp( command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, WINDOW_TIMESTAMP_SCENE_END );
+	} );
+#endif
+
+	if( _dynamic_resolution ) {
+		auto upscale_pass		= _render_graph->AddPass( "upscale", RENDER_GRAPH_PASS_COMPUTE );
+		upscale_pass->Read( _graph_scene_color_image, RENDER_GRAPH_ACCESS_TRANSFER_READ );
+		upscale_pass->Write( _graph_swapchain_image, RENDER_GRAPH_ACCESS_TRANSFER_WRITE );
+		upscale_pass->SetRecord( [ this ]( VkCommandBuffer command_buffer ) {
+			VkImageBlit region {};
+			region.srcSubresource.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.layerCount	= 1;
+			region.srcOffsets[ 1 ].x			= int32_t( _render_size.width );
+			region.srcOffsets[ 1 ].y			= int32_t( _render_size.height );
+			region.srcOffsets[ 1 ].z			= 1;
+			region.dstSubresource.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+			region.dstSubresource.layerCount	= 1;
+			region.dstOffsets[ 1 ].x			= int32_t( _surface_size.width );
+			region.dstOffsets[ 1 ].y			= int32_t( _surface_size.height );
+			region.dstOffsets[ 1 ].z			= 1;
+			vkCmdBlitImage( command_buffer,
+				_render_graph->GetImage( _graph_scene_color_image ), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				_swapchain_images[ _current_swapchain_image ], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &region, _upscale_filter );
+		} );
+	}
+
+	// frames BeginFrame didn't pick still pay for the layout transitions
+	if( _frame_capture ) {
+		_frame_capture->Resize( _surface_size, _color_format );
+		auto capture_pass		= _render_graph->AddPass( "capture", RENDER_GRAPH_PASS_COMPUTE );
+		capture_pass->Read( _graph_swapchain_image, RENDER_GRAPH_ACCESS_TRANSFER_READ );
+		capture_pass->SetSideEffects();
+		capture_pass->SetExecute( [ this ]( VkCommandBuffer command_buffer ) {
+			_frame_capture->CmdCopyImage( command_buffer, _swapchain_images[ _current_swapchain_image ] );
+		} );
+	}
+
+	_render_graph->Compile();
 }
 
 void Window::_CreateFrameBuffers()
@@ -644,14 +1194,14 @@ void Window::_CreateFrameBuffers()
 		framebuffer_create_info.height				= _surface_size.height;
 		framebuffer_create_info.layers				= 1;
 
-		ErrCheck( vkCreateFramebuffer( _device, &framebuffer_create_info, nullptr, &_framebuffers[ i ] ) );
+		ErrCheck( vkCreateFramebuffer( _device, &framebuffer_create_info, _allocation_callbacks, &_framebuffers[ i ] ) );
 	}
 }
 
 void Window::_DestroyFrameBuffers()
 {
 	for( auto buffer : _framebuffers ) {
-		vkDestroyFramebuffer( _device, buffer, nullptr );
+		vkDestroyFramebuffer( _device, buffer, _allocation_callbacks );
 	}
 	_framebuffers.empty();
 }
@@ -663,75 +1213,180 @@ void Window::_CreateRenderCommands()
 	pool_create_info.queueFamilyIndex		= _renderer->_render_queue_family_index;
 	pool_create_info.flags					= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-	ErrCheck( vkCreateCommandPool( _device, &pool_create_info, nullptr, &_command_pool ) );
+	ErrCheck( vkCreateCommandPool( _device, &pool_create_info, _allocation_callbacks, &_command_pool ) );
+
+	// frame command buffers and acquire semaphores are reused once the frame arena fence of their frame
+	// has been waited on, present waits per image
+	uint32_t frame_count					= _frame_arena->GetFrameCount();
 
 	VkCommandBufferAllocateInfo allocate_info {};
 	allocate_info.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocate_info.commandBufferCount		= _swapchain_image_count;
+	allocate_info.commandBufferCount		= frame_count;
 	allocate_info.commandPool				= _command_pool;
 	allocate_info.level						= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-	_render_command_buffers.resize( _swapchain_image_count );
+	_render_command_buffers.resize( frame_count );
 	ErrCheck( vkAllocateCommandBuffers( _device, &allocate_info, _render_command_buffers.data() ) );
 
-	// create all commands buffers that do not change
-	VkCommandBufferBeginInfo command_buffer_begin_info {};
-	command_buffer_begin_info.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
 	VkSemaphoreCreateInfo semaphore_create_info {};
 	semaphore_create_info.sType				= VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	_image_available.resize( frame_count );
+	for( auto &s : _image_available ) {
+		ErrCheck( vkCreateSemaphore( _device, &semaphore_create_info, _allocation_callbacks, &s ) );
+	}
 	_render_complete.resize( _swapchain_image_count );
-	ErrCheck( vkCreateSemaphore( _device, &semaphore_create_info, nullptr, &_present_image_available ) );
 	for( uint32_t i=0; i < _swapchain_image_count; ++i ) {
-		ErrCheck( vkCreateSemaphore( _device, &semaphore_create_info, nullptr, &_render_complete[ i ] ) );
+		ErrCheck( vkCreateSemaphore( _device, &semaphore_create_info, _allocation_callbacks, &_render_complete[ i ] ) );
 	}
+
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	_CreateTimestampQueries();
+#endif
 }
 
 void Window::_DestroyRenderCommands()
 {
-	VkCommandBufferBeginInfo begin_info {};
-	begin_info.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	begin_info.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer( _render_command_buffers[ _current_swapchain_image ], &begin_info );
-	vkEndCommandBuffer( _render_command_buffers[ _current_swapchain_image ] );
-
-	VkPipelineStageFlags flags[] { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
-	VkSubmitInfo submit_info {};
-	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.commandBufferCount	= 1;
-	submit_info.pCommandBuffers		= &_render_command_buffers[ _current_swapchain_image ];
-	submit_info.waitSemaphoreCount	= 1;
-	submit_info.pWaitSemaphores		= &_present_image_available;
-	submit_info.pWaitDstStageMask	= flags;
-	vkQueueSubmit( _queue, 1, &submit_info, VK_NULL_HANDLE );
+	// consume the acquire semaphore, a failed acquire never signals it
+	if( _image_acquired ) {
+		VkPipelineStageFlags flags[] { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
+		VkSubmitInfo submit_info {};
+		submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.waitSemaphoreCount	= 1;
+		submit_info.pWaitSemaphores		= &_image_available[ _frame_arena->GetFrameIndex() ];
+		submit_info.pWaitDstStageMask	= flags;
+		_renderer->Submit( QUEUE_TYPE_GRAPHICS, submit_info );
+		_image_acquired					= false;
+	}
 
-	vkQueueWaitIdle( _queue );
+	_renderer->WaitQueueIdle( QUEUE_TYPE_GRAPHICS );
 
+#if BUILD_ENABLE_GPU_TIMESTAMPS
+	_DestroyTimestampQueries();
+#endif
 	for( uint32_t i=0; i < _swapchain_image_count; ++i ) {
-		vkDestroySemaphore( _device, _render_complete[ i ], nullptr );
+		vkDestroySemaphore( _device, _render_complete[ i ], _allocation_callbacks );
 	}
-	vkDestroySemaphore( _device, _present_image_available, nullptr );
-	vkDestroyCommandPool( _device, _command_pool, nullptr );
+	for( auto s : _image_available ) {
+		vkDestroySemaphore( _device, s, _allocation_callbacks );
+	}
+	_image_available.clear();
+	vkDestroyCommandPool( _device, _command_pool, _allocation_callbacks );
 	_command_pool = VK_NULL_HANDLE;
 }
 
+void Window::_CreateTimestampQueries()
+{
+	uint32_t family_count		= 0;
+	vkGetPhysicalDeviceQueueFamilyProperties( _renderer->_gpu, &family_count, nullptr );
+	std::vector<VkQueueFamilyProperties> family_properties( family_count );
+	vkGetPhysicalDeviceQueueFamilyProperties( _renderer->_gpu, &family_count, family_properties.data() );
+
+	uint32_t valid_bits			= family_properties[ _renderer->_render_queue_family_index ].timestampValidBits;
+	_gpu_timings.available		= valid_bits > 0;
+	if( !_gpu_timings.available ) return;
+
+	_timestamp_mask				= valid_bits >= 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << valid_bits ) - 1;
+	_timestamp_period_ms		= double( _renderer->GetVulkanPhysicalDeviceProperties().limits.timestampPeriod ) / 1000000.0;
+
+	VkQueryPoolCreateInfo query_pool_create_info {};
+	query_pool_create_info.sType		= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_create_info.queryType	= VK_QUERY_TYPE_TIMESTAMP;
+	query_pool_create_info.queryCount	= _frame_arena->GetFrameCount() * WINDOW_TIMESTAMP_COUNT;
+	ErrCheck( vkCreateQueryPool( _device, &query_pool_create_info, _allocation_callbacks, &_timestamp_query_pool ) );
+
+	_timestamps_written.assign( _frame_arena->GetFrameCount(), false );
+}
+
+void Window::_DestroyTimestampQueries()
+{
+	if( VK_NULL_HANDLE == _timestamp_query_pool ) return;
+
+	vkDestroyQueryPool( _device, _timestamp_query_pool, _allocation_callbacks );
+	_timestamp_query_pool		= VK_NULL_HANDLE;
+	_timestamps_written.clear();
+}
+
+void Window::_ReadTimestamps()
+{
+	uint32_t frame		= _frame_arena->GetFrameIndex();
+	if( VK_NULL_HANDLE == _timestamp_query_pool || !_timestamps_written[ frame ] ) return;
+
+	// the frame arena fence of the last frame in this slot was waited on, results are there
+	uint64_t timestamps[ WINDOW_TIMESTAMP_COUNT ] {};
+	VkResult result = vkGetQueryPoolResults( _device, _timestamp_query_pool,
+		frame * WINDOW_TIMESTAMP_COUNT, WINDOW_TIMESTAMP_COUNT,
+		sizeof( timestamps ), timestamps, sizeof( uint64_t ),
+		VK_QUERY_RESULT_64_BIT );
+	if( VK_NOT_READY == result ) return;
+	ErrCheck( result );
+	_timestamps_written[ frame ] = false;
+
+	auto elapsed_ms = [ this, &timestamps ]( WINDOW_TIMESTAMP timestamp ) {
+		return double( ( timestamps[ timestamp ] - timestamps[ WINDOW_TIMESTAMP_FRAME_BEGIN ] ) & _timestamp_mask ) * _timestamp_period_ms;
+	};
+	auto smooth = []( double & value, double sample ) {
+		value = value > 0.0 ? value * 0.9 + sample * 0.1 : sample;
+	};
+	smooth( _gpu_timings.pre_render_ms, elapsed_ms( WINDOW_TIMESTAMP_PRE_RENDER_END ) );
+	smooth( _gpu_timings.vertex_ms, elapsed_ms( WINDOW_TIMESTAMP_VERTEX_END ) );
+	smooth( _gpu_timings.scene_ms, elapsed_ms( WINDOW_TIMESTAMP_SCENE_END ) - elapsed_ms( WINDOW_TIMESTAMP_PRE_RENDER_END ) );
+	smooth( _gpu_timings.frame_ms, elapsed_ms( WINDOW_TIMESTAMP_FRAME_END ) );
+}
+
+void Window::_CmdBeginTimestamps( VkCommandBuffer command_buffer )
+{
+	if( VK_NULL_HANDLE == _timestamp_query_pool ) return;
+
+	uint32_t frame		= _frame_arena->GetFrameIndex();
+	vkCmdResetQueryPool( command_buffer, _timestamp_query_pool, frame * WINDOW_TIMESTAMP_COUNT, WINDOW_TIMESTAMP_COUNT );
+	// top of pipe isn't held back by the acquire semaphore, this is when the queue starts the frame
+	_CmdWriteTimestamp( command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, WINDOW_TIMESTAMP_FRAME_BEGIN );
+	_timestamps_written[ frame ] = true;
+}
+
+void Window::_CmdWriteTimestamp( VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage, WINDOW_TIMESTAMP timestamp )
+{
+	if( VK_NULL_HANDLE == _timestamp_query_pool ) return;
+
+	vkCmdWriteTimestamp( command_buffer, stage, _timestamp_query_pool, _frame_arena->GetFrameIndex() * WINDOW_TIMESTAMP_COUNT + timestamp );
+}
+
 void Window::_CreatePipelines()
 {
-	auto pipeline_names = _renderer->GetPipelineNames();
-	for( auto &n : pipeline_names ) {
-		auto pipe = new Pipeline( _renderer, this, n );
-		_pipelines.push_back( pipe );
+	// Pipelines come from the renderer library, windows with the same surface formats share them and
+	// resizing finds the same ones again. Used pipelines compile in parallel on worker threads and
+	// the window doesn't wait for them, lazy pipelines compile when they are first used.
+	for( auto &n : _renderer->GetPipelineNames() ) {
+		auto key = PipelineStateKey( n.c_str() ).WithRenderPassFormats( _color_format, _depth_format );
+		_pipelines.push_back( _renderer->GetPipeline( key ) );
+	}
+	for( auto &n : _renderer->GetLazyPipelineNames() ) {
+		auto key = PipelineStateKey( n.c_str() ).WithRenderPassFormats( _color_format, _depth_format );
+		_pipelines.push_back( _renderer->GetPipeline( key, false ) );
 	}
 }
 
 void Window::_DestroyPipelines()
 {
-	for( auto pipe : _pipelines ) {
-		delete pipe;
-	}
+	// owned by the renderer
 	_pipelines.clear();
 }
 
+void Window::CmdSetViewport( VkCommandBuffer command_buffer )
+{
+	VkViewport viewport {
+		0.0f, 0.0f,
+		float( _render_size.width ), float( _render_size.height ),
+		0.0f, 1.0f
+	};
+	VkRect2D scissor {
+		{ 0, 0 },
+		_render_size
+	};
+	vkCmdSetViewport( command_buffer, 0, 1, &viewport );
+	vkCmdSetScissor( command_buffer, 0, 1, &scissor );
+}
+
 void Window::_CreateDescriptorSets()
 {
 	// create descriptor pool where sets are allocated from, it requires a size of it before using it.
@@ -746,23 +1401,7 @@ void Window::_CreateDescriptorSets()
 		pool_create_info.maxSets		= 1;
 		pool_create_info.poolSizeCount	= pool_sizes.size();
 		pool_create_info.pPoolSizes		= pool_sizes.data();
-		vkCreateDescriptorPool( _device, &pool_create_info, nullptr, &_descriptor_pool );
-	}
-
-	// Create descriptor set layout, this defines the contents of the descriptor sets, we only create one set
-	{
-		std::vector<VkDescriptorSetLayoutBinding> descriptor_set_layout_bindings( 1 );
-		descriptor_set_layout_bindings[ 0 ].binding					= 0;
-		descriptor_set_layout_bindings[ 0 ].descriptorType			= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptor_set_layout_bindings[ 0 ].descriptorCount			= 1;
-		descriptor_set_layout_bindings[ 0 ].stageFlags				= VK_SHADER_STAGE_VERTEX_BIT;
-		descriptor_set_layout_bindings[ 0 ].pImmutableSamplers		= nullptr;
-
-		VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info {};
-		descriptor_set_layout_create_info.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		descriptor_set_layout_create_info.bindingCount		= descriptor_set_layout_bindings.size();
-		descriptor_set_layout_create_info.pBindings			= descriptor_set_layout_bindings.data();
-		vkCreateDescriptorSetLayout( _device, &descriptor_set_layout_create_info, nullptr, &_descriptor_set_layout );
+		vkCreateDescriptorPool( _device, &pool_create_info, _allocation_callbacks, &_descriptor_pool );
 	}
 
 	// allocate descriptor sets
@@ -771,18 +1410,55 @@ void Window::_CreateDescriptorSets()
 		allocate_info.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocate_info.descriptorPool		= _descriptor_pool;
 		allocate_info.descriptorSetCount	= 1;
-		allocate_info.pSetLayouts			= &_descriptor_set_layout;
+		VkDescriptorSetLayout set_layout	= _renderer->GetCameraDescriptorSetLayout();
+		allocate_info.pSetLayouts			= &set_layout;
 		vkAllocateDescriptorSets( _device, &allocate_info, &_descriptor_set );
 	}
+
+	// camera uniform buffer, written through frame arena uploads
+	{
+		_camera_buffers.resize( 1 );
+		_camera_buffers[ 0 ].memory_size		= sizeof( UB_Camera );
+		_camera_buffers[ 0 ].memory_properties	= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		VkBufferCreateInfo buffer_create_info {};
+		buffer_create_info.sType				= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size					= _camera_buffers[ 0 ].memory_size;
+		buffer_create_info.usage				= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode			= VK_SHARING_MODE_EXCLUSIVE;
+		ErrCheck( vkCreateBuffer( _device, &buffer_create_info, _allocation_callbacks, &_camera_buffers[ 0 ].buffer ) );
+
+		AllocateBuffersMemory( _renderer, _camera_buffers );
+		ErrCheck( vkBindBufferMemory( _device, _camera_buffers[ 0 ].buffer, _camera_buffers[ 0 ].memory, 0 ) );
+		_camera_dirty		= true;
+	}
 }
 
 void Window::_UpdateDescriptorSets()
 {
-	//	vkUpdateDescriptorSets();
+	VkDescriptorBufferInfo buffer_info {};
+	buffer_info.buffer					= _camera_buffers[ 0 ].buffer;
+	buffer_info.offset					= 0;
+	buffer_info.range					= sizeof( UB_Camera );
+
+	VkWriteDescriptorSet write {};
+	write.sType							= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet						= _descriptor_set;
+	write.dstBinding					= 0;
+	write.dstArrayElement				= 0;
+	write.descriptorCount				= 1;
+	write.descriptorType				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	write.pBufferInfo					= &buffer_info;
+	vkUpdateDescriptorSets( _device, 1, &write, 0, nullptr );
 }
 
 void Window::_DestroyDescriptorSets()
 {
-	vkDestroyDescriptorPool( _device, _descriptor_pool, nullptr );
-	vkDestroyDescriptorSetLayout( _device, _descriptor_set_layout, nullptr );
+	vkDestroyBuffer( _device, _camera_buffers[ 0 ].buffer, _allocation_callbacks );
+	FreeBuffersMemory( _renderer, _camera_buffers );
+	_camera_buffers.clear();
+
+	vkDestroyDescriptorPool( _device, _descriptor_pool, _allocation_callbacks );
+	_descriptor_pool		= VK_NULL_HANDLE;
+	_descriptor_set			= VK_NULL_HANDLE;
 }
@@ -3,12 +3,76 @@
 #include "BUILD_OPTIONS.h"
 #include "Platform.h"
 
+#include "VulkanCollections.h"
+#include "UniformBuffers.h"
+#include "RenderGraph.h"
+#include "FrameCapture.h"
+
 #include <string>
 #include <vector>
+#include <chrono>
+#include <ostream>
 
 class Renderer;
 class Pipeline;
 class Scene;
+class FrameArena;
+
+// How a window trades latency, throughput and power.
+enum WINDOW_PRESENT_POLICY : uint32_t
+{
+	WINDOW_PRESENT_POLICY_LOW_LATENCY		= 0,	// mailbox, immediate or fifo, extra image only for mailbox
+	WINDOW_PRESENT_POLICY_VSYNC,					// fifo with an extra image for throughput
+	WINDOW_PRESENT_POLICY_POWER_SAVING,				// fifo with as few images as possible, capped to 30 fps by default
+	WINDOW_PRESENT_POLICY_UNCAPPED,					// immediate or mailbox, no pacing, for benchmarks
+};
+
+struct WindowPresentSettings
+{
+	WINDOW_PRESENT_POLICY			policy					= WINDOW_PRESENT_POLICY_LOW_LATENCY;
+	uint32_t						image_count				= 0;		// 0 policy default, clamped to the surface limits
+	float							frame_rate_limit		= 0.0f;		// frames per second, 0 policy default, negative disables the limiter
+	// Acquire the next image when the frame is rendered instead of right after the previous present.
+	// Simulation and scene updates then run before the image is held, which shortens input to photon
+	// latency when the presentation engine is the bottleneck.
+	bool							late_acquire			= false;
+};
+
+// Requested settings next to what the surface and the limiter actually deliver.
+struct WindowPresentReport
+{
+	WindowPresentSettings			requested;
+	VkPresentModeKHR				requested_present_mode	= VK_PRESENT_MODE_FIFO_KHR;		// first preference of the policy
+	VkPresentModeKHR				present_mode			= VK_PRESENT_MODE_FIFO_KHR;
+	uint32_t						image_count				= 0;
+	float							frame_rate_limit		= 0.0f;		// 0 if the limiter is off
+	double							present_interval_ms		= 0.0;		// smoothed time between presents
+};
+
+// Scene rendering into an offscreen target that is scaled up into the swapchain image. The scale
+// follows the measured GPU scene time to hold a target, scene objects keep rendering through
+// Window::CmdSetViewport and don't need to know. Needs GPU timestamps, blits of the surface format
+// and transfer usage of the swapchain, otherwise the window renders directly at full size.
+struct WindowResolutionSettings
+{
+	bool							dynamic					= false;
+	float							target_gpu_time_ms		= 0.0f;		// scene time to hold, 0 is 90% of the frame limiter interval or of 60 fps
+	float							min_scale				= 0.5f;		// per axis
+	float							max_scale				= 1.0f;		// per axis, at most 1
+};
+
+// Smoothed GPU times of the window's frame command buffer, measured from when the queue starts it.
+// Color output waits for the swapchain image while pre render work and vertex processing don't,
+// vertex_ms smaller than the acquire wait means geometry overlapped with the presentation engine.
+// With dynamic resolution only the upscale waits for the image.
+struct WindowGpuTimings
+{
+	bool							available				= false;	// false if the queue has no timestamp support
+	double							pre_render_ms			= 0.0;		// frame start to pre render command buffers done
+	double							vertex_ms				= 0.0;		// frame start to the last vertex shader done
+	double							scene_ms				= 0.0;		// pre render done to the scene pass done, drives dynamic resolution
+	double							frame_ms				= 0.0;		// frame start to everything done, includes the image wait
+};
 
 // Window object is a child object of the Renderer and it's used to open
 // individual windows where we can direct our Vulkan draw commands.
@@ -20,24 +84,108 @@ public:
 	Window( Renderer * renderer, VkExtent2D dimensions, std::string window_name );
 	~Window();
 
+	// True if windows on this platform can present from the queue family. Works before any window
+	// exists, the renderer skips devices that couldn't show anything.
+	static bool								IsPresentationSupported( VkPhysicalDevice gpu, uint32_t queue_family_index );
+
 	void									Update();
 	void									Close();
 
 	void									Render( const std::vector<VkCommandBuffer> & command_buffers );
+	// pre render command buffers are executed outside of the render pass, before it begins.
+	void									Render( const std::vector<VkCommandBuffer> & pre_render_command_buffers, const std::vector<VkCommandBuffer> & command_buffers );
 	void									RenderScene( const Scene * scene, bool force_recalculate = false );
 
 	VkExtent2D								GetSize();
 
+	// Recreates the swapchain with the new present mode and image count.
+	void									SetPresentSettings( const WindowPresentSettings & settings );
+	const WindowPresentReport			&	GetPresentReport() const;
+	void									PrintPresentReport( std::ostream & stream ) const;
+
+	// Only measured with BUILD_ENABLE_GPU_TIMESTAMPS.
+	const WindowGpuTimings				&	GetGpuTimings() const;
+	void									PrintGpuTimings( std::ostream & stream ) const;
+
+	// Recreates the swapchain and the offscreen target, the scale starts over at max_scale.
+	void									SetResolutionSettings( const WindowResolutionSettings & settings );
+	// Fraction of the window size the scene renders at, 1 without dynamic resolution.
+	float									GetRenderScale() const;
+	VkExtent2D								GetRenderSize() const;
+
 	const std::vector<Pipeline*>		&	GetPipelines();
 	Pipeline							*	FindPipeline( std::string name );
 
+	// Next Render waits on the semaphore before the given stages, used to consume uploads or
+	// compute results submitted to other queues. Semaphore ownership stays with the caller.
+	void									AddRenderWait( VkSemaphore semaphore, VkPipelineStageFlags stage );
+
 	VkRenderPass							GetRenderPass();
+	// Pipeline viewport and scissor are dynamic, records both to cover the render size. Command buffers
+	// recorded with it are out of date when the render scale changes, RenderScene re-records them.
+	void									CmdSetViewport( VkCommandBuffer command_buffer );
 	const std::vector<VkFramebuffer>	&	GetFrameBuffers();
 	uint32_t								GetCurrentFrameBufferIndex();
 
+	// Resizes the OS window and rebuilds the swapchain right away. Resizes by the user are picked up
+	// automatically, those rebuild once the size has settled and render at the old size meanwhile.
 	void									Resize( VkExtent2D size );
 
+	// Camera is copied into its uniform buffer at the start of the next frame, changing it
+	// doesn't invalidate any command buffers.
+	void									SetCamera( const Matrix4 & view, const Matrix4 & projection );
+	const UB_Camera						&	GetCamera() const;
+
+	// Transient memory for the frame that is currently being built.
+	FrameArena							*	GetFrameArena();
+
+	// Passes and resources of a frame, rebuilt together with the swapchain.
+	const RenderGraph					*	GetRenderGraph() const;
+
+	// Copies rendered frames back to the host until StopCapture, replaces a running capture. Waits for
+	// this window's frames in flight and rebuilds the render graph, other queue work keeps running.
+	// False if the surface or its format doesn't allow it.
+	bool									StartCapture( const FrameCaptureSettings & settings, FrameCaptureCallback callback );
+	// Waits for the frames still in flight and hands them to the callback before returning.
+	void									StopCapture();
+	// nullptr if not capturing.
+	const FrameCapture					*	GetFrameCapture() const;
+
+	VkDescriptorSet							GetVulkanDescriptorSet();
+
 private:
+	enum WINDOW_TIMESTAMP : uint32_t
+	{
+		WINDOW_TIMESTAMP_FRAME_BEGIN		= 0,
+		WINDOW_TIMESTAMP_PRE_RENDER_END,
+		WINDOW_TIMESTAMP_VERTEX_END,
+		WINDOW_TIMESTAMP_SCENE_END,
+		WINDOW_TIMESTAMP_FRAME_END,
+		WINDOW_TIMESTAMP_COUNT
+	};
+
+	// Acquires the image and updates the render scale from the timestamps of this frame slot.
+	// False if the frame was skipped. Comes before command buffers are collected.
+	bool _BeginFrame();
+	// Records and submits the frame, _BeginFrame must have returned true.
+	void _Render( const VkCommandBuffer * pre_render_command_buffers, uint32_t pre_render_command_buffer_count, const VkCommandBuffer * command_buffers, uint32_t command_buffer_count );
+
+	// Swapchain and size dependent resources only, surface, render pass and pipelines stay.
+	void _RecreateSwapchain( VkExtent2D size );
+	// Debounced, the last size of a burst is applied by Update.
+	void _RequestResize( VkExtent2D size );
+	// Sleeps until the next frame is due and measures the present interval.
+	void _PaceFrame();
+	// False if the swapchain is out of date. Late acquire polls with a short timeout and keeps
+	// draining window events in between.
+	bool _AcquireImage();
+	// Acquires if we don't hold an image yet, rebuilding an out of date swapchain on the way.
+	// False if there is still no image, eg. while minimized, the frame has to be skipped.
+	bool _EnsureImageAcquired();
+	// Ends a frame that had no image to render into, its uploads are still submitted.
+	void _SkipFrame();
+	// Hands a changed camera to the frame arena, copied by the "uploads" graph pass.
+	void _UploadCamera();
 
 	void _SubConstructor( VkExtent2D dimensions );
 	void _SubDestructor();
@@ -53,6 +201,7 @@ private:
 	void _CreateOSSurface();
 	void _DestroyOSWindow();
 	void _UpdateOSWindow();
+	void _ResizeOSWindow( VkExtent2D size );
 
 	void _CreateSurface();
 	void _DestroySurface();
@@ -68,12 +217,29 @@ private:
 	void _CreateRenderPass();
 	void _DestroyRenderPass();
 
+	// Declares the frame: pre render work followed by the scene pass into the swapchain image,
+	// or into the offscreen image and an upscale with dynamic resolution. Captures copy the result last.
+	void _BuildRenderGraph();
+	// Swapchain images can be copied out, they get transfer source usage whenever this holds.
+	bool _IsCaptureSupported() const;
+
 	void _CreateFrameBuffers();
 	void _DestroyFrameBuffers();
 
 	void _CreateRenderCommands();
 	void _DestroyRenderCommands();
 
+	// One set of timestamps per frame in flight, results are read when the frame slot comes around again.
+	void _CreateTimestampQueries();
+	void _DestroyTimestampQueries();
+	void _ReadTimestamps();
+	void _CmdBeginTimestamps( VkCommandBuffer command_buffer );
+	void _CmdWriteTimestamp( VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage, WINDOW_TIMESTAMP timestamp );
+
+	// Moves the render scale towards the target scene time, in steps and not more often than the cooldown.
+	void _UpdateRenderScale();
+	void _UpdateRenderSize();
+
 	void _CreatePipelines();
 	void _DestroyPipelines();
 
@@ -82,6 +248,7 @@ private:
 	void _DestroyDescriptorSets();
 
 	VkDevice							_device							= VK_NULL_HANDLE;
+	const VkAllocationCallbacks		*	_allocation_callbacks			= nullptr;
 	VkQueue								_queue							= VK_NULL_HANDLE;
 	VkSwapchainKHR						_swapchain						= VK_NULL_HANDLE;
 	VkSurfaceKHR						_surface						= VK_NULL_HANDLE;
@@ -94,17 +261,35 @@ private:
 	VkCommandPool						_command_pool					= VK_NULL_HANDLE;
 	std::vector<VkImage>				_swapchain_images;
 	std::vector<VkImageView>			_swapchain_image_views;
-	std::vector<VkFramebuffer>			_framebuffers;
-	std::vector<VkCommandBuffer>		_render_command_buffers;
-	std::vector<VkSemaphore>			_render_complete;
-	VkSemaphore							_present_image_available		= VK_NULL_HANDLE;
+	std::vector<VkFramebuffer>			_framebuffers;					// swapchain images, GetFrameBuffers only, frames render through framebuffers of the render graph
+	std::vector<VkCommandBuffer>		_render_command_buffers;		// per frame in flight
+	std::vector<VkSemaphore>			_image_available;				// per frame in flight
+	std::vector<VkSemaphore>			_render_complete;				// per swapchain image
+	bool								_image_acquired					= false;
+	std::vector<VkSemaphore>			_render_wait_semaphores;
+	std::vector<VkPipelineStageFlags>	_render_wait_stages;
 
 	VkDescriptorPool					_descriptor_pool				= VK_NULL_HANDLE;
-	VkDescriptorSetLayout				_descriptor_set_layout			= VK_NULL_HANDLE;
 	VkDescriptorSet						_descriptor_set					= VK_NULL_HANDLE;
+	std::vector<Buffer>					_camera_buffers;
+	bool								_camera_dirty					= false;
+	UB_Camera							_camera							= { Matrix4Identity(), Matrix4Identity() };
 
 	Renderer						*	_renderer						= VK_NULL_HANDLE;
 	std::vector<Pipeline*>				_pipelines;
+	FrameArena						*	_frame_arena					= nullptr;
+
+	RenderGraph						*	_render_graph					= nullptr;
+	RenderGraphResource					_graph_swapchain_image			= RENDER_GRAPH_RESOURCE_NONE;
+	RenderGraphResource					_graph_depth_image				= RENDER_GRAPH_RESOURCE_NONE;
+	RenderGraphResource					_graph_scene_color_image		= RENDER_GRAPH_RESOURCE_NONE;
+	RenderGraphPass					*	_graph_scene_pass				= nullptr;
+	const VkCommandBuffer			*	_graph_pre_render_command_buffers		= nullptr;		// valid during _Render only
+	uint32_t							_graph_pre_render_command_buffer_count	= 0;
+	const VkCommandBuffer			*	_graph_command_buffers			= nullptr;
+	uint32_t							_graph_command_buffer_count		= 0;
+
+	FrameCapture					*	_frame_capture					= nullptr;
 
 	VkSurfaceCapabilitiesKHR			_surface_capabilities			= {};
 	VkSurfaceFormatKHR					_surface_format					= {};
@@ -118,6 +303,29 @@ private:
 	std::string							_window_name;
 	bool								_window_should_close			= false;
 
+	bool								_resize_pending					= false;
+	VkExtent2D							_requested_size					= { 0, 0 };
+	std::chrono::steady_clock::time_point	_resize_request_time;
+	bool								_scene_commands_out_of_date		= false;		// old framebuffers or render size
+
+	WindowPresentSettings				_present_settings;
+	WindowPresentReport					_present_report;
+	std::chrono::steady_clock::time_point	_last_present_time;
+	std::chrono::steady_clock::time_point	_next_frame_time;
+
+	VkQueryPool							_timestamp_query_pool			= VK_NULL_HANDLE;
+	std::vector<bool>					_timestamps_written;
+	uint64_t							_timestamp_mask					= 0;		// valid bits of the queue
+	double								_timestamp_period_ms			= 0.0;
+	WindowGpuTimings					_gpu_timings;
+
+	WindowResolutionSettings			_resolution_settings;
+	bool								_dynamic_resolution				= false;		// requested and supported
+	VkFilter							_upscale_filter					= VK_FILTER_LINEAR;	// nearest if the color format can't filter linearly
+	float								_render_scale					= 1.0f;
+	VkExtent2D							_render_size					= { 512, 512 };
+	uint32_t							_render_scale_cooldown			= 0;			// frames until the next change
+
 	VkBool32							_WSI_supported					= false;
 
 #if VK_USE_PLATFORM_WIN32_KHR
@@ -33,6 +33,11 @@ LRESULT CALLBACK WindowsEventHandler( HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
 
 uint64_t Window::_win32_class_id_counter = 0;
 
+bool Window::IsPresentationSupported( VkPhysicalDevice gpu, uint32_t queue_family_index )
+{
+	return VK_TRUE == vkGetPhysicalDeviceWin32PresentationSupportKHR( gpu, queue_family_index );
+}
+
 void Window::_CreateOSWindow()
 {
 	WNDCLASSEX win_class {};
@@ -100,7 +105,7 @@ void Window::_CreateOSSurface()
 	create_info.sType			= VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
 	create_info.hinstance		= _win32_instance;
 	create_info.hwnd			= _win32_window;
-	ErrCheck( vkCreateWin32SurfaceKHR( _renderer->_instance, &create_info, nullptr, &_surface ) );
+	ErrCheck( vkCreateWin32SurfaceKHR( _renderer->_instance, &create_info, _allocation_callbacks, &_surface ) );
 }
 
 void Window::_DestroyOSWindow()
@@ -110,10 +115,20 @@ void Window::_DestroyOSWindow()
 	_win32_window		= nullptr;
 }
 
+void Window::_ResizeOSWindow( VkExtent2D size )
+{
+	DWORD ex_style	= DWORD( GetWindowLongPtr( _win32_window, GWL_EXSTYLE ) );
+	DWORD style		= DWORD( GetWindowLongPtr( _win32_window, GWL_STYLE ) );
+	RECT wr = { 0, 0, LONG( size.width ), LONG( size.height ) };
+	AdjustWindowRectEx( &wr, style, FALSE, ex_style );
+	SetWindowPos( _win32_window, nullptr, 0, 0, wr.right - wr.left, wr.bottom - wr.top, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE );
+}
+
 void Window::_UpdateOSWindow()
 {
+	// drain the whole queue, one message per frame falls behind input bursts
 	MSG msg;
-	if( PeekMessage( &msg, _win32_window, 0, 0, PM_REMOVE ) ) {
+	while( PeekMessage( &msg, _win32_window, 0, 0, PM_REMOVE ) ) {
 		TranslateMessage( &msg );
 		DispatchMessage( &msg );
 	}
@@ -7,6 +7,7 @@
 #include "Shared.hpp"
 
 #include <assert.h>
+#include <iostream>
 
 #if VK_USE_PLATFORM_XCB_KHR
 
@@ -42,7 +43,7 @@ void Window::_CreateOSWindow()
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
 	value_list[ 0 ] = _xcb_screen->black_pixel;
-	value_list[ 1 ] = XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_EXPOSURE;
+	value_list[ 1 ] = XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY;
 
 	xcb_create_window( _xcb_connection, XCB_COPY_FROM_PARENT, _xcb_window,
 		_xcb_screen->root, dimensions.offset.x, dimensions.offset.y,
@@ -88,7 +89,25 @@ void Window::_CreateOSSurface()
 	create_info.sType			= VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
 	create_info.connection		= _xcb_connection;
 	create_info.window			= _xcb_window;
-	ErrCheck( vkCreateXcbSurfaceKHR( _renderer->_instance, &create_info, nullptr, &_surface ) );
+	ErrCheck( vkCreateXcbSurfaceKHR( _renderer->_instance, &create_info, _allocation_callbacks, &_surface ) );
+}
+
+bool Window::IsPresentationSupported( VkPhysicalDevice gpu, uint32_t queue_family_index )
+{
+	// windows are created on the default screen with the root visual, ask about that one
+	int screen = 0;
+	xcb_connection_t * connection = xcb_connect( nullptr, &screen );
+	if( xcb_connection_has_error( connection ) ) {
+		xcb_disconnect( connection );
+		return false;
+	}
+	xcb_screen_iterator_t iter = xcb_setup_roots_iterator( xcb_get_setup( connection ) );
+	while( screen-- > 0 ) {
+		xcb_screen_next( &iter );
+	}
+	VkBool32 supported = vkGetPhysicalDeviceXcbPresentationSupportKHR( gpu, queue_family_index, connection, iter.data->root_visual );
+	xcb_disconnect( connection );
+	return VK_TRUE == supported;
 }
 
 void Window::_DestroyOSWindow()
@@ -99,19 +118,52 @@ void Window::_DestroyOSWindow()
 	_xcb_connection		= nullptr;
 }
 
+void Window::_ResizeOSWindow( VkExtent2D size )
+{
+	const uint32_t values[] = { size.width, size.height };
+	xcb_configure_window( _xcb_connection, _xcb_window,
+		XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values );
+	xcb_flush( _xcb_connection );
+}
+
 void Window::_UpdateOSWindow()
 {
-	auto event = xcb_poll_for_event( _xcb_connection );
-	switch( event ) {
-	case XCB_CLIENT_MESSAGE:
-		if( ( *(xcb_client_message_event_t*)event ).data.data32[ 0 ] == ( *_xcb_atom_window_reply ).atom ) {
-			Close();
+	// drain everything the server has sent so far, one event per frame falls behind input bursts
+	xcb_generic_event_t * event = nullptr;
+	bool configured				= false;
+	VkExtent2D configured_size	= { 0, 0 };
+	while( ( event = xcb_poll_for_event( _xcb_connection ) ) ) {
+		// highest bit tells if the event came from SendEvent
+		switch( event->response_type & ~0x80 ) {
+		case XCB_CLIENT_MESSAGE:
+			if( ( *(xcb_client_message_event_t*)event ).data.data32[ 0 ] == ( *_xcb_atom_window_reply ).atom ) {
+				Close();
+			}
+			break;
+		case XCB_CONFIGURE_NOTIFY:
+		{
+			// coalesced, only the last size of a burst survives the drain
+			auto configure		= (xcb_configure_notify_event_t*)event;
+			configured			= true;
+			configured_size		= { configure->width, configure->height };
+			break;
 		}
-		break;
-	default:
-		break;
+		case XCB_EXPOSE:
+			// we redraw every frame anyway
+			break;
+		default:
+			break;
+		}
+		free( event );
+	}
+	if( configured ) {
+		// also sent for moves, _RequestResize ignores sizes we already have
+		_RequestResize( configured_size );
+	}
+	if( xcb_connection_has_error( _xcb_connection ) ) {
+		std::cout << "XCB connection lost.\n";
+		Close();
 	}
-	free( event );
 }
 
 #endif
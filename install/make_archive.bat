@@ -0,0 +1,2 @@
+AssetPacker .
+pause
@@ -1,8 +1,13 @@
-#version 410
+#version 450
+
+// color variants are pipelines specialized with other values, see PipelineSpecialization
+layout(constant_id=0) const float COLOR_R = 0.2;
+layout(constant_id=1) const float COLOR_G = 0.7;
+layout(constant_id=2) const float COLOR_B = 0.4;
 
 layout(location=0) out vec4 FragColor;
 
 void main()
 {
-	FragColor = vec4(0.2, 0.7, 0.4, 1.0);
+	FragColor = vec4(COLOR_R, COLOR_G, COLOR_B, 1.0);
 }
@@ -1,8 +1,19 @@
-#version 410
+#version 450
 
 layout(location=0) in vec3 Vertex_Location;
 
+layout(set=0, binding=0) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+} camera;
+
+layout(push_constant) uniform Object
+{
+	mat4 model;
+} object;
+
 void main()
 {
-	gl_Position = vec4(Vertex_Location, 1.0);
+	gl_Position = camera.projection * camera.view * object.model * vec4(Vertex_Location, 1.0);
 }
@@ -0,0 +1,2 @@
+glslangValidator -V comp.comp
+pause
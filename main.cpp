@@ -9,51 +9,252 @@
 #include "Scene.h"
 #include "SO_DynamicMesh.h"
 #include "Mesh.h"
+#include "AllocationCounter.h"
+#include "ShaderModuleCache.h"
+#include "SimulationThread.h"
+#include "IndirectDrawList.h"
 
 #include <assert.h>
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
 constexpr uint32_t TRIANGLE_COUNT = 20;
 
-int main()
+// Defaults of the demo modes, each can also be turned on from the command line:
+//   --indirect-draw --compute-animation --transform-animation --simulation-thread --late-acquire --lazy-pipelines
+// "--frames <n>" quits after n frames. Together with BUILDUP_DEVICE=llvmpipe this runs a mode on
+// lavapipe, eg. "BUILDUP_DEVICE=llvmpipe xvfb-run ./BuildupPractice --indirect-draw --frames 300".
+// "--check-allocations" exits with an error when a steady state frame allocated host memory.
+// "--capture" copies every frame back to the host for the whole run and reports the dropped ones.
+// "--present <policy>" picks the present policy: low-latency, vsync, power-saving or uncapped.
+// "--color <r>,<g>,<b>" draws with a variant of the default pipeline specialized to that color.
+constexpr bool USE_INDIRECT_DRAW = false;		// cull and draw the scene on the GPU instead of per object command buffers
+constexpr bool USE_COMPUTE_ANIMATION = false;	// animate vertices with a compute shader instead of rewriting them on the CPU
+constexpr bool USE_TRANSFORM_ANIMATION = false;	// rotate whole meshes with their model matrix instead of rewriting vertices
+constexpr bool USE_SIMULATION_THREAD = false;	// simulate the next frame on a separate thread while the current one renders
+constexpr bool USE_LATE_ACQUIRE = false;		// acquire the swapchain image when the frame is rendered, see WindowPresentSettings
+constexpr bool USE_LAZY_PIPELINES = false;		// compile pipelines when the first frame uses them instead of when the window opens
+
+int main( int argc, char ** argv )
 {
+	bool use_indirect_draw			= USE_INDIRECT_DRAW;
+	bool use_compute_animation		= USE_COMPUTE_ANIMATION;
+	bool use_transform_animation	= USE_TRANSFORM_ANIMATION;
+	bool use_simulation_thread		= USE_SIMULATION_THREAD;
+	bool use_lazy_pipelines			= USE_LAZY_PIPELINES;
+	WindowPresentSettings present_settings;
+	present_settings.late_acquire	= USE_LATE_ACQUIRE;
+	bool check_allocations			= false;
+	bool use_capture				= false;
+	PipelineSpecialization color_specialization;		// constant ids of pipelines/default/frag.frag
+	uint64_t frame_limit			= 0;		// 0 runs until the window is closed
+	for( int i=1; i < argc; ++i ) {
+		std::string argument = argv[ i ];
+		if( argument == "--indirect-draw" ) {
+			use_indirect_draw			= true;
+		} else if( argument == "--compute-animation" ) {
+			use_compute_animation		= true;
+		} else if( argument == "--transform-animation" ) {
+			use_transform_animation		= true;
+		} else if( argument == "--simulation-thread" ) {
+			use_simulation_thread		= true;
+		} else if( argument == "--late-acquire" ) {
+			present_settings.late_acquire	= true;
+		} else if( argument == "--lazy-pipelines" ) {
+			use_lazy_pipelines			= true;
+		} else if( argument == "--check-allocations" ) {
+			check_allocations			= true;
+		} else if( argument == "--capture" ) {
+			use_capture					= true;
+		} else if( argument == "--frames" && i + 1 < argc ) {
+			frame_limit					= std::strtoull( argv[ ++i ], nullptr, 10 );
+		} else if( argument == "--color" && i + 1 < argc ) {
+			float color[ 3 ];
+			if( 3 != std::sscanf( argv[ ++i ], "%f,%f,%f", &color[ 0 ], &color[ 1 ], &color[ 2 ] ) ) {
+				std::cout << "Expected \"--color <r>,<g>,<b>\"\n";
+				return -1;
+			}
+			color_specialization.Set( 0u, color[ 0 ] ).Set( 1u, color[ 1 ] ).Set( 2u, color[ 2 ] );
+		} else if( argument == "--present" && i + 1 < argc ) {
+			std::string policy			= argv[ ++i ];
+			if( policy == "low-latency" ) {
+				present_settings.policy	= WINDOW_PRESENT_POLICY_LOW_LATENCY;
+			} else if( policy == "vsync" ) {
+				present_settings.policy	= WINDOW_PRESENT_POLICY_VSYNC;
+			} else if( policy == "power-saving" ) {
+				present_settings.policy	= WINDOW_PRESENT_POLICY_POWER_SAVING;
+			} else if( policy == "uncapped" ) {
+				present_settings.policy	= WINDOW_PRESENT_POLICY_UNCAPPED;
+			} else {
+				std::cout << "Unknown present policy \"" << policy << "\"\n";
+				return -1;
+			}
+		} else {
+			std::cout << "Unknown argument \"" << argument << "\"\n";
+			return -1;
+		}
+	}
+
 	std::vector<std::string> pipeline_names {
 		"default"
 	};
-	Renderer renderer( pipeline_names );
+	std::vector<std::string> lazy_pipeline_names;
+	if( use_lazy_pipelines ) {
+		lazy_pipeline_names.swap( pipeline_names );
+	}
+	Renderer renderer( pipeline_names, lazy_pipeline_names );
 	Window		*	window		= renderer.OpenWindow( { 800, 600 }, "test" );
 	Scene		*	scene		= renderer.CreateScene();
+	window->SetPresentSettings( present_settings );
+
+	// same SPIR-V, the driver folds the constants in when the variant compiles
+	Pipeline	*	pipeline	= window->GetPipelines()[ 0 ];
+	if( !color_specialization.IsEmpty() ) {
+		pipeline				= renderer.GetPipeline( pipeline->GetStateKey().WithSpecialization( color_specialization ) );
+	}
 
-	// mesh triangle. This is data only.
+	// mesh triangle. This is data only, read from the asset archive when there is one.
 	Mesh triangle;
-	triangle.CreateShape_Triangle();
+	if( !triangle.Load( BUILD_MESH_DIRECTORY "triangle.mesh", renderer.GetAssetArchive() ) ) {
+		triangle.CreateShape_Triangle();
+	}
 
 	std::vector<SO_DynamicMesh*> sobj( TRIANGLE_COUNT );		// list of dynamic meshes
 	std::vector<float> sobj_rot_diff( sobj.size() );			// rotational difference between animations on meshes.
 	for( uint32_t i=0; i < sobj.size(); ++i ) {
 		sobj[ i ] 					= scene->CreateSceneObject_DynamicMesh( &triangle );
 		sobj[ i ]->SetActiveWindow( window );								// set active window, trying to get rid of this step
-		sobj[ i ]->SetActivePipeline( window->GetPipelines()[ 0 ] );		// set active pipeline, this step is required but there might be a lot nicer way of doing it
+		sobj[ i ]->SetActivePipeline( pipeline );		// set active pipeline, this step is required but there might be a lot nicer way of doing it
 		sobj_rot_diff[ i ]			= float( i * M_PI * 2 * 0.01 );			// last value is in "circles", 1.0f equals one full round per object.
+		if( use_compute_animation ) {
+			sobj[ i ]->EnableComputeAnimation( "vertex_orbit" );
+		}
+	}
+	if( use_indirect_draw ) {
+		scene->EnableIndirectDraw( window, pipeline );
+	}
+
+	// consumer reads every pixel on the capture thread, like an encoder would
+	uint64_t captured_bytes = 0;
+	uint8_t captured_checksum = 0;
+	if( use_capture ) {
+		FrameCaptureSettings capture_settings;
+		bool capturing = window->StartCapture( capture_settings, [ &captured_bytes, &captured_checksum ]( const FrameCaptureImage & image ) {
+			size_t size = size_t( image.row_pitch ) * image.extent.height;
+			for( size_t i=0; i < size; ++i ) {
+				captured_checksum ^= image.pixels[ i ];
+			}
+			captured_bytes += size;
+		} );
+		if( !capturing ) {
+			std::cout << "Frame capture isn't supported by the surface\n";
+			return -1;
+		}
 	}
 
+	// used pipelines compile on worker threads meanwhile, lazy ones only once recording needs them
+	std::cout << "Pipeline \"" << pipeline->GetName() << "\" " << ( pipeline->IsReady() ? "ready" : "not ready" ) << " before the first frame\n";
+
 	float rotator = 0.0f;		// simple ever increasing float
 
-	while( renderer.Run() ) {
+	// edits the scene for one frame, runs on the simulation thread when use_simulation_thread is set
+	auto simulate = [ & ]( uint64_t frame ) {
 		rotator += 0.0015f;		// increasing the "float counter". This just moves the vertices around a little
 
 		// update meshes manually, ideally this would be it's own entity with a link to a scene_object.
 		for( uint32_t i=0; i < sobj.size(); ++i ) {
-			sobj[ i ]->GetEditableVertices()[ 0 ].loc[ 0 ]		= cos( rotator + sobj_rot_diff[ i ] ) / 2.0f;	// x
-			sobj[ i ]->GetEditableVertices()[ 0 ].loc[ 1 ]		= sin( rotator + sobj_rot_diff[ i ] ) / 2.0f;	// y
+			if( use_compute_animation ) {
+				// same animation as below but calculated on the GPU, see pipelines/vertex_orbit
+				VertexAnimationParameters parameters {};
+				parameters.time				= rotator;
+				parameters.values[ 0 ]		= sobj_rot_diff[ i ];		// phase
+				parameters.values[ 1 ]		= 0.5f;						// radius
+				parameters.values[ 2 ]		= 0.0f;						// vertex index
+				sobj[ i ]->SetComputeAnimationParameters( parameters );
+			} else if( use_transform_animation ) {
+				// rigid motion, only a 64 byte push constant changes per object
+				sobj[ i ]->SetTransform( Matrix4RotationZ( rotator + sobj_rot_diff[ i ] ) );
+			} else {
+				sobj[ i ]->GetEditableVertices()[ 0 ].loc[ 0 ]		= cos( rotator + sobj_rot_diff[ i ] ) / 2.0f;	// x
+				sobj[ i ]->GetEditableVertices()[ 0 ].loc[ 1 ]		= sin( rotator + sobj_rot_diff[ i ] ) / 2.0f;	// y
+			}
+		}
+	};
+	SimulationThread * simulation = use_simulation_thread ? new SimulationThread( scene, simulate ) : nullptr;
+
+	// first frames are still warming up caches and arenas
+	constexpr uint64_t WARMUP_FRAME_COUNT	= 10;
+
+	uint64_t frame_number					= 0;
+	uint64_t allocating_frame_count			= 0;
+	uint64_t last_heap_allocation_count		= GetHeapAllocationCount();
+	uint64_t last_vulkan_allocation_count	= renderer.GetHostAllocator()->GetTotalStatistics().allocation_count;
+
+	while( renderer.Run() && ( frame_limit == 0 || frame_number < frame_limit ) ) {
+		if( nullptr != simulation ) {
+			simulation->Sync();				// take the frame simulated meanwhile, next one starts right away
+		} else {
+			simulate( frame_number );
 		}
 		scene->Update();					// update scene, this handles all general stuff, including vertex uploads to GPU, this is recursive
 		window->RenderScene( scene );		// render scene, this is also recursive
+
+		++frame_number;
+
+		// steady state frames should not touch the heap
+		auto heap_allocation_count		= GetHeapAllocationCount();
+		auto vulkan_allocation_count	= renderer.GetHostAllocator()->GetTotalStatistics().allocation_count;
+		if( frame_number > WARMUP_FRAME_COUNT && ( heap_allocation_count != last_heap_allocation_count || vulkan_allocation_count != last_vulkan_allocation_count ) ) {
+			++allocating_frame_count;
+			if( BUILD_ENABLE_ALLOCATION_COUNTER || check_allocations ) {
+				std::cout << "Frame " << frame_number << ": "
+					<< heap_allocation_count - last_heap_allocation_count << " heap allocations, "
+					<< vulkan_allocation_count - last_vulkan_allocation_count << " Vulkan host allocations\n";
+			}
+		}
+		last_heap_allocation_count		= heap_allocation_count;
+		last_vulkan_allocation_count	= vulkan_allocation_count;
+	}
+	delete simulation;
+	renderer.WaitQueueIdle( QUEUE_TYPE_GRAPHICS );
+
+	window->PrintPresentReport( std::cout );
+	window->PrintGpuTimings( std::cout );
+	window->GetRenderGraph()->PrintStatistics( std::cout );
+	renderer.GetShaderModuleCache()->PrintStatistics( std::cout );
+	if( use_indirect_draw ) {
+		scene->GetIndirectDrawList()->PrintStatistics( std::cout );
+	}
+	if( use_capture ) {
+		// nothing is dropped after the last frame, stopping delivers the frames still in flight
+		window->GetFrameCapture()->PrintStatistics( std::cout );
+		window->StopCapture();
+		std::cout << "Frame capture: " << captured_bytes / ( 1024 * 1024 ) << " MiB consumed, checksum " << uint32_t( captured_checksum ) << "\n";
+	}
+
+	if( BUILD_ENABLE_ALLOCATION_COUNTER ) {
+		renderer.GetHostAllocator()->PrintStatistics( std::cout );
+	}
+
+	if( check_allocations ) {
+		if( !BUILD_ENABLE_ALLOCATION_COUNTER ) {
+			std::cout << "BUILD_ENABLE_ALLOCATION_COUNTER is 0, only Vulkan host allocations were checked\n";
+		}
+		if( frame_number <= WARMUP_FRAME_COUNT ) {
+			std::cout << "Allocation check needs more than " << WARMUP_FRAME_COUNT << " frames\n";
+			return -1;
+		}
+		if( allocating_frame_count ) {
+			std::cout << "Allocation check failed, " << allocating_frame_count << " of " << frame_number - WARMUP_FRAME_COUNT << " steady state frames allocated\n";
+			return -1;
+		}
+		std::cout << "Allocation check passed, " << frame_number - WARMUP_FRAME_COUNT << " steady state frames without allocations\n";
 	}
-	vkQueueWaitIdle( renderer.GetVulkanQueue() );
 
 	return 0;
 }
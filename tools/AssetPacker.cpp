@@ -0,0 +1,146 @@
+// AssetPacker builds the asset archive read by Renderer, see AssetArchive.h for the format.
+//
+//		AssetPacker <install directory> [ output archive ]
+//
+// Packs every .spv and .mesh file under the install directory, names are relative to it.
+// Output defaults to BUILD_ASSET_ARCHIVE_PATH inside the install directory. Entries are
+// compressed when it saves at least 1/8 of their size, SPIR-V is always stored uncompressed
+// so the driver can read it straight from the mapped archive.
+//
+// Built by AssetPacker.vcxproj in the solution. Elsewhere build together with ../AssetArchive.cpp
+// and ../MappedFile.cpp, eg.
+//		g++ -std=c++11 -I.. AssetPacker.cpp ../AssetArchive.cpp ../MappedFile.cpp -o AssetPacker
+
+#include "BUILD_OPTIONS.h"
+#include "Platform.h"
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if VK_USE_PLATFORM_XCB_KHR
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static bool EndsWith( const std::string & s, const std::string & suffix )
+{
+	return s.size() >= suffix.size() && s.compare( s.size() - suffix.size(), suffix.size(), suffix ) == 0;
+}
+
+static bool IsPackedAsset( const std::string & name )
+{
+	return EndsWith( name, ".spv" ) || EndsWith( name, ".mesh" );
+}
+
+// Appends files under root/relative to names, relative paths use "/".
+static void ListFiles( const std::string & root, const std::string & relative, std::vector<std::string> & names )
+{
+#if VK_USE_PLATFORM_WIN32_KHR
+	WIN32_FIND_DATAA find_data {};
+	HANDLE find = FindFirstFileA( ( root + "/" + relative + "*" ).c_str(), &find_data );
+	if( find == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+	do {
+		std::string name = find_data.cFileName;
+		if( name == "." || name == ".." ) continue;
+		if( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
+			ListFiles( root, relative + name + "/", names );
+		} else {
+			names.push_back( relative + name );
+		}
+	} while( FindNextFileA( find, &find_data ) );
+	FindClose( find );
+#elif VK_USE_PLATFORM_XCB_KHR
+	DIR * dir = opendir( ( root + "/" + relative ).c_str() );
+	if( !dir ) {
+		return;
+	}
+	while( auto entry = readdir( dir ) ) {
+		std::string name = entry->d_name;
+		if( name == "." || name == ".." ) continue;
+		struct stat file_stat {};
+		if( stat( ( root + "/" + relative + name ).c_str(), &file_stat ) != 0 ) continue;
+		if( S_ISDIR( file_stat.st_mode ) ) {
+			ListFiles( root, relative + name + "/", names );
+		} else {
+			names.push_back( relative + name );
+		}
+	}
+	closedir( dir );
+#endif
+}
+
+int main( int argc, char ** argv )
+{
+	if( argc < 2 ) {
+		std::cout << "usage: AssetPacker <install directory> [ output archive ]" << std::endl;
+		return 1;
+	}
+	std::string root		= argv[ 1 ];
+	std::string output		= argc > 2 ? argv[ 2 ] : root + "/" + BUILD_ASSET_ARCHIVE_PATH;
+
+	std::vector<std::string> names;
+	ListFiles( root, "", names );
+	names.erase( std::remove_if( names.begin(), names.end(), []( const std::string & n ) { return !IsPackedAsset( n ); } ), names.end() );
+	// archive lookups are binary searches with strcmp
+	std::sort( names.begin(), names.end(), []( const std::string & a, const std::string & b ) { return std::strcmp( a.c_str(), b.c_str() ) < 0; } );
+
+	std::vector<AssetArchiveEntry> entries( names.size() );
+	std::vector<std::vector<uint8_t>> blobs( names.size() );
+	uint64_t offset = sizeof( AssetArchiveHeader ) + entries.size() * sizeof( AssetArchiveEntry );
+	for( size_t i=0; i < names.size(); ++i ) {
+		if( names[ i ].size() >= ASSET_ARCHIVE_NAME_LENGTH ) {
+			std::cout << "Name too long: " << names[ i ] << std::endl;
+			return 1;
+		}
+		MappedFile file( root + "/" + names[ i ] );
+		auto data = reinterpret_cast<const uint8_t*>( file.GetData() );
+		auto size = file.GetSize();
+
+		auto &e = entries[ i ];
+		std::memset( &e, 0, sizeof( e ) );
+		std::strcpy( e.name, names[ i ].c_str() );
+		e.size			= size;
+		e.compression	= ASSET_COMPRESSION_NONE;
+		blobs[ i ].assign( data, data + size );
+		if( !EndsWith( names[ i ], ".spv" ) && size > 0 ) {
+			auto compressed = AssetCompress( data, size );
+			if( compressed.size() <= size - size / 8 ) {
+				e.compression	= ASSET_COMPRESSION_LZ;
+				blobs[ i ]		= std::move( compressed );
+			}
+		}
+		e.stored_size	= blobs[ i ].size();
+		offset			= ( offset + ASSET_ARCHIVE_BLOB_ALIGNMENT - 1 ) / ASSET_ARCHIVE_BLOB_ALIGNMENT * ASSET_ARCHIVE_BLOB_ALIGNMENT;
+		e.offset		= offset;
+		offset			+= e.stored_size;
+		std::cout << e.name << ": " << e.size << " B, stored " << e.stored_size << " B" << std::endl;
+	}
+
+	std::ofstream out( output, std::ofstream::binary );
+	if( !out.is_open() ) {
+		std::cout << "Can't write " << output << std::endl;
+		return 1;
+	}
+	AssetArchiveHeader header {};
+	header.magic		= ASSET_ARCHIVE_MAGIC;
+	header.version		= ASSET_ARCHIVE_VERSION;
+	header.entry_count	= uint32_t( entries.size() );
+	out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	out.write( reinterpret_cast<const char*>( entries.data() ), entries.size() * sizeof( AssetArchiveEntry ) );
+	for( size_t i=0; i < entries.size(); ++i ) {
+		std::vector<char> padding( size_t( entries[ i ].offset - uint64_t( out.tellp() ) ), 0 );
+		out.write( padding.data(), padding.size() );
+		out.write( reinterpret_cast<const char*>( blobs[ i ].data() ), blobs[ i ].size() );
+	}
+	std::cout << entries.size() << " assets packed into " << output << std::endl;
+	return out.good() ? 0 : 1;
+}